@@ -54,6 +54,8 @@ cd ..
 cd test_velocity_3D
 rm -rf out
 cd ..
+rm -rf test_merge
+rm -rf test_resume
 rm *.png
 
 
@@ -0,0 +1,71 @@
+#!/bin/bash
+
+#############################################################################################################################################
+ # fastSF
+ # 
+ # Copyright (C) 2020, Mahendra K. Verma
+ #
+ # All rights reserved.
+ # 
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions are met:
+ #     1. Redistributions of source code must retain the above copyright
+ #        notice, this list of conditions and the following disclaimer.
+ #     2. Redistributions in binary form must reproduce the above copyright
+ #        notice, this list of conditions and the following disclaimer in the
+ #        documentation and/or other materials provided with the distribution.
+ #     3. Neither the name of the copyright holder nor the
+ #        names of its contributors may be used to endorse or promote products
+ #        derived from this software without specific prior written permission.
+ # 
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ # ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ # WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ # DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ # ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ # (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ # LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ # ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ # SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ #
+ ############################################################################################################################################
+ ##
+ ##! \file runBenchmark.sh
+ #
+ #   \brief Script to compare the run times of the structure function kernels for the different field layouts
+ #
+ #   \date Oct 2026
+ #   \copyright New BSD License
+ #
+ ############################################################################################################################################
+##
+
+# Usage: bash runBenchmark.sh [number of MPI processors] [N] [brick size]
+# The 3D test fields of size N^3 are generated internally and the time taken by the
+# parallel part is reported for each layout of the fields, and for the variant chosen
+# by --tune. The tuning profile is kept in a temporary directory, so that the profile
+# of the host is neither read nor changed and all the runs start from the defaults.
+
+NP=${1:-1}
+N=${2:-64}
+B=${3:-8}
+
+export FASTSF_TUNING_DIR=$(mktemp -d)
+trap 'rm -rf "$FASTSF_TUNING_DIR"' EXIT
+
+cd test/test_velocity_3D
+for layout in "-f planar -b 0" "-f interleaved -b 0" "-b $B" "--tune"
+do
+    echo "Velocity field, $layout"
+    mpirun -np $NP ../../src/fastSF.out -X $N -Y $N -Z $N $layout | grep "parallel part"
+done
+cd ..
+
+cd test_scalar_3D
+for layout in "-b 0" "-b $B" "--tune"
+do
+    echo "Scalar field, $layout"
+    mpirun -np $NP ../../src/fastSF.out -X $N -Y $N -Z $N $layout | grep "parallel part"
+done
+cd ../..
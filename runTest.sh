@@ -56,6 +56,50 @@ cd ..
 cd test_velocity_3D
 mpirun -np 1 ../../src/fastSF.out
 cd ../
+
+#The sums of two runs over the halves of the displacements along x are merged and compared with the complete run
+mkdir -p test_merge/in
+cd test_merge
+for half in "low 0, 7" "high 8, 15"
+do
+    { cat ../test_velocity_3D/in/para.yaml; printf '\npartial :\n    Sums : true\n    X_range : [%s]\n' "${half#* }"; } > in/para.yaml
+    mpirun -np 1 ../../src/fastSF.out
+    mv out/SF_Grid_pll_sums.h5 out/pll_${half%% *}_sums.h5
+    mv out/SF_Grid_perp_sums.h5 out/perp_${half%% *}_sums.h5
+done
+mpirun -np 1 ../../src/fastSF.out --merge out/SF_Grid_pll.h5 out/pll_low_sums.h5 out/pll_high_sums.h5
+mpirun -np 1 ../../src/fastSF.out --merge out/SF_Grid_perp.h5 out/perp_low_sums.h5 out/perp_high_sums.h5
+cd ..
+python compare.py MERGE_PLL test_merge/out/SF_Grid_pll.h5 test_velocity_3D/out/SF_Grid_pll.h5
+python compare.py MERGE_PERP test_merge/out/SF_Grid_perp.h5 test_velocity_3D/out/SF_Grid_perp.h5
+
+#A run stopped after every 1500 of its 4096 steps is resumed until it completes, and compared with the complete run; every run has to
+#make progress, and the run has to be stopped at least once
+rm -rf test_resume
+mkdir -p test_resume/in
+cd test_resume
+{ cat ../test_velocity_3D/in/para.yaml; printf '\nschedule :\n    Max_steps : 1500\n'; } > in/para.yaml
+runs=0
+progress=0
+while [ $runs -eq 0 ] || [ -f out/SF_Grid_pll_resume.yaml ]
+do
+    mpirun -np 1 ../../src/fastSF.out --resume
+    runs=$((runs+1))
+    steps=$(awk '/^Steps_done:/ {print $2}' out/SF_Grid_pll_resume.yaml 2>/dev/null)
+    if [ -n "$steps" ] && [ "$steps" -le "$progress" ]; then
+        break
+    fi
+    progress=${steps:-$progress}
+done
+if [ $runs -lt 2 ] || [ -f out/SF_Grid_pll_resume.yaml ]; then
+    echo "RESUME: TEST_FAILED. The run was not stopped, or a resumed run made no progress ($runs runs)."
+else
+    echo "RESUME: TEST_PASSED. The run was completed in $runs runs."
+fi
+cd ..
+python compare.py RESUME_PLL test_resume/out/SF_Grid_pll.h5 test_velocity_3D/out/SF_Grid_pll.h5
+python compare.py RESUME_PERP test_resume/out/SF_Grid_perp.h5 test_velocity_3D/out/SF_Grid_perp.h5
+
 python test.py
 
 
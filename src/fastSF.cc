@@ -53,271 +53,630 @@
 #include <sys/time.h>
 #include <limits.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <map>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <cmath>
+#include <numeric>
+#include <cstdint>
+#include <limits>
+#include <iomanip>
+#include <sys/stat.h>
+#include <cerrno>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 using namespace std;
 using namespace blitz;
 
 //Function declarations
+struct SF_context;
+void init_context(SF_context&);
 void get_Inputs(int argc, char* argv[]); 
-void write_3D(Array<double,3>, string);
-void write_4D(Array<double,4>, string);
+void write_3D(Array<double,3>, string, vector<string>);
+void write_4D(Array<double,4>, string, vector<string>);
+void submit_write(SF_context&, function<void()>);
+void flush_writes();
+void stop_writer();
+void exit_on_error();
+void fail_analysis();
 void read_2D(Array<double,2>, string, string, string);
 string int_to_str(int);
 bool str_to_bool(string);
-void VECTOR_TEST_CASE_3D();
-void VECTOR_TEST_CASE_2D();
-void SCALAR_TEST_CASE_2D();
-void SCALAR_TEST_CASE_3D();
+int str_to_order(string);
+vector<double> str_to_orders(string);
+void VECTOR_TEST_CASE_3D(SF_context&);
+void VECTOR_TEST_CASE_2D(SF_context&);
+void SCALAR_TEST_CASE_2D(SF_context&);
+void SCALAR_TEST_CASE_3D(SF_context&);
 void compute_time_elapsed(timeval, timeval, double&);
 
 void read_3D(Array<double,3>, string, string, string);
 
 
-void SFunc2D(Array<double,2>, Array<double,2>);
+void SFunc2D(SF_context&, Array<double,2>, Array<double,2>);
+
+
+void SFunc_long_2D(SF_context&, Array<double,2>, Array<double,2>);
+
+
+void SFunc3D(SF_context&, Array<double,3>, Array<double,3>, Array<double,3>);
+
+
+void SFunc_long_3D(SF_context&, Array<double,3>, Array<double,3>, Array<double,3>);
+void SFunc3D_packed(SF_context&, Array<double,1>);
+void SFunc_long_3D_packed(SF_context&, Array<double,1>);
+void SF_scalar_3D_packed(SF_context&, Array<double,1>);
+void compute_point_offsets(SF_context&);
+void pack_fields(SF_context&);
+void pack_vector(SF_context&, Array<double,3>, Array<double,3>, Array<double,3>, Array<double,1>&);
+void pack_scalar(SF_context&, Array<double,3>, Array<double,1>&);
+void gather_SF_3D(SF_context&, Array<double,4>, int, int, int, Array<double,1>);
+int num_blocks(SF_context&);
+void block_ranges(SF_context&, int, int, int, vector<int>&, vector<int>&);
+void block_counts(SF_context&, int, int, int, int, vector<double>&);
+void block_offsets(SF_context&, vector<int>&, vector<int>&, vector<int>&);
+void block_sums_3D(SF_context&, Array<double,3>, int, int, int, int, Array<double,1>);
+void block_sums_2D(SF_context&, Array<double,2>, int, int, int, Array<double,1>);
+void block_statistics(SF_context&, Array<double,1>, const vector<double>&, Array<double,1>);
+void moments_3D_planar(SF_context&, Array<double,3>, Array<double,3>, Array<double,3>, int, int, int, Array<double,1>, Array<double,1>, Array<double,1>, bool);
+void moments_3D_packed(SF_context&, Array<double,1>, int, int, int, Array<double,1>, Array<double,1>, Array<double,1>, bool);
+void transverse_basis(SF_context&, double, double, double, double*, double*);
+double order_value(SF_context&, int);
+int num_orders(SF_context&);
+string order_label(SF_context&, int);
+vector<string> order_labels(SF_context&);
+void moments_scalar_3D_planar(SF_context&, Array<double,3>, int, int, int, Array<double,1>);
+void moments_scalar_3D_packed(SF_context&, Array<double,1>, int, int, int, Array<double,1>);
+void choose_kernel_variant(SF_context&);
+void tune_kernels(SF_context&);
+bool load_tuning_profile(SF_context&);
+void save_tuning_profile(SF_context&);
+string tuning_profile_path();
+string tuning_case(SF_context&);
+void Read_Init(SF_context&, Array<double,2>&, Array<double,2>&);
+void Read_Init(SF_context&, Array<double,3>&, Array<double,3>&, Array<double,3>&);
+void Read_Init(SF_context&, Array<double,2>&);
+void Read_Init(SF_context&, Array<double,3>&);
+
+
+
+void SF_scalar_3D(SF_context&, Array<double,3>);
+
+
+void SF_scalar_2D(SF_context&, Array<double,2>);
+
+void Read_fields(SF_context&);
+void resize_SFs(SF_context&);
+void calc_SFs(SF_context&);
+void write_SFs(SF_context&);
+struct Written_results;
+void write_results(const shared_ptr<Written_results>&);
+void test_cases(SF_context&);
+struct Scaling_summary;
+void scaling_summary(SF_context&, const double*, int, int, int, Scaling_summary&);
+double fit_slope(const vector<double>&, const vector<double>&);
+void write_summary(Scaling_summary, string);
+void radial_binning(SF_context&, int, int, int, int, double&, double&, double&);
+struct Angular_moments;
+void resize_angular(SF_context&);
+void real_harmonics(int, double, double, double*);
+void accumulate_angular(SF_context&, int, int, int, double, Array<double,1>, Array<double,1>, bool);
+void reduce_angular(SF_context&);
+void normalize_angular(SF_context&, Angular_moments&);
+void write_angular(Angular_moments, string);
+void read_conditional_field(SF_context&);
+int num_groups(SF_context&);
+int sum_size(SF_context&);
+void conditional_statistics(SF_context&, Array<double,1>, const vector<double>&, Array<double,2>, vector<double>&);
+void gather_SF_2D(SF_context&, Array<double,3>, int, int, Array<double,1>);
+void write_conditional_bins(vector<double>, vector<double>, string);
+void read_matching_field(SF_context&, string, string, vector<double>&);
+bool displacement_selected(SF_context&, int);
+void write_sums_4D(Array<double,4>, Array<double,4>, string, vector<string>);
+void write_sums_3D(Array<double,3>, Array<double,3>, string, vector<string>);
+void merge_sums(int, char*[]);
+void compute_cache_key(SF_context&);
+bool restore_cached(SF_context&);
+void store_results(vector<string>, string, string);
+void compute_schedule(SF_context&, Array<int,3>&);
+void flush_progress(SF_context&, int);
+void write_attribute(string, string, double);
+bool out_of_time(SF_context&, int);
+void read_resume(SF_context&);
+void load_resume(SF_context&);
+void write_resume(SF_context&);
+string resume_path(SF_context&);
+void trace_init();
+void trace_name_thread(string);
+void trace_event(const char*, const char*, double, double, long, long, double);
+double trace_clock();
+void trace_collective(SF_context&, const char*, double);
+void trace_step(SF_context&, int, bool);
+void write_trace();
+string json_escape(string);
+int perf_open_counter(int, string, int);
+void perf_enable(SF_context&, bool);
+void perf_open(SF_context&);
+void perf_start(SF_context&);
+void perf_stop(SF_context&);
+void perf_report(SF_context&);
+struct Joint_pdfs;
+void velocity_at(SF_context&, int, int, int, double*);
+void joint_pdfs(SF_context&);
+void write_joint_pdfs(Joint_pdfs, string);
+void show_checklist();
 
+void calculate_grid_spacing(SF_context&);
+void resize_input(SF_context&);
+struct Input_dataset;
+void open_input(SF_context&, string, string, string, bool, Input_dataset&);
+void check_input_shapes(SF_context&, Input_dataset&, Input_dataset&);
+void read_input(Input_dataset&, int, double*);
+void close_input(Input_dataset&);
+bool parse_gradient(string, bool, bool, int&, int&);
+void add_derivative(SF_context&, const double*, int, double, double*);
+void derive_fields(SF_context&);
+void free_fields(SF_context&);
+void help_command();
+void run_analysis();
+bool same_fields(SF_context&, SF_context&);
+void share_fields(SF_context&, SF_context&);
+void prepare_analysis(SF_context&, SF_context*);
+double compute_analysis(SF_context&);
+void finish_analysis(SF_context&, double);
+void run_manifest(int, char*[]);
+void reset_inputs(bool);
 
-void SFunc_long_2D(Array<double,2>, Array<double,2>);
 
 
-void SFunc3D(Array<double,3>, Array<double,3>, Array<double,3>);
 
 
-void SFunc_long_3D(Array<double,3>, Array<double,3>, Array<double,3>);
-void Read_Init(Array<double,2>&, Array<double,2>&);
-void Read_Init(Array<double,3>&, Array<double,3>&, Array<double,3>&);
-void Read_Init(Array<double,2>&);
-void Read_Init(Array<double,3>&);
 
 
 
-void SF_scalar_3D(Array<double,3>);
 
 
-void SF_scalar_2D(Array<double,2>);
 
-void Read_fields();
-void resize_SFs();
-void calc_SFs();
-void write_SFs();
-void test_cases();
-void show_checklist();
 
-bool compare(Array<int,1> , Array<int,1> );
-void calculate_grid_spacing();
-void resize_input();
-void get_input_shape(string , string , string , Array<int,1>&);
-void help_command();
+
+
+
+
+
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the structure functions are to be calculated using 2D or 3D velocity field data.
+ *
+ * If "true", then the code will read 2D velocity fields and calculate the corresponding structure functions. Otherwise, it will read 3D velocity
+ * fields. Entered by the user
+ ********************************************************************************************************************************************
+ */
+bool two_dimension_switch;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief    This variable decides whether the scalar or velocity structure functions are to be evaluated.
+ *
+ * If the value is "true", then scalar structure functions will be evaluated, else the vector (velocity) structure functions will be evaluated.
+ ********************************************************************************************************************************************
+ */
+bool scalar_switch;
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the test cases are required to run.
+ *
+ * If the value is "true", then the input fields will be generated internally and test cases will be run.
+ ********************************************************************************************************************************************
+ */
+bool test_switch;
 
 /**
  ********************************************************************************************************************************************
- * \brief   3D array storing the input 3D scalar field.
+ * \brief   Number of gridpoints in the \f$ x \f$ direction.
  ********************************************************************************************************************************************
  */
-Array <double,3> T;
+int Nx;
 
 /**
  ********************************************************************************************************************************************
- * \brief   3D array storing the x-component of the input 3D velocity field.
+ * \brief   Number of gridpoints in the \f$ y \f$ direction.
  ********************************************************************************************************************************************
  */
-Array <double,3> V1;
+int Ny;
 
 /**
  ********************************************************************************************************************************************
- * \brief   3D array storing the y-component of the input 3D velocity field.
+ * \brief   Number of gridpoints in the \f$ z \f$ direction.
  ********************************************************************************************************************************************
  */
-Array <double,3> V2;
+int Nz;
+
 
 /**
  ********************************************************************************************************************************************
- * \brief   3D array storing the z-component of the input 3D velocity field.
+ * \brief   The first order of the range of orders of the structure functions to be computed. Entered by the user.
  ********************************************************************************************************************************************
  */
-Array <double,3> V3;
+int q1;
 
 /**
  ********************************************************************************************************************************************
- * \brief   2D array storing the input 2D scalar field.
+ * \brief   The last order of the range of orders of the structure functions to be computed. Entered by the user.
  ********************************************************************************************************************************************
  */
-Array <double,2> T_2D;
+int q2;
 
 /**
  ********************************************************************************************************************************************
- * \brief   2D array storing the x-component of the input 2D velocity field.
+ * \brief   Real orders of the structure functions of the magnitude of the increments (empty for the integer orders q1 to q2 of the signed
+ *          increments). Entered by the user.
  ********************************************************************************************************************************************
  */
-Array<double,2> V1_2D;
+vector<double> orders;
 
 /**
  ********************************************************************************************************************************************
- * \brief   2D array storing the z-component of the input 2D velocity field.
+ * \brief   Switch for computing the moments of the magnitude of the increments along with the signed moments of the orders q1 to q2.
  ********************************************************************************************************************************************
  */
-Array<double,2> V3_2D;
+bool absolute_moments = false;
 
 
 /**
  ********************************************************************************************************************************************
- * \brief   4D array storing the computed longitudinal structure functions as function of the displacement vector.
+ * \brief   This variable decides whether to calculate both transverse and longitudinal structure functions or only the longitudinal structure
+ * functions.
+ *
+ * If the value is false, the code calculates both transverse and longitudinal structure functions. Else, it calculates only the longitudinal
+ * structure functions.
+ ********************************************************************************************************************************************
+ */
+bool longitudinal;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides the memory layout of the 3D velocity field used by the structure function kernels.
  *
- *          This array stores the structure functions as function of the displacement vector \f$ \mathbf{l} = (l_x, l_y, l_z )\f$. The fourth
- *          dimension corresponds to the order of the structure functions that are calculated.
+ * If the value is "planar", the three velocity components are stored as separate arrays. If the value is "interleaved", the components are
+ * packed per grid point so that the kernels read two memory streams per displacement instead of six.
  ********************************************************************************************************************************************
  */
-Array<double,4> SF_Grid_pll;
+string velocity_layout = "";
 
 /**
  ********************************************************************************************************************************************
- * \brief   4D array storing the computed transverse structure functions as function of the displacement vector.
+ * \brief   Edge of the bricks in which the 3D input fields are stored.
  *
- *          This array stores the structure functions as function of the displacement vector \f$ \mathbf{l} = (l_x, l_y, l_z )\f$. The fourth
- *          dimension corresponds to the order of the structure functions that are calculated.
+ * If the value is 0, the fields are stored row-major. Otherwise the fields are stored as cubic bricks of brick_size^3 points, the bricks being
+ * ordered along a Morton (Z-order) curve, and the kernels iterate brick by brick. Both points of a displaced pair then mostly lie within
+ * a few neighbouring bricks, which keeps the accesses page-local for large displacements.
  ********************************************************************************************************************************************
  */
-Array<double,4> SF_Grid_perp;
+int brick_size = -1;
 
 /**
  ********************************************************************************************************************************************
- * \brief   4D array storing the computed scalar structure functions as function of the displacement vector.
+ * \brief   Edge of the tiles in \f$ x \f$ and \f$ y \f$ in which the base points are visited by the kernels for the row-major packed layout.
  *
- *          This array stores the structure functions as function of the displacement vector \f$ \mathbf{l} = (l_x, l_y, l_z )\f$. The fourth
- *          dimension corresponds to the order of the structure functions that are calculated.
+ * The tiles are shared among the OpenMP threads.
  ********************************************************************************************************************************************
  */
-Array<double,4> SF_Grid_scalar;
+int tile_size = -1;
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Number of OpenMP threads used by the packed kernels (0 for the OpenMP default).
+ ********************************************************************************************************************************************
+ */
+int num_threads = -1;
 
 /**
  ********************************************************************************************************************************************
- * \brief   3D array storing the computed longitudinal structure functions as function of the displacement vector.
+ * \brief   Maximum number of structure function results handed over to the background writer and not yet written (0 to write synchronously).
  *
- *          This array stores the structure functions as function of the displacement vector \f$ \mathbf{l} = (l_x, l_z )\f$. The third
- *          dimension corresponds to the order of the structure functions that are calculated.
+ * The results of an analysis are written to the disk by a background thread while the next analysis of a job manifest is computed. A
+ * further result is handed over only after the number of pending results drops below this limit, which caps the memory held by them.
  ********************************************************************************************************************************************
  */
-Array<double,3> SF_Grid2D_pll;
+int write_queue = 1;
 
- /**
+/**
  ********************************************************************************************************************************************
- * \brief   3D array storing the computed transverse structure functions as function of the displacement vector.
+ * \brief   This variable decides whether the components of the velocity field are stacked in a single dataset.
  *
- *          This array stores the structure functions as function of the displacement vector \f$ \mathbf{l} = (l_x, l_z )\f$. The third
- *          dimension corresponds to the order of the structure functions that are calculated.
+ * If "true", the velocity field is read from the file UName and dataset UdName, of shape \f$ (3, N_x, N_y, N_z) \f$ or
+ * \f$ (N_x, N_y, N_z, 3) \f$ for 3D fields and \f$ (2, N_x, N_z) \f$ or \f$ (N_x, N_z, 2) \f$ for 2D fields.
  ********************************************************************************************************************************************
  */
-Array<double,3> SF_Grid2D_perp;
+bool stacked_velocity = false;
 
 /**
  ********************************************************************************************************************************************
- * \brief   3D array storing the computed scalar structure functions as function of the displacement vector.
+ * \brief   Index offsets, counts and strides of the region of the input fields to be read, along \f$ x, y, z \f$ (\f$ x, z \f$ for 2D fields).
  *
- *          This array stores the structure functions as function of the displacement vector \f$ \mathbf{l} = (l_x, l_z )\f$. The third
- *          dimension corresponds to the order of the structure functions that are calculated.
+ * Empty lists select the whole field. A count of 0 selects all the points that fit in the field.
  ********************************************************************************************************************************************
  */
-Array<double,3> SF_Grid2D_scalar;
+vector<int> region_offset, region_count, region_stride;
 
 /**
  ********************************************************************************************************************************************
- * \brief   This variable decides whether the structure functions are to be calculated using 2D or 3D velocity field data.
+ * \brief   Displacement (in grid points) from which the multi-resolution estimator samples the base points more sparsely (0 to use all of them).
  *
- * If "true", then the code will read 2D velocity fields and calculate the corresponding structure functions. Otherwise, it will read 3D velocity
- * fields. Entered by the user
+ * For displacements whose largest component lies in \f$ [2^{L-1} n_c, 2^L n_c) \f$, with \f$ n_c \f$ the crossover, only the base points
+ * on every \f$ 2^L \f$-th grid point along each direction are used; the partner points are still taken at the exact displacement.
  ********************************************************************************************************************************************
  */
-bool two_dimension_switch;
+int pyramid_crossover = 0;
 
 /**
  ********************************************************************************************************************************************
- * \brief    This variable decides whether the scalar or velocity structure functions are to be evaluated.
+ * \brief   Number of blocks along each direction into which the base points are divided to estimate the errors of the structure functions (0 for none).
  *
- * If the value is "true", then scalar structure functions will be evaluated, else the vector (velocity) structure functions will be evaluated.
+ * The sums of the powers of the increments are accumulated per block, and the standard errors are obtained by the delete-one-block jackknife.
  ********************************************************************************************************************************************
  */
-bool scalar_switch;
+int error_blocks = 0;
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Number of logarithmic bins of the magnitude of the displacement in which the structure functions are averaged for the scaling
+ *          summary (0 for no summary).
+ ********************************************************************************************************************************************
+ */
+int scaling_bins = 0;
 
 /**
  ********************************************************************************************************************************************
- * \brief   This variable decides whether the test cases are required to run.
- *
- * If the value is "true", then the input fields will be generated internally and test cases will be run.
+ * \brief   Range \f$ [r_{min}, r_{max}] \f$ of the magnitude of the displacement over which the scaling exponents are fitted (empty for all the bins).
  ********************************************************************************************************************************************
  */
-bool test_switch;
+vector<double> scaling_range;
 
 /**
  ********************************************************************************************************************************************
- * \brief   Number of gridpoints in the \f$ x \f$ direction.
+ * \brief   Order of the reference structure function of the extended self-similarity exponents.
  ********************************************************************************************************************************************
  */
-int Nx;
+int ess_order = 3;
 
 /**
  ********************************************************************************************************************************************
- * \brief   Number of gridpoints in the \f$ y \f$ direction.
+ * \brief   Numbers of bins of the magnitude, the polar angle and the azimuth of the displacement in which the structure functions are
+ *          accumulated for the angular decomposition (empty for none).
  ********************************************************************************************************************************************
  */
-int Ny;
+vector<int> angular_bins;
 
 /**
  ********************************************************************************************************************************************
- * \brief   Number of gridpoints in the \f$ z \f$ direction.
+ * \brief   Largest degree of the real spherical harmonics onto which the structure functions are projected (-1 for none).
  ********************************************************************************************************************************************
  */
-int Nz;
+int angular_degree = -1;
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Names of the file and the dataset of the field on whose value at the base point the structure functions are conditioned (empty for none).
+ ********************************************************************************************************************************************
+ */
+string conditional_file, conditional_dataset;
 
 /**
  ********************************************************************************************************************************************
- * \brief   The first order of the range of orders of the structure functions to be computed. Entered by the user.
+ * \brief   Number of bins of equal population of the conditioning field (used if conditional_edges is empty).
  ********************************************************************************************************************************************
  */
-int q1;
+int conditional_bins = 4;
 
 /**
  ********************************************************************************************************************************************
- * \brief   The last order of the range of orders of the structure functions to be computed. Entered by the user.
+ * \brief   Edges of the bins of the conditioning field (empty for bins of equal population).
  ********************************************************************************************************************************************
  */
-int q2;
+vector<double> conditional_edges;
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Displacements (in grid points, \f$ (x, y, z) \f$ or \f$ (x, z) \f$ for 2D fields) at which the joint PDFs of the increments are
+ *          computed (empty for none).
+ ********************************************************************************************************************************************
+ */
+vector<vector<int> > pdf_separations;
 
 /**
  ********************************************************************************************************************************************
- * \brief   This variable decides whether to calculate both transverse and longitudinal structure functions or only the longitudinal structure
- * functions.
+ * \brief   Numbers of bins of the joint PDFs along the longitudinal increment and along the transverse or scalar increment.
+ ********************************************************************************************************************************************
+ */
+vector<int> pdf_bins(2, 64);
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the joint PDFs of the longitudinal and the scalar increments are computed, the scalar field being
+ *          read from TName and TdName besides the velocity field.
+ ********************************************************************************************************************************************
+ */
+bool pdf_scalar = false;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Axis (for example gravity or rotation) relative to which the two transverse directions of the component structure functions are
+ *          defined (empty for no component structure functions).
  *
- * If the value is false, the code calculates both transverse and longitudinal structure functions. Else, it calculates only the longitudinal
- * structure functions.
+ * For a displacement \f$ \mathbf{l} \f$, the first transverse direction is that of the part of the axis normal to \f$ \mathbf{l} \f$, and the
+ * second one is normal to both.
  ********************************************************************************************************************************************
  */
-bool longitudinal;
+vector<double> transverse_axis;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Field derived from the input fields whose structure functions are computed instead (empty for the input fields): "vorticity",
+ *          or a derivative such as "dUx_dy" or "dT_dz" (see parse_gradient()).
+ ********************************************************************************************************************************************
+ */
+string derived_field;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the input fields are taken as periodic when the derivatives of the derived field are computed.
+ ********************************************************************************************************************************************
+ */
+bool derived_periodic = false;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the sums of the structure functions and the numbers of pairs of points of each displacement are written,
+ *          so that the results of several runs can be merged (see merge_sums()).
+ ********************************************************************************************************************************************
+ */
+bool write_sums = false;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   First and last index along \f$ x \f$ of the displacements to be computed (empty for all the displacements).
+ ********************************************************************************************************************************************
+ */
+vector<int> x_range;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Directory of the result cache (empty for no cache).
+ *
+ * The results of an analysis are stored in the directory under the hash of its input fields and parameters, and copied from it instead of
+ * being computed again by a later run with the same hash.
+ ********************************************************************************************************************************************
+ */
+string cache_dir;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Number of elements per slab when an input dataset is not stored in double precision, or sums files are merged, and per chunk
+ *          when the input fields are hashed.
+ ********************************************************************************************************************************************
+ */
+const hsize_t input_slab_size = hsize_t(1)<<22;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Order in which the displacements are computed: "default" (balanced pairs of small and large displacements) or "radial"
+ *          (increasing magnitude of the displacement, weighted by schedule_priority).
+ ********************************************************************************************************************************************
+ */
+string schedule_order = "default";
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Weights of the components of the displacement along \f$ x, y, z \f$ (or \f$ x, z \f$ for 2D fields) in its magnitude for the
+ *          radial order (empty for equal weights).
+ ********************************************************************************************************************************************
+ */
+vector<double> schedule_priority;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Time in seconds between the writes of the structure functions computed so far (0 for no intermediate writes).
+ ********************************************************************************************************************************************
+ */
+double flush_interval = 0;
 
 /**
  ********************************************************************************************************************************************
- * \brief   This variable stores the distance between two consecutive gridpoints in the \f$ x \f$ direction.
+ * \brief   Walltime budget of the run in seconds (0 for no budget); the environment variable FASTSF_WALLTIME is used if it is not given.
  *
+ * The computation of the displacements stops early when the budget is about to run out, the results computed so far are written, and
+ * a resume file lets a later run with resume_switch compute the remaining displacements.
+ ********************************************************************************************************************************************
+ */
+double walltime = 0;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Maximum number of steps of the displacement loop computed by a run (0 for no limit); the run then stops as if its walltime ran
+ *          out, which splits a computation into runs of a fixed size.
+ ********************************************************************************************************************************************
+ */
+int max_steps = 0;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the run continues from the resume file left by a run stopped by its walltime, if it exists.
+ ********************************************************************************************************************************************
+ */
+bool resume_switch = false;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   File to which the timeline of the activity of every processor is written in the Chrome trace format (empty for no tracing).
  ********************************************************************************************************************************************
  */
-double dx;
+string trace_file;
 
 /**
  ********************************************************************************************************************************************
- * \brief   This variable stores the distance between two consecutive gridpoints in the \f$ y \f$ direction.
+ * \brief   Shortest duration in seconds of the collectives recorded individually in the trace; shorter ones only add to the waiting time of
+ *          their batch of steps.
+ ********************************************************************************************************************************************
+ */
+double trace_threshold = 1e-3;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable is "true" if the events are recorded, i.e. if trace_file is given.
+ ********************************************************************************************************************************************
+ */
+bool trace_enabled = false;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the hardware counters of the processors are read around the kernels of the displacement loop.
  *
+ * If "true", the cycles, instructions and last-level cache misses of the kernels are counted with perf_event_open on Linux, and the
+ * instructions per cycle, the bytes per pair of points and the floating-point rate of every processor are reported.
+ ********************************************************************************************************************************************
+ */
+bool perf_switch = false;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Raw code of the hardware event counting the floating-point operations (empty if the floating-point operations are estimated).
  ********************************************************************************************************************************************
  */
-double dy;
+string flop_event;
 
 /**
  ********************************************************************************************************************************************
- * \brief   This variable stores the distance between two consecutive gridpoints in the \f$ z \f$ direction.
+ * \brief   This variable decides whether the kernel variants are to be benchmarked at startup.
  *
+ * If "true", the candidate layouts, brick and tile sizes and thread counts are timed on a sub-grid of the input fields, the fastest one is
+ * used for the run and is stored in the tuning profile of the host. Otherwise the variant is taken from the tuning profile, if it exists,
+ * for the parameters not specified by the user.
+ ********************************************************************************************************************************************
+ */
+bool tune_switch = false;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable stores the source of the kernel variant used ("defaults", "tuning" or the path of the tuning profile).
  ********************************************************************************************************************************************
  */
-double dz;
+string kernel_variant_source = "defaults";
 
 /**
  ********************************************************************************************************************************************
@@ -367,6 +726,66 @@ int P;
  */
 int px;
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Communicator of the processors computing the structure functions.
+ *
+ * It is MPI_COMM_WORLD, except for a job manifest where it is the communicator of the group of processors running the current analysis. The
+ * rank rank_mpi and the number of processors P are relative to it.
+ ********************************************************************************************************************************************
+ */
+MPI_Comm comm_sf = MPI_COMM_WORLD;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable stores the name of the job manifest listing the analyses to be run concurrently (empty for a single analysis).
+ *
+ ********************************************************************************************************************************************
+ */
+string manifest_name = "";
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   This variable decides whether the analyses of a group of processors run concurrently on separate threads. Set by the job manifest.
+ *
+ ********************************************************************************************************************************************
+ */
+bool concurrent_analyses = false;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Level of thread support provided by the MPI library.
+ *
+ ********************************************************************************************************************************************
+ */
+int mpi_thread_level;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Time (MPI_Wtime) at which the program started, from which the walltime is counted.
+ ********************************************************************************************************************************************
+ */
+double program_start;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Mutex serializing the hdf5 calls of the background writer and of the reads of the main thread.
+ ********************************************************************************************************************************************
+ */
+mutex h5_mutex;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Whether Blitz++ was configured with thread-safe reference counting, which is needed for contexts sharing fields across threads.
+ *
+ ********************************************************************************************************************************************
+ */
+#ifdef BZ_THREADSAFE
+const bool blitz_threadsafe = true;
+#else
+const bool blitz_threadsafe = false;
+#endif
+
 /**
  ********************************************************************************************************************************************
  * \brief   This variable stores the name for the input file for the x-component of the velocity field.
@@ -460,118 +879,537 @@ string SF_Grid_perp_name = "SF_Grid_perp";
 
 /**
  ********************************************************************************************************************************************
- * \brief   The main function of the "fastSF".
+ * \brief   Structure storing the sums of the structure functions over the angular bins and the spherical harmonics of each shell of |l|.
  *
- * \param   argc is the number of command-line arguments passed by the user including the name of the program.
- * \param   argv is the array of character pointers listing all the arguments.
+ *          The sums are weighted by the number of pairs of points of each displacement, and are reduced to means before they are written.
+ ********************************************************************************************************************************************
+ */
+struct Angular_moments {
+    Array<double,4> sector;
+    Array<double,3> sector_count;
+    Array<double,3> harmonic;
+    Array<double,1> shell_count;
+    Array<double,1> r_edges;
+};
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Structure storing the joint PDFs of the increments at the selected displacements, the first dimension of each array being the
+ *          displacement.
  *
+ *          The bins of each displacement span the range of its increments. The PDFs are normalized so that they integrate to 1 over the bins.
  ********************************************************************************************************************************************
  */
-int main(int argc, char *argv[]) {
-    MPI_Init(NULL, NULL);
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank_mpi);
-    MPI_Comm_size(MPI_COMM_WORLD, &P);
-    
-    
-    //Initiallizing h5si
-    h5::init();
-    timeval start_pt, end_pt, start_t, end_t;
+struct Joint_pdfs {
+    Array<double,2> separations;
+    Array<double,1> count;
+    Array<double,3> pll_perp, pll_scalar;
+    Array<double,2> edges_pll, edges_perp, edges_scalar;
+};
 
-    //Record the time of starting of the program
-    gettimeofday(&start_t,NULL);
 
-    double elapsedt=0.0;
-    double elapsepdt=0.0;
-    
-    //Get the input parameters
-    get_Inputs(argc, argv);
-    
-    
-    
-  	
+/**
+ ********************************************************************************************************************************************
+ * \brief   Context of a structure function computation.
+ *
+ *          The context stores the inputs of an analysis, its input fields and its structure functions. The functions reading the fields and
+ *          computing, writing and testing the structure functions only use the context passed to them, so that several analyses can run
+ *          concurrently in one process on separate threads (see run_manifest()). Contexts may reference the same input fields, which are
+ *          then only read. The inputs are copied from the global variables of the same names by init_context().
+ ********************************************************************************************************************************************
+ */
+struct SF_context {
+    bool scalar_switch;
+    bool two_dimension_switch;
+    bool longitudinal;
+    bool test_switch;
+    int Nx, Ny, Nz;
+    int q1, q2;
+    vector<double> orders;
+    bool absolute_moments;
+    double Lx, Ly, Lz;
+    double dx, dy, dz;
+    string UName, VName, WName, TName;
+    string UdName, VdName, WdName, TdName;
+    string SF_Grid_pll_name, SF_Grid_perp_name, SF_Grid_scalar_name;
+    bool stacked_velocity;
+    vector<int> region_offset, region_count, region_stride;
+    int pyramid_crossover;
+    int error_blocks;
+    int scaling_bins;
+    vector<double> scaling_range;
+    int ess_order;
+    vector<int> angular_bins;
+    int angular_degree;
+    string conditional_file, conditional_dataset;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   Number of bins and edges of the conditioning field (0 bins if the structure functions are not conditioned).
+     ****************************************************************************************************************************************
+     */
+    int conditional_bins;
+    vector<double> conditional_edges;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   Fraction of the points of each bin of the conditioning field, and the first group of the sums of each point (the bin of
+     *          the point times the number of blocks, see num_groups()), stored row-major.
+     ****************************************************************************************************************************************
+     */
+    vector<double> conditional_fraction;
+    vector<int> conditional_group;
+    vector<vector<int> > pdf_separations;
+    vector<int> pdf_bins;
+    bool pdf_scalar;
+    vector<double> transverse_axis;
+    string derived_field;
+    bool derived_periodic;
+    bool write_sums;
+    vector<int> x_range;
+    string cache_dir;
+    string schedule_order;
+    vector<double> schedule_priority;
+    double flush_interval;
+    double walltime;
+    int max_steps;
+    bool resume_switch;
+    bool perf_switch;
+    string flop_event;
+    int write_queue;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   Smallest weighted magnitude of the displacements computed at each step of the schedule or later, with an infinite last
+     *          entry, and the time of the last intermediate write of the structure functions (see flush_progress()).
+     ****************************************************************************************************************************************
+     */
+    vector<double> schedule_bound;
+    double last_flush;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   First step of the schedule to be computed (larger than 0 when resumed), number of steps computed once the displacement loop
+     *          ends (smaller than the number of steps if it is stopped by the walltime), and the time at which the loop started.
+     ****************************************************************************************************************************************
+     */
+    int first_step;
+    int steps_done;
+    double loop_start;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   Number of steps per traced batch, first step and start time of the current batch, and the time spent in its collectives.
+     ****************************************************************************************************************************************
+     */
+    int trace_batch;
+    int trace_first;
+    double trace_begin;
+    double trace_wait;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   Hardware counters of the threads of the team (cycles, instructions, cache misses and floating-point operations per thread,
+     *          -1 if not open), their totals, the time spent in the kernels, the start of the current kernel, and the pairs of points.
+     ****************************************************************************************************************************************
+     */
+    vector<int> perf_fds;
+    vector<double> perf_counts;
+    double perf_time;
+    double perf_begin;
+    double perf_pairs;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   Hash of the input fields and the parameters of the analysis, in hexadecimal (empty if it is not computed), and the names of
+     *          the output files written by write_SFs.
+     ****************************************************************************************************************************************
+     */
+    string cache_key;
+    vector<string> output_files;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   Scalar field stored row-major, read besides the velocity field for the joint PDFs of the longitudinal and scalar increments.
+     ****************************************************************************************************************************************
+     */
+    vector<double> pdf_T;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   Joint PDFs of the increments at the selected displacements (on rank 0).
+     ****************************************************************************************************************************************
+     */
+    Joint_pdfs joint_pdf;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   Angular sums of the (longitudinal or scalar) structure functions, and of the transverse structure functions.
+     ****************************************************************************************************************************************
+     */
+    Angular_moments angular[2];
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   Number of points of the stored fields along \f$ x, y, z \f$, of which the region given by region_offset, region_count and
+     *          region_stride is read.
+     ****************************************************************************************************************************************
+     */
+    int Nx_full, Ny_full, Nz_full;
+    string velocity_layout;
+    int brick_size;
+    int tile_size;
+    int num_threads;
+    bool tune_switch;
+    string kernel_variant_source;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   Number of OpenMP threads of the team running the packed kernels of this context.
+     ****************************************************************************************************************************************
+     */
+    int team_size;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   Communicator of the processors computing the structure functions, the rank of this processor in it, the number of
+     *          processors and the number of processors along \f$ x \f$.
+     ****************************************************************************************************************************************
+     */
+    MPI_Comm comm;
+    int rank_mpi, P, px;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   3D array storing the input 3D scalar field.
+     ****************************************************************************************************************************************
+     */
+    Array <double,3> T;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   3D array storing the x-component of the input 3D velocity field.
+     ****************************************************************************************************************************************
+     */
+    Array <double,3> V1;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   3D array storing the y-component of the input 3D velocity field.
+     ****************************************************************************************************************************************
+     */
+    Array <double,3> V2;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   3D array storing the z-component of the input 3D velocity field.
+     ****************************************************************************************************************************************
+     */
+    Array <double,3> V3;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   1D array storing the input 3D velocity field in the interleaved (and possibly bricked) layout.
+     *
+     *          The three components of the velocity at a grid point are stored next to each other, padded to 4 doubles. The position of the
+     *          grid point \f$ (i,j,k) \f$ is given by the offset tables point_offset_x, point_offset_y and point_offset_z. It is built from V1,
+     *          V2 and V3 only if the interleaved layout or the bricked storage is selected.
+     ****************************************************************************************************************************************
+     */
+    Array <double,1> V_packed;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   1D array storing the input 3D scalar field in the bricked layout.
+     *
+     *          Built from T only if the bricked storage is selected.
+     ****************************************************************************************************************************************
+     */
+    Array <double,1> T_packed;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   Offset tables of the packed fields along \f$ x \f$, \f$ y \f$ and \f$ z \f$.
+     *
+     *          The grid point \f$ (i,j,k) \f$ of a packed field is stored at point_offset_x(i) + point_offset_y(j) + point_offset_z(k), in units
+     *          of grid points.
+     ****************************************************************************************************************************************
+     */
+    Array <long,1> point_offset_x, point_offset_y, point_offset_z;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   2D array storing the input 2D scalar field.
+     ****************************************************************************************************************************************
+     */
+    Array <double,2> T_2D;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   2D array storing the x-component of the input 2D velocity field.
+     ****************************************************************************************************************************************
+     */
+    Array<double,2> V1_2D;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   2D array storing the z-component of the input 2D velocity field.
+     ****************************************************************************************************************************************
+     */
+    Array<double,2> V3_2D;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   4D array storing the computed longitudinal structure functions as function of the displacement vector.
+     *
+     *          This array stores the structure functions as function of the displacement vector \f$ \mathbf{l} = (l_x, l_y, l_z )\f$. The fourth
+     *          dimension corresponds to the order of the structure functions that are calculated.
+     ****************************************************************************************************************************************
+     */
+    Array<double,4> SF_Grid_pll;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   4D array storing the computed transverse structure functions as function of the displacement vector.
+     *
+     *          This array stores the structure functions as function of the displacement vector \f$ \mathbf{l} = (l_x, l_y, l_z )\f$. The fourth
+     *          dimension corresponds to the order of the structure functions that are calculated.
+     ****************************************************************************************************************************************
+     */
+    Array<double,4> SF_Grid_perp;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   4D array storing the computed scalar structure functions as function of the displacement vector.
+     *
+     *          This array stores the structure functions as function of the displacement vector \f$ \mathbf{l} = (l_x, l_y, l_z )\f$. The fourth
+     *          dimension corresponds to the order of the structure functions that are calculated.
+     ****************************************************************************************************************************************
+     */
+    Array<double,4> SF_Grid_scalar;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   3D array storing the computed longitudinal structure functions as function of the displacement vector.
+     *
+     *          This array stores the structure functions as function of the displacement vector \f$ \mathbf{l} = (l_x, l_z )\f$. The third
+     *          dimension corresponds to the order of the structure functions that are calculated.
+     ****************************************************************************************************************************************
+     */
+    Array<double,3> SF_Grid2D_pll;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   3D array storing the computed transverse structure functions as function of the displacement vector.
+     *
+     *          This array stores the structure functions as function of the displacement vector \f$ \mathbf{l} = (l_x, l_z )\f$. The third
+     *          dimension corresponds to the order of the structure functions that are calculated.
+     ****************************************************************************************************************************************
+     */
+    Array<double,3> SF_Grid2D_perp;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   3D array storing the computed scalar structure functions as function of the displacement vector.
+     *
+     *          This array stores the structure functions as function of the displacement vector \f$ \mathbf{l} = (l_x, l_z )\f$. The third
+     *          dimension corresponds to the order of the structure functions that are calculated.
+     ****************************************************************************************************************************************
+     */
+    Array<double,3> SF_Grid2D_scalar;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   Arrays storing the jackknife standard errors of the structure functions, of the shape of the corresponding SF_Grid arrays
+     *          (allocated only if error_blocks is larger than 1).
+     ****************************************************************************************************************************************
+     */
+    Array<double,4> SF_Grid_pll_err, SF_Grid_perp_err, SF_Grid_scalar_err;
+    Array<double,3> SF_Grid2D_pll_err, SF_Grid2D_perp_err, SF_Grid2D_scalar_err;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   Arrays storing the conditional structure functions, the first dimension being the bin of the conditioning field and the others
+     *          those of the corresponding SF_Grid arrays (allocated only if the structure functions are conditioned).
+     ****************************************************************************************************************************************
+     */
+    Array<double,5> SF_Grid_pll_cond, SF_Grid_perp_cond, SF_Grid_scalar_cond;
+    Array<double,4> SF_Grid2D_pll_cond, SF_Grid2D_perp_cond, SF_Grid2D_scalar_cond;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   Array storing the component structure functions of a 3D velocity field, the first dimension being the increment: \f$ \delta u_x,
+     *          \delta u_y, \delta u_z \f$ and the increments along the two transverse directions (allocated only if transverse_axis is given).
+     ****************************************************************************************************************************************
+     */
+    Array<double,5> SF_Grid_comp;
+
+    /**
+     ****************************************************************************************************************************************
+     * \brief   Arrays storing the number of pairs of points of each displacement, with a last dimension of 1 (allocated only if write_sums is
+     *          set).
+     ****************************************************************************************************************************************
+     */
+    Array<double,4> SF_count;
+    Array<double,3> SF_count_2D;
+};
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Structure describing an input dataset opened for reading, which is closed when it goes out of scope (also when its analysis fails).
+ ********************************************************************************************************************************************
+ */
+struct Input_dataset {
+    string path;
+    hid_t file = -1;
+    hid_t dset = -1;
+    hid_t type = -1;
+    vector<hsize_t> dims;
+    vector<hsize_t> full_dims;
+    vector<hsize_t> offset;
+    vector<hsize_t> stride;
+    int component_axis = -1;
+    ~Input_dataset() { close_input(*this); }
+};
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Structure storing the structure functions averaged over bins of the magnitude of the displacement, and the exponents fitted to them.
+ ********************************************************************************************************************************************
+ */
+struct Scaling_summary {
+    Array<double,1> r;
+    Array<double,1> count;
+    Array<double,2> S;
+    Array<double,2> slope;
+    Array<double,1> zeta;
+    Array<double,1> ess;
+    Array<double,1> fit_range;
+};
 
-    //Resizing the input fields
-    Read_fields();
+/**
+ ********************************************************************************************************************************************
+ * \brief   Structure storing the results of an analysis handed over to the background writer, with the names of their files.
+ *
+ *          The writer job holds the only reference to the structure, and the structure the only references to its arrays: the reference
+ *          counts of Blitz++ arrays are not atomic unless Blitz++ is configured with --enable-threadsafe. resolved_l is the attribute of
+ *          a partial result written by flush_progress(), and is negative for the final results.
+ ********************************************************************************************************************************************
+ */
+struct Written_results {
+    vector<string> labels;
+    vector<pair<Array<double,3>, string> > grids_2D, sums_2D;
+    Array<double,3> count_2D;
+    vector<pair<Array<double,4>, string> > grids, sums;
+    Array<double,4> count;
+    vector<pair<Scaling_summary, string> > summaries;
+    vector<pair<Angular_moments, string> > angular;
+    vector<double> edges, fraction;
+    string bins_file;
+    vector<pair<Joint_pdfs, string> > joint_pdf;
+    double resolved_l;
+    Written_results() : resolved_l(-1) {}
+};
 
-    if (rank_mpi==0) {
-    	cout<<"\nNumber of processors in x direction: "<<px<<endl;
-    	if (two_dimension_switch) {
-        	cout<<"Number of processors in z direction: "<<P/px<<endl;
-    	}
-    	else {
-        	cout<<"Number of processors in y direction: "<<P/px<<endl;
-    	}
-  	}  
+/**
+ ********************************************************************************************************************************************
+ * \brief   Structure storing an event of the trace: a named interval of time of a thread, with up to two integer arguments (-1 if unused)
+ *          and the time spent waiting in collectives (negative if unused).
+ ********************************************************************************************************************************************
+ */
+struct Trace_event {
+    const char* name;
+    const char* category;
+    double begin;
+    double end;
+    int thread;
+    long first;
+    long last;
+    double wait;
+};
 
- 	if (px > P) {
-        if (rank_mpi==0) {
-            cout<<"ERROR! Number of processors in x direction has to be less than or equal to the total number of processors! Aborting.."<<endl;
-        }
-        h5::finalize();
-        MPI_Finalize();
-        exit(1);
-    }
-    if (Nx/2%px != 0) {
-        if (rank_mpi==0){
-            cout<<"ERROR! Number of processors in x direction should be less or equal to Nx/2 and some power of 2\n Aborting...\n";
+/**
+ ********************************************************************************************************************************************
+ * \brief   Structure recording the interval between its construction and its destruction as an event of the trace, if tracing is enabled.
+ ********************************************************************************************************************************************
+ */
+struct Trace_scope {
+    const char* name;
+    const char* category;
+    double begin;
+    Trace_scope(const char* n, const char* cat) : name(n), category(cat), begin(trace_clock()) {}
+    ~Trace_scope() {
+        if (trace_enabled) {
+            trace_event(name, category, begin, MPI_Wtime(), -1, -1, -1);
         }
-        h5::finalize();
-        MPI_Finalize();
-        exit(1);
-    }
-
-    int N2;
-
-    if (two_dimension_switch) {
-        N2 = Nz;
-    }
-    else {
-        N2 = Ny;
     }
+};
 
-    if (N2/2%(P/px) != 0) {
-        if (rank_mpi==0){
-            cout<<"ERROR! Number of processors in y (or z) direction should be less or equal to Ny/2 (or Nz/2) and some power of 2\n Aborting...\n";
-        }
-        h5::finalize();
-        MPI_Finalize();
-        exit(1);
-    } 
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   The main function of the "fastSF".
+ *
+ * \param   argc is the number of command-line arguments passed by the user including the name of the program.
+ * \param   argv is the array of character pointers listing all the arguments.
+ *
+ ********************************************************************************************************************************************
+ */
+int main(int argc, char *argv[]) {
+    MPI_Init_thread(NULL, NULL, MPI_THREAD_MULTIPLE, &mpi_thread_level);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank_mpi);
+    MPI_Comm_size(MPI_COMM_WORLD, &P);
+    program_start = MPI_Wtime();
+    
+    //Initiallizing h5si
+    h5::init();
+    timeval start_t, end_t;
 
-    //Resize the structure function array according to the type of inputs
-    resize_SFs();
+    //Record the time of starting of the program
+    gettimeofday(&start_t,NULL);
 
+    double elapsedt=0.0;
     
-    //Record the time of starting the parallel processing
-    gettimeofday(&start_pt,NULL);
+    //Merge the sums written by several runs, without reading para.yaml
+    for (int i=1; i<argc; i++) {
+        if (string(argv[i]) == "--merge") {
+            merge_sums(argc-i-1, argv+i+1);
+            h5::finalize();
+            MPI_Finalize();
+            return 0;
+        }
+    }
 
-    //Calculating the structure functions
-    calc_SFs();
+    //Keep the inputs not read from para.yaml, to restore them before each analysis of a job manifest
+    reset_inputs(true);
 
+    //Get the input parameters
+    get_Inputs(argc, argv);
 
-    //Record the time of ending of parallel processing
-    gettimeofday(&end_pt,NULL);
+    //Start the timeline of the processors
+    trace_init();
     
- 
-    //Write the SF array to disk
-    write_SFs();
-
-    if (test_switch){
-        test_cases();
+    if (manifest_name!="") {
+        run_manifest(argc, argv);
+    }
+    else {
+        run_analysis();
     }
 
+    //Wait for the results still being written
+    stop_writer();
+
+    //Write the timeline of all the processors
+    write_trace();
+
     //Record the time when the program ends
     gettimeofday(&end_t,NULL);
     
     compute_time_elapsed(start_t, end_t, elapsedt);
-    compute_time_elapsed(start_pt, end_pt, elapsepdt);
     
     
     if (rank_mpi==0) {
-        cout<<"\nTime elapsed for the parallel part: "<<elapsepdt<<endl;
         cout<<"\nTotal time elapsed: "<<elapsedt<<endl;
         cout<<"\nProgram ends."<<endl;
    }
@@ -582,1280 +1420,6907 @@ int main(int argc, char *argv[]) {
 }
 
 /**
-******************************************************************************************************************************
-*\brief  Function to calculate dx, dy and dz
-*
-******************************************************************************************************************************
-*/
-void calculate_grid_spacing(){
-	//Specify the values of dx, dy, and dz
-    if (Nx==1){dx=0;}
-    else{
-      dx=Lx/double(Nx-1);}
-    if (Ny==1){dy=0;}
-    else{
-      dy=Ly/double(Ny-1);}
-    if (Nz==1){dz=0;}
-    else{
-      dz=Lz/double(Nz-1);
-  	}
-}
+ ********************************************************************************************************************************************
+ * \brief   Function to compute the structure functions for the inputs given by get_Inputs, with the processors of comm_sf.
+ *
+ ********************************************************************************************************************************************
+ */
+void run_analysis() {
+    SF_context c;
+    init_context(c);
 
+    //Resizing the input fields
+    Read_fields(c);
 
-/**
-*************************************************************************************************************************************
-*\brief     Function to covert string to bool
-*           
-*************************************************************************************************************************************
-*/
-bool str_to_bool(string s){
-	if (s=="true" || s=="1"){
-		return true;
-	}
-	else if (s=="false" || s=="0"){
-		return false;
-	}
-	else{
-        if (rank_mpi==0)
-            cout<<"Invalid input\n";
-		exit(1);
-	}
+    //Copy the results from the cache if they have already been computed
+    if (restore_cached(c)) {
+        return;
+    }
+
+    prepare_analysis(c, NULL);
+
+    double elapsepdt = compute_analysis(c);
+
+    finish_analysis(c, elapsepdt);
 }
 
 
 /**
-********************************************************************************************************************************
-*\brief    Function to check whether the file exists or not. Furthermore it saves the shape of the dataset.
-*
-*\param fold is data path
-*\param file is the file name
-*\param dset is the dataset name
-*\param s is array in which shape will be saved
-*
-********************************************************************************************************************************
-*/
-void get_input_shape(string fold, string file, string dset, Array<int,1>& s){
-	ifstream file_name(fold+file+".h5");
-	int dim;
-	s.resize(4);
-	if (file_name.is_open()){
-    	file_name.close();
-    	h5::File f(fold+file+".h5", "r");
-    	h5::Dataset data_set;
-    	data_set=(f[dset]);
-    	dim=data_set.shape().size();
-  		if (dim==2){
-  			two_dimension_switch=true;
-  			Nx=data_set.shape()[0];
-  			Ny=1;
-  			Nz=data_set.shape()[1];
-  		}
-  		else{
-  			two_dimension_switch=false;
-			Nx=data_set.shape()[0];
-  			Ny=data_set.shape()[1];
-  			Nz=data_set.shape()[2];  			
-  		}
-  		
-  		s(0)=dim;
-  		s(1)=Nx;
-  		s(2)=Ny;
-  		s(3)=Nz;
-  		
-  		
-  	}
-  	else{
-    	file_name.close();
-    	if (rank_mpi==0){
-        	cerr<<"\nDesired file does not exist\n\n";
-        	show_checklist();
-    	}
-    	h5::finalize();
-        MPI_Finalize();
-    	exit(1);
+ ********************************************************************************************************************************************
+ * \brief   Function to copy the inputs of an analysis from the global variables into its context.
+ *
+ * \param   c is the context to be initialized.
+ ********************************************************************************************************************************************
+ */
+void init_context(SF_context& c) {
+    c.scalar_switch = scalar_switch;
+    c.two_dimension_switch = two_dimension_switch;
+    c.longitudinal = longitudinal;
+    c.test_switch = test_switch;
+    c.Nx = Nx;
+    c.Ny = Ny;
+    c.Nz = Nz;
+    c.q1 = q1;
+    c.q2 = q2;
+    c.orders = orders;
+    c.absolute_moments = absolute_moments and orders.empty();
+    if (not orders.empty()) {
+        c.q1 = 1;
+        c.q2 = orders.size();
     }
-	
+    c.Lx = Lx;
+    c.Ly = Ly;
+    c.Lz = Lz;
+    c.dx = c.dy = c.dz = 0;
+    c.UName = UName;
+    c.VName = VName;
+    c.WName = WName;
+    c.TName = TName;
+    c.UdName = UdName;
+    c.VdName = VdName;
+    c.WdName = WdName;
+    c.TdName = TdName;
+    c.SF_Grid_pll_name = SF_Grid_pll_name;
+    c.SF_Grid_perp_name = SF_Grid_perp_name;
+    c.SF_Grid_scalar_name = SF_Grid_scalar_name;
+    c.stacked_velocity = stacked_velocity;
+    c.region_offset = region_offset;
+    c.region_count = region_count;
+    c.region_stride = region_stride;
+    c.pyramid_crossover = pyramid_crossover;
+    c.error_blocks = error_blocks;
+    c.scaling_bins = scaling_bins;
+    c.scaling_range = scaling_range;
+    c.ess_order = ess_order;
+    c.angular_bins = angular_bins;
+    c.angular_degree = angular_degree;
+    c.conditional_file = conditional_file;
+    c.conditional_dataset = conditional_dataset;
+    c.conditional_bins = conditional_file.empty() ? 0 : (conditional_edges.empty() ? conditional_bins : conditional_edges.size()-1);
+    c.conditional_edges = conditional_edges;
+    c.pdf_separations = pdf_separations;
+    c.pdf_bins = pdf_bins;
+    c.pdf_scalar = pdf_scalar;
+    c.transverse_axis = transverse_axis;
+    c.derived_field = derived_field;
+    c.derived_periodic = derived_periodic;
+    c.write_sums = write_sums;
+    c.x_range = x_range;
+    c.cache_dir = cache_dir;
+    c.schedule_order = schedule_order;
+    c.schedule_priority = schedule_priority;
+    c.flush_interval = flush_interval;
+    c.walltime = walltime;
+    c.max_steps = max_steps;
+    c.resume_switch = resume_switch;
+    c.perf_switch = perf_switch;
+    c.flop_event = flop_event;
+    c.write_queue = write_queue;
+    c.first_step = 0;
+    c.steps_done = 0;
+    c.Nx_full = Nx;
+    c.Ny_full = Ny;
+    c.Nz_full = Nz;
+    c.velocity_layout = velocity_layout;
+    c.brick_size = brick_size;
+    c.tile_size = tile_size;
+    c.num_threads = num_threads;
+    c.tune_switch = tune_switch;
+    c.kernel_variant_source = kernel_variant_source;
+    c.team_size = omp_get_max_threads();
+    c.comm = comm_sf;
+    MPI_Comm_rank(c.comm, &c.rank_mpi);
+    MPI_Comm_size(c.comm, &c.P);
+    c.px = px;
 }
 
 
-
 /**
-******************************************************************************************************************************
-\brief Resize input arrays
-*
-******************************************************************************************************************************
-*/
-
-void resize_input(){
-	if(two_dimension_switch){
-        if (scalar_switch) {
-            T_2D.resize(Nx, Nz);
-        }
-        else {
-            V1_2D.resize(Nx, Nz);
-            V3_2D.resize(Nx, Nz);
-        }
-        
+ ********************************************************************************************************************************************
+ * \brief   Function to check whether two analyses use the same input fields.
+ *
+ * \param   a, b are the contexts of the analyses.
+ ********************************************************************************************************************************************
+ */
+bool same_fields(SF_context& a, SF_context& b) {
+    if (a.test_switch != b.test_switch or a.scalar_switch != b.scalar_switch or a.two_dimension_switch != b.two_dimension_switch) {
+        return false;
     }
-    else{
-        if (scalar_switch) {
-            T.resize(Nx, Ny, Nz);
-        }
-        else {
-            V1.resize(Nx,Ny,Nz);
-            V2.resize(Nx,Ny,Nz);
-            V3.resize(Nx,Ny,Nz);
-        }
-        
+    if (a.derived_field != b.derived_field or (not a.derived_field.empty() and a.derived_periodic != b.derived_periodic)) {
+        return false;
+    }
+    if (a.test_switch) {
+        return a.Nx==b.Nx and a.Ny==b.Ny and a.Nz==b.Nz and a.Lx==b.Lx and a.Ly==b.Ly and a.Lz==b.Lz;
+    }
+    if (a.Lx != b.Lx or a.Ly != b.Ly or a.Lz != b.Lz or a.region_offset != b.region_offset or a.region_count != b.region_count
+        or a.region_stride != b.region_stride) {
+        return false;
     }
+    if (a.scalar_switch) {
+        return a.TName==b.TName and a.TdName==b.TdName;
+    }
+    if (a.stacked_velocity != b.stacked_velocity) {
+        return false;
+    }
+    if (a.stacked_velocity) {
+        return a.UName==b.UName and a.UdName==b.UdName;
+    }
+    return a.UName==b.UName and a.UdName==b.UdName and a.VName==b.VName and a.VdName==b.VdName and a.WName==b.WName
+        and a.WdName==b.WdName;
 }
 
 
 /**
-********************************************************************************************************************************
-*\brief compare two integer arrays
-*
-*
-*\param A is the first array
-*\param B is the second array
-*
-********************************************************************************************************************************
-*/
-bool compare(Array<int,1> A, Array<int,1> B){
-	int N=A.size();
-	for (int i=0; i<N; i++){
-		if (A(i)!=B(i)){
-			return false;
-		}
-	}
-	return true;
+ ********************************************************************************************************************************************
+ * \brief   Function to make a context reference the input fields already read into another context, instead of reading them again.
+ *
+ * \param   c is the context receiving the fields.
+ * \param   source is the context whose fields are referenced.
+ ********************************************************************************************************************************************
+ */
+void share_fields(SF_context& c, SF_context& source) {
+    c.Nx = source.Nx;
+    c.Ny = source.Ny;
+    c.Nz = source.Nz;
+    c.dx = source.dx;
+    c.dy = source.dy;
+    c.dz = source.dz;
+    c.T.reference(source.T);
+    c.V1.reference(source.V1);
+    c.V2.reference(source.V2);
+    c.V3.reference(source.V3);
+    c.T_2D.reference(source.T_2D);
+    c.V1_2D.reference(source.V1_2D);
+    c.V3_2D.reference(source.V3_2D);
 }
 
 
-
 /**
-*************************************************************************************************************************************
-*\brief     Function to generate or read the input fields.
-*
-*
-*\param     UName is the name of the hdf5 file and dataset storing the x-component of velocity / vector field. 
-*\param     VName is the name of the hdf5 file and dataset storing the y-component of velocity / vector field.
-*\param     WName is the name of the hdf5 file and dataset storing the z-component of velocity / vector field.
-*\param     TName is the name of the hdf5 file and dataset storing the scalar field.
-* 
-*************************************************************************************************************************************
-*/
-void Read_fields() {
-    //Defining the input fields
-    if (!test_switch){
-    	if (rank_mpi==0){
-            cout<<"Reading from the hdf5 files\n";
-        }
-        Array<int,1> s1,s2, s3;
-        
-        if (two_dimension_switch){
-            if (scalar_switch) {
-            	get_input_shape("in/", TName, TdName, s1);
-                resize_input();
-                calculate_grid_spacing();
-                read_2D(T_2D,"in/", TName, TdName);
-            }
-            else {
-            	get_input_shape("in/", UName, UdName, s1);
-                get_input_shape("in/", WName, WdName, s2);
-                
-                if (!compare(s1,s2)){
-                	if (rank_mpi==0){
-            			cerr<<"\nIncompatible dimension data\n\n";
-            			show_checklist();
-        			}
-                	h5::finalize();
-        			MPI_Finalize();
-        			exit(1);
-                }
-                
-                resize_input();
-                calculate_grid_spacing();
-                read_2D(V1_2D,"in/", UName, UdName);
-                read_2D(V3_2D,"in/", WName, WdName);
-            }
+ ********************************************************************************************************************************************
+ * \brief   Function to prepare the computation of the structure functions once the input fields are read.
+ *
+ *          The derived field is computed if required, the variant of the kernels is chosen, the fields are packed if required, the decomposition over the processors is checked and
+ *          the structure function arrays are allocated.
+ *
+ * \param   c is the context of the analysis.
+ * \param   source is a context with the same input fields that has already been prepared, whose packed fields are referenced if the
+ *          variants match (NULL to always pack the fields).
+ ********************************************************************************************************************************************
+ */
+void prepare_analysis(SF_context& c, SF_context* source) {
+    Trace_scope trace("prepare", "compute");
+    //Replace the input fields by the derived field
+    derive_fields(c);
+
+    //Assign the base points to the bins of the conditioning field
+    if (c.conditional_bins > 0) {
+        read_conditional_field(c);
+    }
+
+    //Read the scalar field of the joint PDFs of the longitudinal and scalar increments
+    if (c.pdf_scalar) {
+        read_matching_field(c, c.TName, c.TdName, c.pdf_T);
+    }
+    if (not c.transverse_axis.empty() and c.two_dimension_switch) {
+        if (c.rank_mpi==0) {
+            cerr<<"\nThe component structure functions are computed only for 3D velocity fields\n\n";
         }
-        else{
-        	
-            if (scalar_switch) {
-            	get_input_shape("in/", TName, TdName, s1);
-            	resize_input();
-            	calculate_grid_spacing();
-                read_3D(T, "in/", TName, TdName);
-            }
-            else {
-            	
-            	get_input_shape("in/", UName, UdName, s1);
-            	get_input_shape("in/", VName, VdName, s2);
-            	get_input_shape("in/", WName, WdName, s3);
-            	
-            	if (!compare(s1,s2)){
-            		if (rank_mpi==0){
-            			cerr<<"\nIncompatible dimension data\n\n";
-            			show_checklist();
-        			}
-        			h5::finalize();
-        			MPI_Finalize();
-        			exit(1);
-                }
-                if (!compare(s2,s3)){
-                	if (rank_mpi==0){
-            			cerr<<"\nIncompatible dimension data\n\n";
-            			show_checklist();
-        			}
-                	h5::finalize();
-        			MPI_Finalize();
-        			exit(1);
-                }
-                if (!compare(s3,s1)){
-                	if (rank_mpi==0){
-            			cerr<<"\nIncompatible dimension data\n\n";
-            			show_checklist();
-        			}
-                	h5::finalize();
-        			MPI_Finalize();
-        			exit(1);
-                }
-            	resize_input();
-            	calculate_grid_spacing();
-                read_3D(V1, "in/", UName, UdName);
-                read_3D(V2, "in/", VName, VdName);
-                read_3D(V3, "in/", WName, WdName);
+        fail_analysis();
+    }
+    for (size_t s=0; s<c.pdf_separations.size(); s++) {
+        const vector<int>& l = c.pdf_separations[s];
+        bool fits = c.two_dimension_switch ? (l.size() == 2 and l[0] < c.Nx and l[1] < c.Nz)
+                                           : (l.size() == 3 and l[0] < c.Nx and l[1] < c.Ny and l[2] < c.Nz);
+        if (not fits) {
+            if (c.rank_mpi==0) {
+                cerr<<"\nThe displacement "<<s+1<<" of the joint PDFs does not fit in the grid of the input fields\n\n";
             }
+            fail_analysis();
         }
-    } 
-    else {
-        if (rank_mpi==0){
-            cout<<"\nWARNING: The code is running in TEST mode. It will generate velocity / scalar fields and will take them as inputs.\n";
-        }
-        resize_input();
-        calculate_grid_spacing();
-        if (two_dimension_switch) {
-            if (scalar_switch) {
-                Read_Init(T_2D);
+    }
+
+    //Choose the layout, the tiles and the number of threads of the kernels
+    choose_kernel_variant(c);
+
+    //Repack the fields if the interleaved layout or the bricked storage is chosen
+    if (not c.two_dimension_switch) {
+        if (source != NULL and source->velocity_layout==c.velocity_layout and source->brick_size==c.brick_size) {
+            c.V_packed.reference(source->V_packed);
+            c.T_packed.reference(source->T_packed);
+            c.point_offset_x.reference(source->point_offset_x);
+            c.point_offset_y.reference(source->point_offset_y);
+            c.point_offset_z.reference(source->point_offset_z);
+            if (c.V_packed.size() > 0) {
+                c.V1.free();
+                c.V2.free();
+                c.V3.free();
             }
-            else {
-                Read_Init(V1_2D, V3_2D);
+            if (c.T_packed.size() > 0) {
+                c.T.free();
             }
         }
         else {
-            if (scalar_switch) {
-                Read_Init(T);
-            }
-            else {
-                Read_Init(V1, V2, V3);
-            }
+            pack_fields(c);
         }
     }
-}
 
-/**
-*************************************************************************************************************************************
-*\brief     Function resize the structure function arrays according to the inputs.
-*  
-*************************************************************************************************************************************
-*/
-void resize_SFs(){
-    if (rank_mpi==0) {
-        if (not two_dimension_switch) {
-            if (scalar_switch) {
-                SF_Grid_scalar.resize(Nx/2, Ny/2, Nz/2, q2-q1+1);
-                SF_Grid_scalar = 0; 
-            }
-            else {
-                SF_Grid_pll.resize(Nx/2, Ny/2, Nz/2, q2-q1+1);
-                SF_Grid_pll = 0;
-                if (not longitudinal) {
-                    SF_Grid_perp.resize(Nx/2, Ny/2, Nz/2, q2-q1+1);
-                    SF_Grid_perp = 0;
-                }
-            }
-            
+    if (c.rank_mpi==0) {
+    	cout<<"\nNumber of processors in x direction: "<<c.px<<endl;
+    	if (c.two_dimension_switch) {
+        	cout<<"Number of processors in z direction: "<<c.P/c.px<<endl;
+    	}
+    	else {
+        	cout<<"Number of processors in y direction: "<<c.P/c.px<<endl;
+    	}
+    	if (c.pyramid_crossover > 0) {
+    	    cout<<"Multi-resolution estimator: every 2^L-th base point for displacements of "<<c.pyramid_crossover
+    	        <<"*2^(L-1) to "<<c.pyramid_crossover<<"*2^L points"<<endl;
+    	}
+    	if (c.error_blocks > 1) {
+    	    cout<<"Jackknife errors from "<<num_blocks(c)<<" blocks of base points"<<endl;
+    	}
+  	}  
+
+ 	if (c.px > c.P) {
+        if (c.rank_mpi==0) {
+            cout<<"ERROR! Number of processors in x direction has to be less than or equal to the total number of processors! Aborting.."<<endl;
         }
-        else {
-            if (scalar_switch) {
-                SF_Grid2D_scalar.resize(Nx/2, Nz/2, q2-q1+1);
-                SF_Grid2D_scalar = 0; 
-            }
-            else {
-                SF_Grid2D_pll.resize(Nx/2, Nz/2, q2-q1+1);
-                SF_Grid2D_pll = 0; 
-                if (not longitudinal) {
-                    SF_Grid2D_perp.resize(Nx/2, Nz/2, q2-q1+1);
-                    SF_Grid2D_perp = 0;
-                }
-            }
-        }   
+        fail_analysis();
     }
-}
-
-/**
-*************************************************************************************************************************************
-*\brief     Function to compute the structure functions based on the inputs provided by the user.
-*************************************************************************************************************************************
-*/
-void calc_SFs() {
-    if (two_dimension_switch){
-        if (scalar_switch) {
-            SF_scalar_2D(T_2D);
-        }
-        else {
-            if (longitudinal) {
-                SFunc_long_2D(V1_2D, V3_2D);
-            } 
-            else {
-                SFunc2D(V1_2D, V3_2D);
-            }
-        }
-    }
-    
-    else {
-        if (scalar_switch) {
-            SF_scalar_3D(T); 
-        }
-        else {
-            if (longitudinal) {
-                SFunc_long_3D(V1, V2, V3);
-            }
-            else {
-                SFunc3D(V1, V2, V3);
-            }
+    if (c.Nx/2%c.px != 0) {
+        if (c.rank_mpi==0){
+            cout<<"ERROR! Number of processors in x direction should be less or equal to Nx/2 and some power of 2\n Aborting...\n";
         }
+        fail_analysis();
     }
-}
 
-/**
-*************************************************************************************************************************************
-*\brief     Function to write the structure function arrays to the disk.
-*************************************************************************************************************************************
-*/
-void write_SFs() {
-    if (rank_mpi==0){
-        mkdir("out",0777);
-       
+    int N2;
 
-        if (two_dimension_switch) {
-            
-            if (scalar_switch){
-                write_3D(SF_Grid2D_scalar, SF_Grid_scalar_name);
-            }
-            else {
-                write_3D(SF_Grid2D_pll, SF_Grid_pll_name);    
-                if (not longitudinal) {
-                    write_3D(SF_Grid2D_perp, SF_Grid_perp_name);
-                }
-            }
-            cout<<"\nWriting completed\n";
-        }
-        else {
-            
-            if (scalar_switch){
-                write_4D(SF_Grid_scalar, SF_Grid_scalar_name);
-            }
-            else {
-            	write_4D(SF_Grid_pll, SF_Grid_pll_name);    
-                if (not longitudinal) {
-                    write_4D(SF_Grid_perp, SF_Grid_perp_name);
-                }
-            }
-            cout<<"\nWriting completed\n";
-        }
+    if (c.two_dimension_switch) {
+        N2 = c.Nz;
+    }
+    else {
+        N2 = c.Ny;
     }
-}
 
-/**
-*************************************************************************************************************************************
-*\brief     Function to test the correctness of the code.
-*************************************************************************************************************************************
-*/
-void test_cases() {
-    if(rank_mpi==0){
-        cout<<"\nCOMMENCING TESTING OF THE CODE.\n";
-        if (scalar_switch){
-            if (two_dimension_switch){
-                SCALAR_TEST_CASE_2D();
-            }
-            else{
-                SCALAR_TEST_CASE_3D();
-            }
-        }
-        else{
-            if (two_dimension_switch){
-                VECTOR_TEST_CASE_2D();
-            }
-            else{
-                VECTOR_TEST_CASE_3D();
-            }
+    if (N2/2%(c.P/c.px) != 0) {
+        if (c.rank_mpi==0){
+            cout<<"ERROR! Number of processors in y (or z) direction should be less or equal to Ny/2 (or Nz/2) and some power of 2\n Aborting...\n";
         }
-    }
-    
-}
+        fail_analysis();
+    } 
 
 
-/**
-*************************************************************************************************************************************
-*\brief     Function to obtain the \$ x \$ and \$ y \$ ranks of the processor.
-*
-*
-*\param     rank is the rank of the processor.
-*\param     py is the number of processors in \$ y \$ direction.
-*\param     rankx is the \$ x \$ rank of the processor.
-*\param     ranky is the \$ y \$ rank of the processor.
-* 
-*************************************************************************************************************************************
-*/
-void get_rank(int rank, int py, int& rankx, int& ranky){
-    ranky=rank%py;
-    rankx=(rank-ranky)/py;
-}
+    //Find the step from which a stopped run is resumed
+    read_resume(c);
 
-/**
-*************************************************************************************************************************************
-*\brief     Function to allocate the index list along a given direction for a particular rank.
-*           
-*     
-*
-* \param    index_list stores the list of indices.
-* \param    Nx is half of the number of points along the given direction.
-* \param    px is the number of processors along the given direction.
-* \param    rank is the \$ x \$ or \$ y \$ rank of the processor.
-*************************************************************************************************************************************
-*/
-void compute_index_list(Array<int,1>& index_list, int Nx, int px, int rank){
-    int list_size=Nx/px;
-    index_list.resize(list_size);
-    for (int i=0; i<list_size; i+=2){
-        index_list(i)=rank+i*px;
-        if (px!=Nx) {
-          index_list(i+1)=Nx-1-index_list(i);
-        }
+    //Resize the structure function array according to the type of inputs
+    resize_SFs(c);
+
+    if (c.first_step > 0 and c.rank_mpi==0) {
+        load_resume(c);
     }
 }
 
 
-
 /**
-*************************************************************************************************************************************
-*\brief     Function to distribute load equally among all the MPI processors.
-*           
-*           
-* \param    index_list stores the matrix of the indices for different ranks.
-* \param    Nx is the number of points along \$ x \$ direction.
-* \param    Ny is the number of points along \$ y \$ (or \$ z \$) direction. 
-*************************************************************************************************************************************
-*/
-void compute_index_list(Array<int,3>& index_list, int Nx, int Ny){
-    int list_size=(Nx*Ny)/(4*P);
-    index_list.resize(list_size,2,P);
+ ********************************************************************************************************************************************
+ * \brief   Function to compute the structure functions of a prepared analysis.
+ *
+ * \param   c is the context of the analysis.
+ * \return  the time taken by the parallel part in seconds.
+ ********************************************************************************************************************************************
+ */
+double compute_analysis(SF_context& c) {
+    Trace_scope trace("structure functions", "compute");
+    timeval start_pt, end_pt;
+    double elapsepdt=0.0;
 
-    int py=(P/px);
-    Array<int,1> x;
-    Array<int,1> y;
-    
-    int rankx,ranky;
-    int nx=Nx/(2*px),ny=Ny/(2*py);
+    //Record the time of starting the parallel processing
+    gettimeofday(&start_pt,NULL);
 
-    
-    for (int rank_id=0; rank_id<P; rank_id++){
-        get_rank(rank_id, py, rankx, ranky);
-        compute_index_list(x, Nx/2, px, rankx);
-        compute_index_list(y, Ny/2, py, ranky);
-        for (int i=0; i<nx; i++){
-            index_list(Range(ny*i,(i+1)*ny-1),0,rank_id)=x(i);
-            index_list(Range(ny*i,(i+1)*ny-1),1,rank_id)=y(Range::all());
-        }
+    //Calculating the structure functions, with the hardware counters of the kernels
+    perf_open(c);
+    calc_SFs(c);
+    perf_report(c);
+
+    //The derived fields are not needed any more
+    if (not c.derived_field.empty()) {
+        free_fields(c);
     }
 
 
-}
+    //Record the time of ending of parallel processing
+    gettimeofday(&end_pt,NULL);
 
+    compute_time_elapsed(start_pt, end_pt, elapsepdt);
+    return elapsepdt;
+}
 
 
 /**
  ********************************************************************************************************************************************
- * \brief   Test function to validate the calculation of structure functions of 3D velocity field data.
- *
- *          This function validates the calculation of the structure functions computed using 3D velocity field data. The velocity field is
- *          generated as \f$ \mathbf{u} = x \hat{x} + y \hat{y} + z \hat{z} \f$. For such field, the velocity structure functions of order
- *          \f$ q \f$ is given as \f$ S_q^u(l_x, l_y, l_z) = (\sqrt{l_x^2 + l_y^2 + l_z^2})^q \f$. In this function, the theoretical values
- *          obtained from the aforementioned equation are compared with the computed values. If the percentage difference between the two values
- *          is less than \f$1 \times 10^{-10} \f$, the test is passed.
+ * \brief   Function to write and test the structure functions of an analysis.
  *
+ * \param   c is the context of the analysis.
+ * \param   elapsepdt is the time taken by the parallel part in seconds.
  ********************************************************************************************************************************************
  */
-void VECTOR_TEST_CASE_3D()
-{	
-    double epsilon=1e-10;
-    double err1 = 0, err2 = 0;
-    double max = 0;
-	Array<double,3> test1,test2;
-
-	if (longitudinal==true){
-		test1.resize(Nx/2,Ny/2,Nz/2);
+void finish_analysis(SF_context& c, double elapsepdt) {
+    //Write the SF array to disk
+    write_SFs(c);
 
-		for (int order=0 ; order<=q2-q1; order++){
-			string name=int_to_str(order+q1);
-			read_3D(test1,"out/",SF_Grid_pll_name,SF_Grid_pll_name+name);
-			for (int i=0; i<test1.extent(0); i++){
-				double lx=dx*i;
-				for (int j=0; j<test1.extent(1); j++){
-					double ly=dy*j;
-					for (int k=0; k<test1.extent(2); k++){
-						double lz=dz*k;
-                        if (lx*lx + ly*ly + lz*lz > epsilon) {
-                            err1 = abs((test1(i,j,k)-pow(lx*lx+ly*ly+lz*lz,(order+q1)/2.))/pow(lx*lx+ly*ly+lz*lz,(order+q1)/2.));
-                        }
-                        else {
-                            err1 = abs(test1(i,j,k));
-                        }
+    //Leave a resume file if the run was stopped by the walltime, and remove the one it resumed from otherwise
+    bool stopped = c.steps_done < int(c.schedule_bound.size())-1;
+    if (c.rank_mpi==0 and stopped) {
+        write_resume(c);
+    }
+    else if (c.rank_mpi==0 and c.first_step > 0) {
+        remove(resume_path(c).c_str());
+    }
 
-                        if (err1 > max) {
-                            max = err1;
-                        }
+    //Stamp the outputs with the hash and store them in the cache, after they are written
+    if (c.rank_mpi==0 and not c.cache_key.empty() and not stopped) {
+        vector<string> files = c.output_files;
+        string key = c.cache_key, dir = c.cache_dir;
+        submit_write(c, [files, key, dir]() {
+            store_results(files, key, dir);
+        });
+    }
 
+    //The analytical structure functions are only matched by a complete run
+    if (c.test_switch and not stopped and c.x_range.empty()){
+        //The test reads the written files back
+        flush_writes();
+        test_cases(c);
+    }
 
-					}
-				}
-			}
-		}
+    if (c.rank_mpi==0) {
+        cout<<"\nTime elapsed for the parallel part: "<<elapsepdt<<endl;
+    }
+}
 
-	}
-	else{
-        cout<<"\nTESTING BOTH TRANSVERSE AND LONGITUDINAL\n";
-		test1.resize(Nx/2,Ny/2,Nz/2);
-		test2.resize(Nx/2,Ny/2,Nz/2);
-		for (int order=0 ; order<=q2-q1; order++){
-			string name=int_to_str(order+q1);
 
-			read_3D(test1,"out/",SF_Grid_pll_name,SF_Grid_pll_name+name);
-			read_3D(test2,"out/",SF_Grid_perp_name,SF_Grid_perp_name+name);
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to mix the bits of a 64-bit word (the finalizer of splitmix64).
+ ********************************************************************************************************************************************
+ */
+uint64_t mix_bits(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
 
 
-			for (int i=0; i<test1.extent(0); i++){
-				double lx=dx*i;
-				for (int j=0; j<test1.extent(1); j++){
-					double ly=dy*j;
-					for (int k=0; k<test1.extent(2); k++){
-						double lz=dz*k;
-						if (lx*lx + ly*ly + lz*lz > epsilon) {
-                            err1 = abs((test1(i,j,k)-pow(lx*lx+ly*ly+lz*lz,(order+q1)/2.))/pow(lx*lx+ly*ly+lz*lz,(order+q1)/2.));
-                        }
-                        else {
-                            err1 = abs(test1(i,j,k));
-                        }
-                        err2 = abs(test2(i,j,k));
-                        if (err1 > max) {
-                            max = err1;
-                            
-                        }
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to hash a chunk of memory 8 bytes at a time (the remaining bytes are hashed one by one).
+ *
+ *          The hash only detects changes of the inputs; it is not meant to resist deliberate collisions.
+ ********************************************************************************************************************************************
+ */
+uint64_t hash_bytes(const char* data, size_t bytes, uint64_t seed)
+{
+    uint64_t h = mix_bits(seed ^ bytes);
+    size_t words = bytes/8;
+    for (size_t i=0; i<words; i++) {
+        uint64_t w;
+        memcpy(&w, data+8*i, 8);
+        h = ((h << 31 | h >> 33) ^ mix_bits(w)) * 0x9e3779b97f4a7c15ULL;
+    }
+    for (size_t i=8*words; i<bytes; i++) {
+        h = ((h << 31 | h >> 33) ^ mix_bits(uint8_t(data[i]))) * 0x9e3779b97f4a7c15ULL;
+    }
+    return mix_bits(h);
+}
 
-                        if (err2 > max) {
-                            max = err2;
-                    
-                        }
 
-					}
-				}
-			}
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to list the parameters of an analysis that determine its results, for the hash of the result cache.
+ *
+ *          The kernel variant, the decomposition and the write queue are left out, since they only change the round-off of the results.
+ ********************************************************************************************************************************************
+ */
+string analysis_parameters(SF_context& c)
+{
+    ostringstream p;
+    p<<setprecision(17)<<"fastSF results 1\n";
+    p<<"switches "<<c.scalar_switch<<" "<<c.two_dimension_switch<<" "<<c.longitudinal<<" "<<c.stacked_velocity<<"\n";
+    p<<"grid "<<c.Nx<<" "<<c.Ny<<" "<<c.Nz<<" "<<c.Lx<<" "<<c.Ly<<" "<<c.Lz<<" "<<c.dx<<" "<<c.dy<<" "<<c.dz<<"\n";
+    p<<"orders "<<c.q1<<" "<<c.q2<<" "<<c.absolute_moments;
+    for (size_t i=0; i<c.orders.size(); i++) {
+        p<<" "<<c.orders[i];
+    }
+    p<<"\noutputs "<<c.SF_Grid_pll_name<<" "<<c.SF_Grid_perp_name<<" "<<c.SF_Grid_scalar_name<<" "<<c.write_sums<<"\nrange";
+    for (size_t i=0; i<c.x_range.size(); i++) {
+        p<<" "<<c.x_range[i];
+    }
+    p<<"\nestimator "<<c.pyramid_crossover<<" "<<c.error_blocks<<"\n";
+    p<<"scaling "<<c.scaling_bins<<" "<<c.ess_order;
+    for (size_t i=0; i<c.scaling_range.size(); i++) {
+        p<<" "<<c.scaling_range[i];
+    }
+    p<<"\nangular "<<c.angular_degree;
+    for (size_t i=0; i<c.angular_bins.size(); i++) {
+        p<<" "<<c.angular_bins[i];
+    }
+    p<<"\njoint_pdf "<<c.pdf_scalar;
+    for (size_t i=0; i<c.pdf_bins.size(); i++) {
+        p<<" "<<c.pdf_bins[i];
+    }
+    p<<";";
+    for (size_t s=0; s<c.pdf_separations.size(); s++) {
+        for (size_t i=0; i<c.pdf_separations[s].size(); i++) {
+            p<<" "<<c.pdf_separations[s][i];
+        }
+        p<<";";
+    }
+    p<<"\ncomponents";
+    for (size_t i=0; i<c.transverse_axis.size(); i++) {
+        p<<" "<<c.transverse_axis[i];
+    }
+    p<<"\nderived "<<c.derived_field<<" "<<c.derived_periodic<<"\n";
+    return p.str();
+}
 
-		}
-	}
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to compute the hash of the input fields and the parameters of an analysis, once the fields are read.
+ *
+ *          The fields are cut into chunks of input_slab_size values, which are hashed by the processors in turn and by their OpenMP
+ *          threads. The hashes of the chunks are combined in order, so that the hash does not depend on the number of processors. Every
+ *          processor gets the hash in c.cache_key.
+ *
+ * \param   c is the context of the analysis.
+ ********************************************************************************************************************************************
+ */
+void compute_cache_key(SF_context& c)
+{
+    vector<pair<const char*, size_t> > chunks;
+    Array<double,3>* fields[] = {&c.V1, &c.V2, &c.V3, &c.T};
+    Array<double,2>* fields_2D[] = {&c.V1_2D, &c.V3_2D, &c.T_2D};
+    vector<pair<const double*, size_t> > arrays;
+    for (int n=0; n<4; n++) {
+        arrays.push_back(make_pair(fields[n]->data(), size_t(fields[n]->size())));
+    }
+    for (int n=0; n<3; n++) {
+        arrays.push_back(make_pair(fields_2D[n]->data(), size_t(fields_2D[n]->size())));
+    }
+    for (size_t n=0; n<arrays.size(); n++) {
+        for (size_t first=0; first<arrays[n].second; first+=input_slab_size) {
+            size_t count = min(size_t(input_slab_size), arrays[n].second-first);
+            chunks.push_back(make_pair(reinterpret_cast<const char*>(arrays[n].first+first), count*sizeof(double)));
+        }
+    }
 
-	if (max > epsilon){
-		cout<<"\n\nVECTOR_3D: TEST_FAILED. The structure functions computed numerically using the code do NOT match with the analytically obtained values. \n\n";
-	}
-	else{
-		cout<<"\n\nVECTOR_3D: TEST_PASSED. The structure functions computed numerically using the code match with the analytically obtained values. \n\n";
-	}
+    int nchunks = chunks.size();
+    vector<uint64_t> hashes(nchunks, 0);
+    #pragma omp parallel for schedule(dynamic) num_threads(c.team_size)
+    for (int k=c.rank_mpi; k<nchunks; k+=c.P) {
+        hashes[k] = hash_bytes(chunks[k].first, chunks[k].second, k);
+    }
+    MPI_Allreduce(MPI_IN_PLACE, hashes.data(), nchunks, MPI_UINT64_T, MPI_BOR, c.comm);
+
+    string parameters = analysis_parameters(c);
+    hashes.push_back(hash_bytes(parameters.data(), parameters.size(), nchunks));
+    uint64_t key = hash_bytes(reinterpret_cast<const char*>(hashes.data()), hashes.size()*sizeof(uint64_t), 0);
+    ostringstream hex;
+    hex<<std::hex<<setw(16)<<setfill('0')<<key;
+    c.cache_key = hex.str();
+}
 
-    cout<<"MAXIMUM PERCENTAGE ERROR: "<<max<<endl<<endl;
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to copy a file, returning false if it cannot be read or written.
+ ********************************************************************************************************************************************
+ */
+bool copy_file(string from, string to)
+{
+    ifstream in(from.c_str(), ios::binary);
+    ofstream out(to.c_str(), ios::binary);
+    if (not in or not out) {
+        return false;
+    }
+    out<<in.rdbuf();
+    return bool(out);
 }
 
 
 /**
  ********************************************************************************************************************************************
- * \brief   Test function to validate the calculation of structure functions of 2D velocity field data.
+ * \brief   Function to compute the hash of an analysis and to copy its results from the cache if they are stored there.
  *
- *          This function validates the calculation of the structure functions computed using 2D velocity field data. The velocity field is
- *          generated as \f$ \mathbf{u} = x \hat{x} + z \hat{z} \f$. For such field, the velocity structure functions of order
- *          \f$ q \f$ is given as \f$ S_q^u(l_x, l_z) = (\sqrt{l_x^2 + l_z^2})^q \f$. In this function, the analytically obtained  values
- *          obtained from the aforementioned equation are compared with the computed values. If the percentage difference between the two values is less
-            than \f$1 \times 10^{-10} \f$, the test is passed.
+ *          The results of a hash are stored in the directory [cache]/[hash], with the list of their files in "files". Nothing is done for
+ *          the test cases, the conditional structure functions and the joint PDFs with the scalar field (these fields are not part of the
+ *          hash), and without a cache directory.
  *
+ * \param   c is the context of the analysis, whose input fields are read.
+ * \return  true if the results have been copied to out/, in which case the analysis is not computed.
  ********************************************************************************************************************************************
  */
-void VECTOR_TEST_CASE_2D()
-{	
-	double epsilon=1e-10;
-	double max=0;
-	double err1=0, err2 = 0;
-    Array<double,2> test1,test2;
-	int count=0;
-
-	if (longitudinal==true){
-		test1.resize(Nx/2,Nz/2);
-
-		for (int order=0 ; order<=q2-q1; order++){
-			string name=int_to_str(order+q1);
-			read_2D(test1,"out/",SF_Grid_pll_name, SF_Grid_pll_name+name);
-			for (int i=0; i<test1.extent(0); i++){
-				double lx=dx*i;
-				for (int k=0; k<test1.extent(1); k++){
-					double lz=dz*k;
-                    if ((lx*lx + lz*lz)>epsilon) {
-                        err1 = abs((test1(i,k)-pow(lx*lx+lz*lz,(order+q1)/2.))/pow(lx*lx+lz*lz,(order+q1)/2.));
-                    }
-                    else {
-                        err1 =  abs(test1(i,k));
-                    }
-
-                    if (err1 > max) {
-                        max=err1;
-                    }
-
-				}
-			}
-		}
-
-	}
-	else{
-		test1.resize(Nx/2,Nz/2);
-		test2.resize(Nx/2,Nz/2);
-		for (int order=0 ; order<=q2-q1; order++){
-			string name=int_to_str(order+q1);
-
-			read_2D(test1,"out/",SF_Grid_pll_name,SF_Grid_pll_name+name);
-			read_2D(test2,"out/",SF_Grid_perp_name,SF_Grid_perp_name+name);
-
-
-			for (int i=0; i<test1.extent(0); i++){
-				double lx=dx*i;
-
-				for (int k=0; k<test1.extent(1); k++){
-					double lz=dz*k;
-                    if ((lx*lx + lz*lz)>epsilon) {
-                        err1 = abs((test1(i,k)-pow(lx*lx+lz*lz,(order+q1)/2.))/pow(lx*lx+lz*lz,(order+q1)/2.));
-                    }
-                    else {
-                        err1 =  abs(test1(i,k));
-                    }
-
-                    err2 = abs(test2(i,k));
-
-                    if (err1 > max) {
-                        max = err1;
-                    }
-                    if (err2 > max) {
-                        max = err2;
-                    }
-
-				}
-			}
-		}
-	}
-
-
-	if (max > epsilon){
-		cout<<"\n\nVECTOR_2D: TEST_FAILED. The structure functions computed numerically using the code do NOT match with the analytically obtained values. \n\n";
-	}
-	else{
-		cout<<"\n\nVECTOR_2D: TEST_PASSED. The structure functions computed numerically using the code match with the analytically obtained values. \n\n";
-	}
-
-    cout<<"MAXIMUM ERROR: "<<max<<endl<<endl;
-
+bool restore_cached(SF_context& c)
+{
+    if (c.cache_dir.empty() or c.test_switch or not c.conditional_file.empty() or c.pdf_scalar) {
+        return false;
+    }
+    compute_cache_key(c);
+
+    int found = 0;
+    if (c.rank_mpi==0) {
+        string entry = c.cache_dir+"/"+c.cache_key;
+        ifstream list((entry+"/files").c_str());
+        vector<string> files;
+        string name;
+        while (getline(list, name)) {
+            files.push_back(name);
+        }
+        if (not files.empty()) {
+            mkdir("out",0777);
+            found = 1;
+            lock_guard<mutex> h5_guard(h5_mutex);
+            for (size_t i=0; i<files.size() and found; i++) {
+                found = copy_file(entry+"/"+files[i], "out/"+files[i]);
+            }
+        }
+        if (found) {
+            cout<<"\nResults of hash "<<c.cache_key<<" copied from the cache "<<entry<<" to out/\n";
+        }
+        else {
+            cout<<"\nHash of the analysis: "<<c.cache_key<<" (not in the cache)\n";
+        }
+    }
+    MPI_Bcast(&found, 1, MPI_INT, 0, c.comm);
+    return found;
 }
 
 
 /**
  ********************************************************************************************************************************************
- * \brief   Test function to validate the calculation of structure functions of 2D scalar field data.
+ * \brief   Function to stamp the output files of an analysis with its hash and to store them in the cache.
  *
- *          This function validates the calculation of the structure functions computed using 2D scalar field data. The scalar field is
- *          generated as \f$ \theta = x + z \f$. For such field, the structure functions of order
- *          \f$ q \f$ is given as \f$ S_q^u(l_x, l_z) = (l_x^2 + l_z^2)^q \f$. In this function, the theoretical values
- *          obtained from the aforementioned equation are compared with the computed values. If the percentage difference between the two values is less
- *          than \f$1 \times 10^{-10} \f$, the test is passed.
+ *          It is run by the writer after the output files are written. The hash is stored as the attribute "cache_key" of the root group of
+ *          every output file. The files are copied to a temporary directory that is renamed to [cache]/[hash] once complete, so that an
+ *          interrupted run does not leave a partial entry.
  *
+ * \param   files are the names of the output files in out/.
+ * \param   key is the hash of the analysis.
+ * \param   dir is the cache directory.
  ********************************************************************************************************************************************
  */
-void SCALAR_TEST_CASE_2D()
-{	double epsilon=1e-10;
-	double max=0;
-	double err=0;
-	Array<double,2> test1;
-	int count=0;
-	test1.resize(Nx/2,Nz/2);
-	for (int order=0 ; order<=q2-q1; order++){
-		string name=int_to_str(order+q1);
-
-		read_2D(test1,"out/",SF_Grid_scalar_name, SF_Grid_scalar_name+name);
-
-
-
-		for (int i=0; i<test1.extent(0); i++){
-			double lx=dx*i;
+void store_results(vector<string> files, string key, string dir)
+{
+    lock_guard<mutex> h5_guard(h5_mutex);
+    //A file that cannot be stamped is not stored, since it would never match a later lookup
+    bool stamped = true;
+    for (size_t i=0; i<files.size() and stamped; i++) {
+        hid_t f = H5Fopen(("out/"+files[i]).c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+        if (f < 0) {
+            stamped = false;
+            break;
+        }
+        if (H5Aexists(f, "cache_key") > 0) {
+            H5Adelete(f, "cache_key");
+        }
+        hid_t type = H5Tcopy(H5T_C_S1);
+        H5Tset_size(type, key.size());
+        hid_t space = H5Screate(H5S_SCALAR);
+        hid_t attr = H5Acreate2(f, "cache_key", type, space, H5P_DEFAULT, H5P_DEFAULT);
+        stamped = attr >= 0 and H5Awrite(attr, type, key.c_str()) >= 0;
+        if (attr >= 0) {
+            H5Aclose(attr);
+        }
+        H5Sclose(space);
+        H5Tclose(type);
+        stamped = H5Fclose(f) >= 0 and stamped;
+    }
 
-			for (int k=0; k<test1.extent(1); k++){
-				double lz=dz*k;
-				if (abs(lx+lz)>epsilon){
-					err=abs((test1(i,k)-pow(lx+lz,(order+q1)))/pow(lx+lz,(order+q1)));
+    string entry = dir+"/"+key;
+    if (dir.empty() or access(entry.c_str(), F_OK) == 0) {
+        return;
+    }
+    for (size_t pos=dir.find('/', 1); pos!=string::npos; pos=dir.find('/', pos+1)) {
+        mkdir(dir.substr(0, pos).c_str(), 0777);
+    }
+    mkdir(dir.c_str(), 0777);
+    string partial = entry+".part"+int_to_str(getpid());
+    bool stored = stamped and mkdir(partial.c_str(), 0777) == 0;
+    for (size_t i=0; i<files.size() and stored; i++) {
+        stored = copy_file("out/"+files[i], partial+"/"+files[i]);
+    }
+    if (stored) {
+        ofstream list((partial+"/files").c_str());
+        for (size_t i=0; i<files.size(); i++) {
+            list<<files[i]<<"\n";
+        }
+        list.close();
+        stored = bool(list) and rename(partial.c_str(), entry.c_str()) == 0;
+    }
+    if (stored) {
+        cout<<"Results stored in the cache "<<entry<<"\n";
+    }
+    else {
+        cerr<<"WARNING: Unable to store the results in the cache "<<entry<<"\n";
+        for (size_t i=0; i<files.size(); i++) {
+            remove((partial+"/"+files[i]).c_str());
+        }
+        remove((partial+"/files").c_str());
+        rmdir(partial.c_str());
+    }
+}
 
-				}
-				else{
-					err=abs(test1(i,k));
 
-				}
+/**
+ ********************************************************************************************************************************************
+ * \brief   Structure describing an analysis listed in the job manifest.
+ ********************************************************************************************************************************************
+ */
+struct Analysis {
+    string name;
+    vector<string> args;
+    int processors;
+    int px;
+    int Nx_half;
+    int N2_half;
+    double cost;
+};
 
-                if (err>max) {
-                    max = err;
-                }
-                
 
-			}
-            
-		}
-	}
-	if (max > epsilon){
-		cout<<"\n\nSCALAR_2D: TEST_FAILED. The structure functions computed numerically using the code do NOT match with the analytically obtained values. \n\n";
-	}
-	else{
-		cout<<"\n\nSCALAR_2D: TEST_PASSED. The structure functions computed numerically using the code match with the analytically obtained values. \n\n";
-	}
+/**
+ ********************************************************************************************************************************************
+ * \brief   Exception thrown when an analysis of the job manifest cannot be run (see fail_analysis()).
+ ********************************************************************************************************************************************
+ */
+struct Analysis_failed {
+};
 
-	cout<<"MAXIMUM ERROR: "<<max<<endl<<endl;
-}
 
 /**
  ********************************************************************************************************************************************
- * \brief   Test function to validate the calculation of structure functions of 3D scalar field data.
- *
- *          This function validates the calculation of the structure functions computed using 3D scalar field data. The scalar field is
- *          generated as \f$ \theta = x + y + z \f$. For such field, the structure functions of order
- *          \f$ q \f$ is given as \f$ S_q^u(l_x, l_y, l_z) = (l_x^2 + l_y^2 + l_z^2)^q \f$. In this function, the theoretical values
- *          obtained from the aforementioned equation are compared with the computed values. If the percentage difference between the two values is less
- *          than \f$1 \times 10^{-10} \f$, the test is passed.
+ * \brief   Function to give up the current analysis after an error reported by the caller.
  *
+ *          A single analysis ends the program. The analyses of a job manifest are skipped instead, since the other groups of processors are
+ *          still computing theirs; the checks calling this function give the same result on all the processors of a group, so that they all
+ *          leave the analysis together.
  ********************************************************************************************************************************************
  */
-void SCALAR_TEST_CASE_3D(){
-
-	double epsilon=1e-10;
-	double max=0;
-	double err=0;
-    Array<double,3> test1;
-	int count=0;
-	test1.resize(Nx/2,Ny/2,Nz/2);
-	for (int order=0 ; order<=q2-q1; order++){
-		string name=int_to_str(order+q1);
-		read_3D(test1,"out/",SF_Grid_scalar_name, SF_Grid_scalar_name+name);
-		for (int i=0; i<test1.extent(0); i++){
-			double lx=dx*i;
-			for (int j=0; j<test1.extent(1); j++){
-				double ly=dy*j;
-				for (int k=0; k<test1.extent(2); k++){
-					double lz=dz*k;
-					if (abs(lx+ly+lz)>epsilon){
-						err=abs((test1(i,j,k)-pow(lx+ly+lz,(order+q1)))/pow(lx+ly+lz,(order+q1)));
-
-					}
-					else{
-						err=abs(test1(i,j,k));
-
-					}
+void fail_analysis() {
+    if (manifest_name=="") {
+        exit_on_error();
+    }
+    throw Analysis_failed();
+}
 
-                    if (err>max) {
-                        max=err;
-                    }
-				}
-			}
-		}
-	}
-	if (max > epsilon){
-		cout<<"\n\nSCALAR_3D: TEST_FAILED. The structure functions computed numerically using the code do NOT match with the analytically obtained values. \n\n";
-	}
-	else{
-		cout<<"\n\nSCALAR_3D: TEST_PASSED. The structure functions computed numerically using the code match with the analytically obtained values. \n\n";
 
-	}
+/**
+ ********************************************************************************************************************************************
+ * \brief   Structure storing the inputs that can be given on the command line, as they are before the arguments of the analyses of a job
+ *          manifest are read (see reset_inputs()).
+ *
+ *          An option added to get_Inputs() needs a member here and a line in reset_inputs().
+ ********************************************************************************************************************************************
+ */
+struct Command_line_inputs {
+    int Nx, Ny, Nz, px, q1, q2;
+    double Lx, Ly, Lz;
+    bool test_switch, scalar_switch, two_dimension_switch, longitudinal;
+    vector<double> orders;
+    string UName, VName, WName, TName, UdName, VdName, WdName, TdName;
+    string SF_Grid_pll_name, SF_Grid_perp_name, SF_Grid_scalar_name;
+    string velocity_layout;
+    int brick_size, tile_size, num_threads, write_queue, pyramid_crossover, error_blocks;
+    bool stacked_velocity, tune_switch;
+    string manifest_name, cache_dir, trace_file;
+    double walltime;
+    bool resume_switch, perf_switch;
+};
 
-    cout<<"MAXIMUM ERROR: "<<max<<endl<<endl;
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to save an input into the saved copy, or to restore it from there.
+ ********************************************************************************************************************************************
+ */
+template<typename T>
+void keep_input(bool save, T& input, T& saved) {
+    if (save) {
+        saved = input;
+    }
+    else {
+        input = saved;
+    }
 }
 
 
-
 /**
  ********************************************************************************************************************************************
- * \brief   Function to convert an integer type value to string.
+ * \brief   Function to save the inputs that can be given on the command line, or to restore the saved values.
  *
+ *          The inputs keep their values from one call of get_Inputs to the next unless para.yaml sets them, so they are restored before the
+ *          inputs of each analysis of a job manifest are read: the options given to one analysis do not carry over to the next ones.
  *
- * \param   number is the integer value of to be converted.
+ * \param   save is "true" to save the current values and "false" to restore them.
+ ********************************************************************************************************************************************
+ */
+void reset_inputs(bool save) {
+    static Command_line_inputs saved;
+    Command_line_inputs& k = saved;
+    keep_input(save, Nx, k.Nx);
+    keep_input(save, Ny, k.Ny);
+    keep_input(save, Nz, k.Nz);
+    keep_input(save, px, k.px);
+    keep_input(save, q1, k.q1);
+    keep_input(save, q2, k.q2);
+    keep_input(save, Lx, k.Lx);
+    keep_input(save, Ly, k.Ly);
+    keep_input(save, Lz, k.Lz);
+    keep_input(save, test_switch, k.test_switch);
+    keep_input(save, scalar_switch, k.scalar_switch);
+    keep_input(save, two_dimension_switch, k.two_dimension_switch);
+    keep_input(save, longitudinal, k.longitudinal);
+    keep_input(save, orders, k.orders);
+    keep_input(save, UName, k.UName);
+    keep_input(save, VName, k.VName);
+    keep_input(save, WName, k.WName);
+    keep_input(save, TName, k.TName);
+    keep_input(save, UdName, k.UdName);
+    keep_input(save, VdName, k.VdName);
+    keep_input(save, WdName, k.WdName);
+    keep_input(save, TdName, k.TdName);
+    keep_input(save, SF_Grid_pll_name, k.SF_Grid_pll_name);
+    keep_input(save, SF_Grid_perp_name, k.SF_Grid_perp_name);
+    keep_input(save, SF_Grid_scalar_name, k.SF_Grid_scalar_name);
+    keep_input(save, velocity_layout, k.velocity_layout);
+    keep_input(save, brick_size, k.brick_size);
+    keep_input(save, tile_size, k.tile_size);
+    keep_input(save, num_threads, k.num_threads);
+    keep_input(save, write_queue, k.write_queue);
+    keep_input(save, pyramid_crossover, k.pyramid_crossover);
+    keep_input(save, error_blocks, k.error_blocks);
+    keep_input(save, stacked_velocity, k.stacked_velocity);
+    keep_input(save, tune_switch, k.tune_switch);
+    keep_input(save, manifest_name, k.manifest_name);
+    keep_input(save, cache_dir, k.cache_dir);
+    keep_input(save, trace_file, k.trace_file);
+    keep_input(save, walltime, k.walltime);
+    keep_input(save, resume_switch, k.resume_switch);
+    keep_input(save, perf_switch, k.perf_switch);
+    if (not save) {
+        kernel_variant_source = "defaults";
+    }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to read the inputs of an analysis of the job manifest.
  *
- * \return  The value as a string.
+ *          The arguments of the analysis are appended to the command line arguments of the job, and the inputs are read as for a single
+ *          analysis.
  *
+ * \param   argc is the number of command-line arguments of the job.
+ * \param   argv is the array of the command-line arguments of the job.
+ * \param   analysis is the analysis whose inputs are read.
  ********************************************************************************************************************************************
  */
-string int_to_str(int number)
-{
-    stringstream ss;
+void get_analysis_inputs(int argc, char* argv[], Analysis& analysis) {
+    vector<string> args(argv, argv+argc);
+    args.insert(args.end(), analysis.args.begin(), analysis.args.end());
 
-    ss << number;
+    vector<char*> arg_ptrs;
+    for (size_t i=0; i<args.size(); i++) {
+        arg_ptrs.push_back(&args[i][0]);
+    }
+    arg_ptrs.push_back(NULL);
 
-    return ss.str();
+    reset_inputs(false);
+    optind = 1;
+    get_Inputs(int(args.size()), arg_ptrs.data());
 }
 
+
 /**
  ********************************************************************************************************************************************
- * \brief   Function to compute the time elapsed.
+ * \brief   Function to check whether an analysis can be distributed over a given number of processors.
  *
- *          This function computes the time elapsed in seconds between a start point and an end point during the execution of the
- *          program
+ *          The conditions are the ones checked by run_analysis for a single analysis.
  *
- * \param start_t is the time corresponding to the start point
- * \param end_t is the time corresponding to the end point
- * \param elapsed stores the time elapsed in seconds
+ * \param   analysis is the analysis to be distributed.
+ * \param   nprocs is the number of processors.
  ********************************************************************************************************************************************
  */
-void compute_time_elapsed(timeval start_t, timeval end_t, double& elapsed){
-    long elapsed_2 = (end_t.tv_sec-start_t.tv_sec)*1000000u + end_t.tv_usec-start_t.tv_usec;
-    elapsed=elapsed_2/1.0e6;
+bool decomposition_fits(Analysis& analysis, int nprocs) {
+    int px_a = analysis.px;
+    return px_a > 0 and nprocs >= px_a and nprocs%px_a == 0 and analysis.Nx_half%px_a == 0 and analysis.N2_half%(nprocs/px_a) == 0;
 }
 
 
-
 /**
  ********************************************************************************************************************************************
- * \brief   Function to write the structure functions as function of \f$ (l_x,l_y,l_z) \f$ as a 3D hdf5 file.
+ * \brief   Function to read the list of analyses from the job manifest.
  *
- *          This function reads the structure functions as a 4D array of dimensions \f$ (l_x \times l_y \times l_z \times p)\f$, where \f$ p \f$ is the order of the number of orders of
- *          structure function.
- *          The structure functions of different orders are then stored as separate 3D hdf5 files.
+ *          The manifest is a yaml file with a sequence "analyses", each entry having a "name", the command line arguments "args" of the
+ *          analysis and optionally the number of "processors" to be used for it. The optional entry "concurrent" decides whether the
+ *          analyses of a group of processors run concurrently on separate threads.
  *
- * \param   A is the 4D array representing the structure functions.
- * \param   file is the name of the hdf5 file and the dataset in which the structure functions are stored.
- * \param   q is the order of the structure function to be stored.
+ * \param   analyses stores the analyses that are read.
  ********************************************************************************************************************************************
  */
-void write_4D(Array<double,4> A, string file) {
-  int nx=A(Range::all(),0,0,0).size();
-  int ny=A(0,Range::all(),0,0).size();
-  int nz=A(0,0,Range::all(),0).size();
-  h5::File f("out/"+file+".h5", "w");
-  int q = q1;
-  Array<double,3> temp(nx,ny,nz);
-  while(q<=q2){
-      cout<<"Writing "<<q<<" order to file.\n";
-      string qstr = int_to_str(q);
-      h5::Dataset ds = f.create_dataset(file+qstr, h5::shape(nx,ny,nz), "double");
-      temp(Range::all(),Range::all(),Range::all())=A(Range::all(),Range::all(),Range::all(),q-q1);
-      ds << temp.data();
-      q++;
-  }
+void read_manifest(vector<Analysis>& analyses) {
+    ifstream manifest(manifest_name.c_str());
+    if (not manifest.is_open()) {
+        if (rank_mpi==0) {
+            cerr<<"Unable to open the job manifest '"<<manifest_name<<"'."<<endl;
+        }
+        exit_on_error();
+    }
+
+    try {
+        YAML::Node doc;
+        YAML::Parser parser(manifest);
+        parser.GetNextDocument(doc);
+        if (const YAML::Node* concurrent = doc.FindValue("concurrent")) {
+            *concurrent>>concurrent_analyses;
+        }
+        const YAML::Node& list = doc["analyses"];
+        for (unsigned i=0; i<list.size(); i++) {
+            Analysis analysis;
+            analysis.name = "analysis_" + int_to_str(i+1);
+            if (const YAML::Node* name = list[i].FindValue("name")) {
+                *name>>analysis.name;
+            }
+            string args;
+            if (const YAML::Node* arg_node = list[i].FindValue("args")) {
+                *arg_node>>args;
+            }
+            istringstream arg_stream(args);
+            string arg;
+            while (arg_stream>>arg) {
+                analysis.args.push_back(arg);
+            }
+            analysis.processors = 0;
+            if (const YAML::Node* procs = list[i].FindValue("processors")) {
+                *procs>>analysis.processors;
+            }
+            analyses.push_back(analysis);
+        }
+    }
+    catch(YAML::Exception& e) {
+        if (rank_mpi==0) {
+            cerr<<"Error reading the job manifest '"<<manifest_name<<"': "<<e.what()<<endl;
+        }
+        exit_on_error();
+    }
+
+    if (analyses.empty()) {
+        if (rank_mpi==0) {
+            cerr<<"The job manifest '"<<manifest_name<<"' lists no analyses."<<endl;
+        }
+        exit_on_error();
+    }
 }
 
 
 /**
  ********************************************************************************************************************************************
- * \brief   Function to write the structure functions as function of lx,lz as a 2D hdf5 file.
+ * \brief   Function to run the analyses of a group of processors concurrently, each on its own thread with its own team of OpenMP threads.
  *
- *          This function reads the structure functions as a 3D array of dimensions \f$ (l_x \times l_z \times p) \f$, where \f$ p \f$ is the number of orders of the structure function.
- *          The structure functions of different orders are then stored as separate 2D hdf5 files.
+ *          The contexts are prepared one after another: analyses with the same input fields reference the fields read for the first of them
+ *          (and its packed fields if the kernel variants match). Every context gets its own duplicate of the communicator of the group. The
+ *          structure functions are then computed concurrently, and written and tested one after another, since hdf5 is not thread-safe.
  *
- * \param   A is the 3D array representing the structure functions.
- * \param   file is the name of the hdf5 file and the dataset in which the structure functions are stored.
- * \param   q is the order of the structure function to be stored.
+ * \param   argc is the number of command-line arguments of the job.
+ * \param   argv is the array of the command-line arguments of the job.
+ * \param   analyses is the list of the analyses of the job manifest.
+ * \param   mine stores the indices of the analyses of this group.
  ********************************************************************************************************************************************
  */
-void write_3D(Array<double,3> A, string file) {
-  int nx=A(Range::all(),0,0).size();
-  int nz=A(0,Range::all(),0).size();
-  h5::File f("out/"+file+".h5", "w");
-  int q = q1;
-  Array<double,2> temp(nx,nz);
-  while(q<=q2) {
-      cout<<"Writing "<<q<<" order to file.\n";
-      string qstr = int_to_str(q);
-      h5::Dataset ds = f.create_dataset(file+qstr, h5::shape(nx,nz), "double");
-      temp(Range::all(),Range::all())=A(Range::all(),Range::all(),q-q1);
+void run_concurrent(int argc, char* argv[], vector<Analysis>& analyses, vector<int>& mine) {
+    int n = mine.size();
+    vector<SF_context> contexts(n);
+    vector<int> source(n, -1);
+    vector<bool> failed(n);
+
+    //The analyses whose fields cannot be read are skipped, and share their fields with no other analysis
+    for (int i=0; i<n; i++) {
+        SF_context& c = contexts[i];
+        get_analysis_inputs(argc, argv, analyses[mine[i]]);
+        init_context(c);
+        MPI_Comm_dup(comm_sf, &c.comm);
+        for (int j=0; j<i and source[i]<0; j++) {
+            if (not failed[j] and same_fields(contexts[j], c)) {
+                source[i] = j;
+            }
+        }
+        if (c.rank_mpi==0) {
+            cout<<"\n==== Analysis "<<analyses[mine[i]].name<<" ("<<c.P<<" processors, concurrent) ====\n";
+        }
+        if (source[i] >= 0) {
+            if (c.rank_mpi==0) {
+                cout<<"Sharing the input fields of "<<analyses[mine[source[i]]].name<<endl;
+            }
+            share_fields(c, contexts[source[i]]);
+        }
+        else {
+            try {
+                Read_fields(c);
+            }
+            catch (Analysis_failed&) {
+                if (c.rank_mpi==0) {
+                    cerr<<"Skipping the analysis "<<analyses[mine[i]].name<<endl;
+                }
+                failed[i] = true;
+            }
+        }
+    }
+
+    //The analyses found in the cache are neither prepared nor computed, and their packed fields cannot be shared
+    vector<bool> cached(n);
+    for (int i=0; i<n; i++) {
+        if (failed[i]) {
+            cached[i] = true;
+            continue;
+        }
+        if (contexts[i].rank_mpi==0 and not contexts[i].cache_dir.empty()) {
+            cout<<"\n==== Cache lookup of "<<analyses[mine[i]].name<<" ====\n";
+        }
+        cached[i] = restore_cached(contexts[i]);
+    }
+
+    //The analyses failing their checks are skipped like the cached ones
+    int team = max(1, omp_get_max_threads()/n);
+    for (int i=0; i<n; i++) {
+        SF_context& c = contexts[i];
+        if (cached[i]) {
+            continue;
+        }
+        bool threads_given = c.num_threads > 0;
+        try {
+            prepare_analysis(c, source[i] >= 0 and not cached[source[i]] ? &contexts[source[i]] : NULL);
+        }
+        catch (Analysis_failed&) {
+            if (c.rank_mpi==0) {
+                cerr<<"Skipping the analysis "<<analyses[mine[i]].name<<endl;
+            }
+            cached[i] = true;
+            continue;
+        }
+        //The number of threads of the tuning profile is meant for a whole processor
+        if (not threads_given and c.team_size > team) {
+            c.team_size = team;
+            if (c.rank_mpi==0 and c.num_threads > 0) {
+                cout<<"Threads of "<<analyses[mine[i]].name<<" limited to "<<team<<", its share of the processor"<<endl;
+            }
+        }
+    }
+
+    vector<double> elapsed(n);
+    vector<thread> teams;
+    for (int i=0; i<n; i++) {
+        if (cached[i]) {
+            continue;
+        }
+        string name = analyses[mine[i]].name;
+        teams.push_back(thread([&contexts, &elapsed, i, name]() {
+            trace_name_thread("analysis "+name);
+            elapsed[i] = compute_analysis(contexts[i]);
+        }));
+    }
+    for (size_t t=0; t<teams.size(); t++) {
+        teams[t].join();
+    }
+
+    for (int i=0; i<n; i++) {
+        if (not cached[i]) {
+            if (contexts[i].rank_mpi==0) {
+                cout<<"\n==== Results of "<<analyses[mine[i]].name<<" ====\n";
+            }
+            finish_analysis(contexts[i], elapsed[i]);
+        }
+        MPI_Comm_free(&contexts[i].comm);
+    }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to run all the analyses of the job manifest concurrently on sub-groups of the processors.
+ *
+ *          The cost of each analysis is estimated as (number of grid points) x (number of displacements) x (number of components) x (number
+ *          of orders). The analyses are taken in decreasing order of cost: each one gets a new group of Processors_X (or "processors")
+ *          processors while enough processors are left, and otherwise joins the group with the smallest load for which its decomposition
+ *          is valid. The remaining processors are then given to the groups with the largest load per processor by doubling their sizes.
+ *          MPI_COMM_WORLD is split accordingly, and every group runs its analyses one after another on its communicator, or concurrently
+ *          (see run_concurrent()).
+ *
+ * \param   argc is the number of command-line arguments of the job.
+ * \param   argv is the array of the command-line arguments of the job.
+ ********************************************************************************************************************************************
+ */
+void run_manifest(int argc, char* argv[]) {
+    vector<Analysis> analyses;
+    read_manifest(analyses);
+
+    //Estimate the cost of each analysis, and skip the analyses whose first input field cannot be opened
+    for (size_t n=0; n<analyses.size(); n++) {
+        Analysis& a = analyses[n];
+        get_analysis_inputs(argc, argv, a);
+        SF_context c;
+        init_context(c);
+        if (not c.test_switch) {
+            Input_dataset in;
+            try {
+                if (c.scalar_switch) {
+                    open_input(c, "in/", c.TName, c.TdName, false, in);
+                }
+                else {
+                    open_input(c, "in/", c.UName, c.UdName, c.stacked_velocity, in);
+                }
+            }
+            catch (Analysis_failed&) {
+                if (rank_mpi==0) {
+                    cerr<<"Skipping the analysis "<<a.name<<endl;
+                }
+                analyses.erase(analyses.begin()+n);
+                n--;
+                continue;
+            }
+            close_input(in);
+        }
+        if (c.two_dimension_switch) {
+            c.Ny = 1;
+        }
+        double points = double(c.Nx)*c.Ny*c.Nz;
+        a.cost = points*points/(c.two_dimension_switch ? 4 : 8)*(c.scalar_switch ? 1 : 3)*num_orders(c);
+        a.px = px;
+        a.Nx_half = c.Nx/2;
+        a.N2_half = (c.two_dimension_switch ? c.Nz : c.Ny)/2;
+        int min_procs = a.processors > 0 ? a.processors : px;
+        if (a.processors < 0 or not decomposition_fits(a, min_procs) or min_procs > P) {
+            if (rank_mpi==0) {
+                cerr<<"ERROR! The analysis '"<<a.name<<"' cannot be distributed over "<<min_procs<<" processors with "<<px
+                    <<" processors in x direction. Aborting.."<<endl;
+            }
+            exit_on_error();
+        }
+    }
+
+    vector<int> order(analyses.size());
+    for (size_t n=0; n<order.size(); n++) {
+        order[n] = n;
+    }
+    sort(order.begin(), order.end(), [&](int i, int j) { return analyses[i].cost > analyses[j].cost; });
+
+    //Form the groups
+    vector<int> group_size, group_of(analyses.size());
+    vector<double> group_cost;
+    vector<bool> group_fixed;
+    int used = 0;
+    for (size_t n=0; n<order.size(); n++) {
+        Analysis& a = analyses[order[n]];
+        int size = a.processors > 0 ? a.processors : a.px;
+        if (used + size <= P) {
+            group_of[order[n]] = group_size.size();
+            group_size.push_back(size);
+            group_cost.push_back(a.cost);
+            group_fixed.push_back(a.processors > 0);
+            used += size;
+            continue;
+        }
+        int best = -1;
+        for (size_t g=0; g<group_size.size(); g++) {
+            if ((a.processors > 0 and group_size[g] != a.processors) or not decomposition_fits(a, group_size[g])) {
+                continue;
+            }
+            if (best < 0 or group_cost[g]/group_size[g] < group_cost[best]/group_size[best]) {
+                best = g;
+            }
+        }
+        if (best < 0) {
+            if (rank_mpi==0) {
+                cerr<<"ERROR! No group of processors can take the analysis '"<<a.name<<"'; add processors. Aborting.."<<endl;
+            }
+            exit_on_error();
+        }
+        group_of[order[n]] = best;
+        group_cost[best] += a.cost;
+        group_fixed[best] = group_fixed[best] or a.processors > 0;
+    }
+
+    //Give the remaining processors to the most loaded groups
+    while (true) {
+        int best = -1;
+        for (size_t g=0; g<group_size.size(); g++) {
+            if (group_fixed[g] or used + group_size[g] > P) {
+                continue;
+            }
+            bool fits = true;
+            for (size_t n=0; n<analyses.size(); n++) {
+                if (group_of[n] == int(g) and not decomposition_fits(analyses[n], 2*group_size[g])) {
+                    fits = false;
+                }
+            }
+            if (fits and (best < 0 or group_cost[g]/group_size[g] > group_cost[best]/group_size[best])) {
+                best = g;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        used += group_size[best];
+        group_size[best] *= 2;
+    }
+
+    int world_rank = rank_mpi;
+    int color = MPI_UNDEFINED, first = 0;
+    for (size_t g=0; g<group_size.size(); g++) {
+        if (world_rank >= first and world_rank < first + group_size[g]) {
+            color = g;
+        }
+        first += group_size[g];
+    }
+
+    if (world_rank==0) {
+        cout<<"\nJob manifest "<<manifest_name<<": "<<analyses.size()<<" analyses in "<<group_size.size()<<" groups\n";
+        for (size_t n=0; n<analyses.size(); n++) {
+            cout<<"  "<<analyses[n].name<<": group "<<group_of[n]<<" ("<<group_size[group_of[n]]<<" processors), estimated cost "
+                <<analyses[n].cost<<endl;
+        }
+        if (used < P) {
+            cout<<"  "<<P-used<<" processors are left idle"<<endl;
+        }
+    }
+
+    MPI_Comm_split(MPI_COMM_WORLD, color, world_rank, &comm_sf);
+    if (color != MPI_UNDEFINED) {
+        MPI_Comm_rank(comm_sf, &rank_mpi);
+        MPI_Comm_size(comm_sf, &P);
+        vector<int> mine;
+        for (size_t n=0; n<analyses.size(); n++) {
+            if (group_of[n] == color) {
+                mine.push_back(n);
+            }
+        }
+
+        bool concurrent = concurrent_analyses and mine.size() > 1;
+        if (concurrent and (mpi_thread_level < MPI_THREAD_MULTIPLE or not blitz_threadsafe)) {
+            if (rank_mpi==0) {
+                cerr<<"WARNING: Running the analyses of group "<<color<<" one after another; concurrent analyses need MPI_THREAD_MULTIPLE"
+                    <<" and a thread-safe Blitz++ (BZ_THREADSAFE)."<<endl;
+            }
+            concurrent = false;
+        }
+
+        if (concurrent) {
+            run_concurrent(argc, argv, analyses, mine);
+        }
+        else {
+            for (size_t i=0; i<mine.size(); i++) {
+                get_analysis_inputs(argc, argv, analyses[mine[i]]);
+                if (rank_mpi==0) {
+                    cout<<"\n==== Analysis "<<analyses[mine[i]].name<<" (group "<<color<<", "<<P<<" processors) ====\n";
+                }
+                try {
+                    run_analysis();
+                }
+                catch (Analysis_failed&) {
+                    if (rank_mpi==0) {
+                        cerr<<"Skipping the analysis "<<analyses[mine[i]].name<<endl;
+                    }
+                }
+            }
+        }
+        MPI_Comm_free(&comm_sf);
+    }
+
+    comm_sf = MPI_COMM_WORLD;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank_mpi);
+    MPI_Comm_size(MPI_COMM_WORLD, &P);
+    MPI_Barrier(MPI_COMM_WORLD);
+}
+
+
+/**
+******************************************************************************************************************************
+*\brief  Function to calculate dx, dy and dz
+*
+******************************************************************************************************************************
+*/
+void calculate_grid_spacing(SF_context& c){
+	//The points of a strided region are a multiple of the spacing of the stored grid apart
+    int sx=1, sy=1, sz=1;
+    if (not c.test_switch and c.region_stride.size() == (c.two_dimension_switch ? 2u : 3u)) {
+        sx = c.region_stride[0];
+        sy = c.two_dimension_switch ? 1 : c.region_stride[1];
+        sz = c.region_stride.back();
+    }
+	//Specify the values of dx, dy, and dz
+    if (c.Nx==1){c.dx=0;}
+    else{
+      c.dx=c.Lx/double(c.Nx_full-1)*sx;}
+    if (c.Ny==1){c.dy=0;}
+    else{
+      c.dy=c.Ly/double(c.Ny_full-1)*sy;}
+    if (c.Nz==1){c.dz=0;}
+    else{
+      c.dz=c.Lz/double(c.Nz_full-1)*sz;
+  	}
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to covert string to bool
+*           
+*************************************************************************************************************************************
+*/
+bool str_to_bool(string s){
+	if (s=="true" || s=="1"){
+		return true;
+	}
+	else if (s=="false" || s=="0"){
+		return false;
+	}
+	else{
+        if (rank_mpi==0)
+            cout<<"Invalid input\n";
+		exit(1);
+	}
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to convert a string to an integer order q1 or q2, rejecting the real orders, which are given by --orders or Orders.
+*
+*************************************************************************************************************************************
+*/
+int str_to_order(string s){
+    size_t parsed = 0;
+    int q = 0;
+    try {
+        q = stoi(s, &parsed);
+    }
+    catch (logic_error&) {
+    }
+    if (s.empty() or parsed != s.size()) {
+        if (rank_mpi==0) {
+            cerr<<"Invalid order '"<<s<<"'; q1 and q2 are integers, real orders are given by --orders or Orders in para.yaml\n";
+        }
+        exit_on_error();
+    }
+    return q;
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to convert a comma-separated list of real orders, for example "-1,0.5,1.5", to the orders.
+*
+*************************************************************************************************************************************
+*/
+vector<double> str_to_orders(string s){
+    vector<double> list;
+    istringstream items(s);
+    string item;
+    while (getline(items, item, ',')) {
+        size_t parsed = 0;
+        try {
+            list.push_back(stod(item, &parsed));
+        }
+        catch (logic_error&) {
+        }
+        if (item.empty() or parsed != item.size()) {
+            if (rank_mpi==0) {
+                cerr<<"Invalid list of orders '"<<s<<"'; give real numbers separated by commas, for example -1,0.5,1.5\n";
+            }
+            exit_on_error();
+        }
+    }
+    return list;
+}
+
+
+/**
+********************************************************************************************************************************
+*\brief    Function to open an input dataset, check its type and save its shape.
+*
+*          The file is opened once and kept open for read_input. The dataset must be a 2D or 3D array of floating point or integer
+*          values; the grid size and the 2D switch of the context are set from its shape. A dataset stacking the components of a vector
+*          field has one more dimension, of length 2 (for 2D fields) or 3 (for 3D fields), either first or last. If a region is given,
+*          the grid size is that of the region.
+*
+*\param fold is data path
+*\param file is the file name
+*\param dset is the dataset name
+*\param components is "true" if the dataset stacks the components of the velocity field
+*\param in is the opened dataset
+*
+********************************************************************************************************************************
+*/
+void open_input(SF_context& c, string fold, string file, string dset, bool components, Input_dataset& in){
+    in.path = fold+file+".h5";
+    string error = "";
+    if (access(in.path.c_str(), R_OK) != 0) {
+        error = "Desired file "+in.path+" does not exist";
+    }
+    else {
+        lock_guard<mutex> h5_guard(h5_mutex);
+        in.file = H5Fopen(in.path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+        if (in.file < 0) {
+            error = "Unable to open "+in.path+" as an hdf5 file";
+        }
+        else if (H5Lexists(in.file, dset.c_str(), H5P_DEFAULT) <= 0) {
+            error = "Dataset "+dset+" not found in "+in.path;
+        }
+        else {
+            in.dset = H5Dopen2(in.file, dset.c_str(), H5P_DEFAULT);
+            hid_t stored = H5Dget_type(in.dset);
+            H5T_class_t type_class = H5Tget_class(stored);
+            if (type_class == H5T_FLOAT or type_class == H5T_INTEGER) {
+                in.type = H5Tget_native_type(stored, H5T_DIR_ASCEND);
+            }
+            else {
+                error = "Dataset "+dset+" in "+in.path+" is neither of floating point nor of integer type";
+            }
+            H5Tclose(stored);
+
+            hid_t space = H5Dget_space(in.dset);
+            int dim = H5Sget_simple_extent_ndims(space);
+            int field_dim = components ? dim-1 : dim;
+            if (field_dim == 2 or field_dim == 3) {
+                in.dims.resize(dim);
+                H5Sget_simple_extent_dims(space, in.dims.data(), NULL);
+                if (components) {
+                    //The component axis comes first if both the first and the last dimension match
+                    if (in.dims[0] == hsize_t(field_dim)) {
+                        in.component_axis = 0;
+                    }
+                    else if (in.dims[dim-1] == hsize_t(field_dim)) {
+                        in.component_axis = dim-1;
+                    }
+                    else if (error == "") {
+                        error = "Dataset "+dset+" in "+in.path+" has no first or last dimension of length "+int_to_str(field_dim)
+                                +" for the velocity components";
+                    }
+                    in.dims.erase(in.dims.begin()+(in.component_axis == 0 ? 0 : dim-1));
+                }
+            }
+            else if (error == "") {
+                error = "Dataset "+dset+" in "+in.path+" has "+int_to_str(dim)+" dimensions; "
+                        +(components ? "3 or 4 are expected for stacked components" : "2 or 3 are expected");
+            }
+            H5Sclose(space);
+        }
+    }
+
+    //Select the region along each dimension of the field
+    in.full_dims = in.dims;
+    in.offset.assign(in.dims.size(), 0);
+    in.stride.assign(in.dims.size(), 1);
+    bool region = not c.region_offset.empty() or not c.region_count.empty() or not c.region_stride.empty();
+    if (error == "" and region) {
+        vector<int>* lists[] = {&c.region_offset, &c.region_count, &c.region_stride};
+        for (int l=0; l<3; l++) {
+            if (not lists[l]->empty() and lists[l]->size() != in.dims.size()) {
+                error = "The offset, count and stride of the region need one entry for each of the "+int_to_str(in.dims.size())
+                        +" dimensions of the fields";
+            }
+        }
+        if (error == "") {
+            for (size_t d=0; d<in.dims.size() and error == ""; d++) {
+                int offset = c.region_offset.empty() ? 0 : c.region_offset[d];
+                int count = c.region_count.empty() ? 0 : c.region_count[d];
+                int stride = c.region_stride.empty() ? 1 : c.region_stride[d];
+                int fit = (offset >= 0 and offset < int(in.full_dims[d]) and stride > 0) ? (int(in.full_dims[d])-1-offset)/stride+1 : 0;
+                if (fit == 0 or count < 0 or count > fit) {
+                    error = "The region does not fit in the "+int_to_str(in.full_dims[d])+" points along dimension "+int_to_str(d+1)
+                            +" of the fields";
+                }
+                in.offset[d] = offset;
+                in.stride[d] = stride;
+                in.dims[d] = count > 0 ? count : fit;
+            }
+        }
+    }
+
+    //The processors of the group give up the analysis together, even if the file is only unreadable for some of them
+    int failed = error != "";
+    MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, c.comm);
+    if (failed) {
+        if (c.rank_mpi==0){
+            cerr<<"\n"<<(error != "" ? error : "Desired file "+in.path+" cannot be read by all the processors")<<"\n\n";
+            show_checklist();
+        }
+        close_input(in);
+        fail_analysis();
+    }
+
+    if (in.dims.size()==2){
+        c.two_dimension_switch=true;
+        c.Nx=in.dims[0];
+        c.Ny=1;
+        c.Nz=in.dims[1];
+        c.Nx_full=in.full_dims[0];
+        c.Ny_full=1;
+        c.Nz_full=in.full_dims[1];
+    }
+    else{
+        c.two_dimension_switch=false;
+        c.Nx=in.dims[0];
+        c.Ny=in.dims[1];
+        c.Nz=in.dims[2];
+        c.Nx_full=in.full_dims[0];
+        c.Ny_full=in.full_dims[1];
+        c.Nz_full=in.full_dims[2];
+    }
+}
+
+/**
+********************************************************************************************************************************
+*\brief    Function to check that two input datasets have the same shape.
+*
+*          The datasets have been opened by all the processors of the group, so they all give up the analysis if the shapes differ.
+*
+*\param a is the first dataset
+*\param b is the second dataset
+*
+********************************************************************************************************************************
+*/
+void check_input_shapes(SF_context& c, Input_dataset& a, Input_dataset& b){
+    if (a.full_dims != b.full_dims){
+        if (c.rank_mpi==0){
+            cerr<<"\nIncompatible dimension data\n\n";
+            show_checklist();
+        }
+        fail_analysis();
+    }
+}
+
+/**
+********************************************************************************************************************************
+*\brief    Function to convert a slab of input values to double precision using the OpenMP threads.
+*
+*\param src is the slab as stored in the file
+*\param A is the destination of the slab
+*\param n is the number of values in the slab
+*
+********************************************************************************************************************************
+*/
+template<typename T>
+void convert_slab(const void* src, double* A, hsize_t n){
+    const T* values = static_cast<const T*>(src);
+    #pragma omp parallel for schedule(static)
+    for (long i=0; i<long(n); i++) {
+        A[i] = double(values[i]);
+    }
+}
+
+/**
+********************************************************************************************************************************
+*\brief    Function to read an opened input dataset in double precision.
+*
+*          A dataset stored in double precision is read directly into the array. Otherwise, it is read in hyperslabs of about input_slab_size
+*          values along the first dimension, each of which is converted by the OpenMP threads; only one slab is held in the stored type.
+*          Types other than the common floating point and integer ones are converted by the hdf5 library. For a dataset stacking the
+*          velocity components, only the selected component is read. Only the points of the region are transferred.
+*
+*\param in is the opened dataset
+*\param component is the velocity component to be read from a stacked dataset (ignored otherwise)
+*\param A is the array of the size of the field to store it
+*
+********************************************************************************************************************************
+*/
+void read_input(Input_dataset& in, int component, double* A){
+    hsize_t row = 1;
+    for (size_t d=1; d<in.dims.size(); d++) {
+        row *= in.dims[d];
+    }
+
+    lock_guard<mutex> h5_guard(h5_mutex);
+    bool direct = H5Tequal(in.type, H5T_NATIVE_DOUBLE) > 0;
+    if (direct and in.component_axis < 0 and in.dims == in.full_dims) {
+        H5Dread(in.dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, A);
+        return;
+    }
+
+    typedef void (*Converter)(const void*, double*, hsize_t);
+    hid_t types[] = {H5T_NATIVE_FLOAT, H5T_NATIVE_SCHAR, H5T_NATIVE_UCHAR, H5T_NATIVE_SHORT, H5T_NATIVE_USHORT, H5T_NATIVE_INT,
+                     H5T_NATIVE_UINT, H5T_NATIVE_LONG, H5T_NATIVE_ULONG, H5T_NATIVE_LLONG, H5T_NATIVE_ULLONG};
+    Converter converters[] = {convert_slab<float>, convert_slab<signed char>, convert_slab<unsigned char>, convert_slab<short>,
+                              convert_slab<unsigned short>, convert_slab<int>, convert_slab<unsigned int>, convert_slab<long>,
+                              convert_slab<unsigned long>, convert_slab<long long>, convert_slab<unsigned long long>};
+    Converter convert = NULL;
+    for (size_t i=0; i<sizeof(types)/sizeof(types[0]) and not direct; i++) {
+        if (H5Tequal(in.type, types[i]) > 0) {
+            convert = converters[i];
+            break;
+        }
+    }
+
+    //A component or region of a double-precision dataset is selected as a whole
+    hsize_t rows = direct ? in.dims[0] : max(hsize_t(1), input_slab_size/row);
+    vector<char> slab(convert != NULL ? min(rows, in.dims[0])*row*H5Tget_size(in.type) : 0);
+    hid_t file_space = H5Dget_space(in.dset);
+    int x_axis = in.component_axis == 0 ? 1 : 0;
+    for (hsize_t first=0; first<in.dims[0]; first+=rows) {
+        vector<hsize_t> start(in.offset), count(in.dims), stride(in.stride);
+        if (in.component_axis >= 0) {
+            start.insert(start.begin()+in.component_axis, hsize_t(component));
+            count.insert(count.begin()+in.component_axis, hsize_t(1));
+            stride.insert(stride.begin()+in.component_axis, hsize_t(1));
+        }
+        start[x_axis] = in.offset[0]+first*in.stride[0];
+        count[x_axis] = min(rows, in.dims[0]-first);
+        hsize_t n = count[x_axis]*row;
+        H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start.data(), stride.data(), count.data(), NULL);
+        hid_t mem_space = H5Screate_simple(1, &n, NULL);
+        if (convert != NULL) {
+            H5Dread(in.dset, in.type, mem_space, file_space, H5P_DEFAULT, slab.data());
+            convert(slab.data(), A+first*row, n);
+        }
+        else {
+            H5Dread(in.dset, H5T_NATIVE_DOUBLE, mem_space, file_space, H5P_DEFAULT, A+first*row);
+        }
+        H5Sclose(mem_space);
+    }
+    H5Sclose(file_space);
+}
+
+/**
+********************************************************************************************************************************
+*\brief    Function to close an input dataset and its file.
+*
+*\param in is the opened dataset
+*
+********************************************************************************************************************************
+*/
+void close_input(Input_dataset& in){
+    lock_guard<mutex> h5_guard(h5_mutex);
+    if (in.type >= 0) {
+        H5Tclose(in.type);
+    }
+    if (in.dset >= 0) {
+        H5Dclose(in.dset);
+    }
+    if (in.file >= 0) {
+        H5Fclose(in.file);
+    }
+    in.type = in.dset = in.file = -1;
+}
+
+
+
+/**
+******************************************************************************************************************************
+\brief Resize input arrays
+*
+******************************************************************************************************************************
+*/
+
+void resize_input(SF_context& c){
+	if(c.two_dimension_switch){
+        if (c.scalar_switch) {
+            c.T_2D.resize(c.Nx, c.Nz);
+        }
+        else {
+            c.V1_2D.resize(c.Nx, c.Nz);
+            c.V3_2D.resize(c.Nx, c.Nz);
+        }
+        
+    }
+    else{
+        if (c.scalar_switch) {
+            c.T.resize(c.Nx, c.Ny, c.Nz);
+        }
+        else {
+            c.V1.resize(c.Nx,c.Ny,c.Nz);
+            c.V2.resize(c.Nx,c.Ny,c.Nz);
+            c.V3.resize(c.Nx,c.Ny,c.Nz);
+        }
+        
+    }
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to generate or read the input fields.
+*
+*
+*\param     UName is the name of the hdf5 file and dataset storing the x-component of velocity / vector field. 
+*\param     VName is the name of the hdf5 file and dataset storing the y-component of velocity / vector field.
+*\param     WName is the name of the hdf5 file and dataset storing the z-component of velocity / vector field.
+*\param     TName is the name of the hdf5 file and dataset storing the scalar field.
+* 
+*************************************************************************************************************************************
+*/
+void Read_fields(SF_context& c) {
+    Trace_scope trace("read", "io");
+    //Defining the input fields
+    if (!c.test_switch){
+    	if (c.rank_mpi==0){
+            cout<<"Reading from the hdf5 files\n";
+        }
+        Input_dataset in1, in2, in3;
+
+        //The dimension of the fields follows the shape of the first dataset
+        if (c.scalar_switch) {
+            open_input(c, "in/", c.TName, c.TdName, false, in1);
+        }
+        else {
+            open_input(c, "in/", c.UName, c.UdName, c.stacked_velocity, in1);
+        }
+        
+        if (c.two_dimension_switch){
+            if (c.scalar_switch) {
+                resize_input(c);
+                calculate_grid_spacing(c);
+                read_input(in1, 0, c.T_2D.data());
+            }
+            else if (c.stacked_velocity) {
+                resize_input(c);
+                calculate_grid_spacing(c);
+                read_input(in1, 0, c.V1_2D.data());
+                read_input(in1, 1, c.V3_2D.data());
+            }
+            else {
+                open_input(c, "in/", c.WName, c.WdName, false, in2);
+                check_input_shapes(c, in1, in2);
+                
+                resize_input(c);
+                calculate_grid_spacing(c);
+                read_input(in1, 0, c.V1_2D.data());
+                read_input(in2, 0, c.V3_2D.data());
+            }
+        }
+        else{
+        	
+            if (c.scalar_switch) {
+            	resize_input(c);
+            	calculate_grid_spacing(c);
+                read_input(in1, 0, c.T.data());
+            }
+            else if (c.stacked_velocity) {
+                resize_input(c);
+                calculate_grid_spacing(c);
+                read_input(in1, 0, c.V1.data());
+                read_input(in1, 1, c.V2.data());
+                read_input(in1, 2, c.V3.data());
+            }
+            else {
+            	open_input(c, "in/", c.VName, c.VdName, false, in2);
+            	open_input(c, "in/", c.WName, c.WdName, false, in3);
+            	check_input_shapes(c, in1, in2);
+            	check_input_shapes(c, in1, in3);
+            	
+            	resize_input(c);
+            	calculate_grid_spacing(c);
+                read_input(in1, 0, c.V1.data());
+                read_input(in2, 0, c.V2.data());
+                read_input(in3, 0, c.V3.data());
+            }
+        }
+        close_input(in1);
+        close_input(in2);
+        close_input(in3);
+    } 
+    else {
+        if (c.rank_mpi==0){
+            cout<<"\nWARNING: The code is running in TEST mode. It will generate velocity / scalar fields and will take them as inputs.\n";
+        }
+        resize_input(c);
+        calculate_grid_spacing(c);
+        if (c.two_dimension_switch) {
+            if (c.scalar_switch) {
+                Read_Init(c, c.T_2D);
+            }
+            else {
+                Read_Init(c, c.V1_2D, c.V3_2D);
+            }
+        }
+        else {
+            if (c.scalar_switch) {
+                Read_Init(c, c.T);
+            }
+            else {
+                Read_Init(c, c.V1, c.V2, c.V3);
+            }
+        }
+    }
+}
+
+
+/**
+********************************************************************************************************************************
+*\brief    Function to read a further scalar field of the shape of the input fields, stored row-major.
+*
+*\param file is the file name
+*\param dset is the dataset name
+*\param field stores the field
+*
+********************************************************************************************************************************
+*/
+void read_matching_field(SF_context& c, string file, string dset, vector<double>& field){
+    int Nx = c.Nx, Ny = c.Ny, Nz = c.Nz;
+    bool two_dimension = c.two_dimension_switch;
+    Input_dataset in;
+    open_input(c, "in/", file, dset, false, in);
+    if (c.two_dimension_switch != two_dimension or c.Nx != Nx or c.Ny != Ny or c.Nz != Nz) {
+        if (c.rank_mpi==0){
+            cerr<<"\nThe field "<<dset<<" in "<<in.path<<" does not have the shape of the input fields\n\n";
+        }
+        close_input(in);
+        fail_analysis();
+    }
+    field.resize(long(Nx)*Ny*Nz);
+    read_input(in, 0, field.data());
+    close_input(in);
+}
+
+
+/**
+********************************************************************************************************************************
+*\brief    Function to parse the name of a derivative of a component of the input fields, such as dUx_dy for a velocity field or dT_dz for a
+*          scalar field.
+*
+*\param scalar decides whether the input field is a scalar field
+*\param two_dimension decides whether the input fields are 2D, in which case only the x and z components and directions are valid
+*\param component is the velocity component differentiated (0, 1, 2 for Ux, Uy, Uz), or -1 for the scalar field
+*\param axis is the direction of the derivative (0, 1, 2 for x, y, z)
+*\return whether the name is a valid derivative
+*
+********************************************************************************************************************************
+*/
+bool parse_gradient(string field, bool scalar, bool two_dimension, int& component, int& axis){
+    string directions = two_dimension ? "xz" : "xyz";
+    if (scalar) {
+        if (field.size() != 5 or field.compare(0, 4, "dT_d") != 0) {
+            return false;
+        }
+        component = -1;
+    }
+    else {
+        if (field.size() != 6 or field.compare(0, 2, "dU") != 0 or field.compare(3, 2, "_d") != 0
+            or directions.find(field[2]) == string::npos) {
+            return false;
+        }
+        component = field[2]-'x';
+    }
+    if (directions.find(field.back()) == string::npos) {
+        return false;
+    }
+    axis = field.back()-'x';
+    return true;
+}
+
+
+/**
+********************************************************************************************************************************
+*\brief    Function to add a multiple of the derivative of a field along one direction to an array, using the OpenMP threads.
+*
+*          The derivative is computed by second-order central differences. At the first and last points of the direction, second-order
+*          one-sided differences are used, or the central differences wrap around if the fields are periodic.
+*
+*\param A is the field, stored row-major with the shape of the input fields
+*\param axis is the direction of the derivative (0, 1, 2 for x, y, z)
+*\param weight multiplies the derivative
+*\param D stores the sum
+*
+********************************************************************************************************************************
+*/
+void add_derivative(SF_context& c, const double* A, int axis, double weight, double* D){
+    int n[3] = {c.Nx, c.two_dimension_switch ? 1 : c.Ny, c.Nz};
+    double h = axis==0 ? c.dx : (axis==1 ? c.dy : c.dz);
+    long stride = axis==0 ? long(n[1])*n[2] : (axis==1 ? n[2] : 1);
+    int N = n[axis];
+    double w = weight/(2*h);
+    #pragma omp parallel for collapse(2) schedule(static) num_threads(c.team_size)
+    for (int i=0; i<n[0]; i++) {
+        for (int j=0; j<n[1]; j++) {
+            for (int k=0; k<n[2]; k++) {
+                long q = (long(i)*n[1]+j)*n[2]+k;
+                int m = axis==0 ? i : (axis==1 ? j : k);
+                if (m > 0 and m < N-1) {
+                    D[q] += w*(A[q+stride]-A[q-stride]);
+                }
+                else if (c.derived_periodic) {
+                    long next = m < N-1 ? q+stride : q-(N-1)*stride;
+                    long prev = m > 0 ? q-stride : q+(N-1)*stride;
+                    D[q] += w*(A[next]-A[prev]);
+                }
+                else if (m == 0) {
+                    D[q] += w*(-3*A[q]+4*A[q+stride]-A[q+2*stride]);
+                }
+                else {
+                    D[q] += w*(3*A[q]-4*A[q-stride]+A[q-2*stride]);
+                }
+            }
+        }
+    }
+}
+
+
+/**
+********************************************************************************************************************************
+*\brief    Function to replace the input fields by the derived field, whose structure functions are then computed.
+*
+*          The vorticity of a 3D velocity field is a vector field; the vorticity \f$ \omega_y = \partial_z u_x - \partial_x u_z \f$ of a 2D
+*          velocity field and the derivatives of a component are scalar fields. The input fields are released as soon as the derived field
+*          is computed, and the names of the structure functions get the name of the derived field appended.
+*
+********************************************************************************************************************************
+*/
+void derive_fields(SF_context& c){
+    if (c.derived_field.empty()) {
+        return;
+    }
+    int component = 0, axis = 0;
+    bool vorticity = c.derived_field == "vorticity";
+    if (not vorticity) {
+        parse_gradient(c.derived_field, c.scalar_switch, c.two_dimension_switch, component, axis);
+    }
+    int n_min = min(c.Nx, c.Nz);
+    if (not c.two_dimension_switch) {
+        n_min = min(n_min, c.Ny);
+    }
+    if (n_min < 3) {
+        if (c.rank_mpi==0) {
+            cerr<<"\nThe derived field needs at least 3 points along each direction\n\n";
+        }
+        fail_analysis();
+    }
+    if (c.rank_mpi==0) {
+        cout<<"Computing the structure functions of the derived field "<<c.derived_field<<(c.derived_periodic ? " (periodic)" : "")<<endl;
+    }
+
+    if (c.two_dimension_switch) {
+        Array<double,2> D(c.Nx, c.Nz);
+        D = 0;
+        if (vorticity) {
+            add_derivative(c, c.V1_2D.data(), 2, 1, D.data());
+            add_derivative(c, c.V3_2D.data(), 0, -1, D.data());
+        }
+        else {
+            add_derivative(c, (component < 0 ? c.T_2D : (component == 0 ? c.V1_2D : c.V3_2D)).data(), axis, 1, D.data());
+        }
+        c.V1_2D.free();
+        c.V3_2D.free();
+        c.T_2D.reference(D);
+    }
+    else if (vorticity) {
+        Array<double,3> Wx(c.Nx, c.Ny, c.Nz), Wy(c.Nx, c.Ny, c.Nz), Wz(c.Nx, c.Ny, c.Nz);
+        Wx = 0;
+        Wy = 0;
+        Wz = 0;
+        add_derivative(c, c.V3.data(), 1, 1, Wx.data());
+        add_derivative(c, c.V2.data(), 2, -1, Wx.data());
+        add_derivative(c, c.V1.data(), 2, 1, Wy.data());
+        add_derivative(c, c.V3.data(), 0, -1, Wy.data());
+        add_derivative(c, c.V2.data(), 0, 1, Wz.data());
+        add_derivative(c, c.V1.data(), 1, -1, Wz.data());
+        c.V1.reference(Wx);
+        c.V2.reference(Wy);
+        c.V3.reference(Wz);
+    }
+    else {
+        Array<double,3> D(c.Nx, c.Ny, c.Nz);
+        D = 0;
+        Array<double,3> A = component < 0 ? c.T : (component == 0 ? c.V1 : (component == 1 ? c.V2 : c.V3));
+        add_derivative(c, A.data(), axis, 1, D.data());
+        c.V1.free();
+        c.V2.free();
+        c.V3.free();
+        c.T.reference(D);
+    }
+
+    if (not vorticity or c.two_dimension_switch) {
+        c.scalar_switch = true;
+    }
+    c.SF_Grid_pll_name += "_"+c.derived_field;
+    c.SF_Grid_perp_name += "_"+c.derived_field;
+    c.SF_Grid_scalar_name += "_"+c.derived_field;
+}
+
+
+/**
+********************************************************************************************************************************
+*\brief    Function to release the fields of an analysis (and their packed copies) once its structure functions are computed.
+*
+********************************************************************************************************************************
+*/
+void free_fields(SF_context& c){
+    c.T.free();
+    c.V1.free();
+    c.V2.free();
+    c.V3.free();
+    c.T_2D.free();
+    c.V1_2D.free();
+    c.V3_2D.free();
+    c.V_packed.free();
+    c.T_packed.free();
+}
+
+
+/**
+********************************************************************************************************************************
+*\brief    Function to read the conditioning field and assign each base point to a bin of its value.
+*
+*          The field must have the shape of the input fields (after the region is applied). Unless the edges of the bins are given, the
+*          bins hold equal numbers of points: their edges are the quantiles of the field. Values outside the edges fall into the first
+*          or last bin. The group offset of every point (its bin times the number of blocks) and the fraction of points in each bin are
+*          saved in the context.
+*
+********************************************************************************************************************************
+*/
+void read_conditional_field(SF_context& c){
+    vector<double> field;
+    read_matching_field(c, c.conditional_file, c.conditional_dataset, field);
+    long n = field.size();
+
+    int bins = c.conditional_bins;
+    if (c.conditional_edges.empty()) {
+        vector<double> sorted(field);
+        sort(sorted.begin(), sorted.end());
+        c.conditional_edges.resize(bins+1);
+        for (int b=0; b<bins; b++) {
+            c.conditional_edges[b] = sorted[b*n/bins];
+        }
+        c.conditional_edges[bins] = sorted[n-1];
+    }
+
+    int nb = num_blocks(c);
+    c.conditional_group.resize(n);
+    c.conditional_fraction.assign(bins, 0);
+    for (long i=0; i<n; i++) {
+        int b = upper_bound(c.conditional_edges.begin()+1, c.conditional_edges.end()-1, field[i])-(c.conditional_edges.begin()+1);
+        c.conditional_group[i] = b*nb;
+        c.conditional_fraction[b] += 1.0/n;
+    }
+
+    if (c.rank_mpi==0) {
+        cout<<"Conditioning on "<<c.conditional_dataset<<" in in/"<<c.conditional_file<<".h5 with "<<bins<<" bins of edges";
+        for (int b=0; b<=bins; b++) {
+            cout<<" "<<c.conditional_edges[b];
+        }
+        cout<<endl;
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to compute the offset tables of the packed fields.
+*
+*           Without bricks, the tables describe the row-major layout. With bricks, the grid is padded to a whole number of bricks along each
+*           direction, the bricks are numbered along a Morton curve by interleaving the bits of the brick indices (the bits of a direction are
+*           dropped once its brick count is exhausted), and the points inside a brick are stored row-major.
+*
+*************************************************************************************************************************************
+*/
+void compute_point_offsets(SF_context& c) {
+    c.point_offset_x.resize(c.Nx);
+    c.point_offset_y.resize(c.Ny);
+    c.point_offset_z.resize(c.Nz);
+
+    if (c.brick_size == 0) {
+        for (int i=0; i<c.Nx; i++) c.point_offset_x(i) = long(i)*c.Ny*c.Nz;
+        for (int j=0; j<c.Ny; j++) c.point_offset_y(j) = long(j)*c.Nz;
+        for (int k=0; k<c.Nz; k++) c.point_offset_z(k) = k;
+        return;
+    }
+
+    int B = c.brick_size;
+    long B3 = long(B)*B*B;
+    int N[3] = {c.Nx, c.Ny, c.Nz};
+    int bits[3];
+    for (int d=0; d<3; d++) {
+        int nb = (N[d]+B-1)/B;
+        bits[d] = 0;
+        while ((1<<bits[d]) < nb) bits[d]++;
+    }
+
+    //Position of each bit of the brick indices in the Morton number, z being the fastest
+    Array<int,2> bit_pos(3, 32);
+    int pos = 0;
+    for (int b=0; b<32; b++) {
+        for (int d=2; d>=0; d--) {
+            if (b < bits[d]) {
+                bit_pos(d, b) = pos++;
+            }
+        }
+    }
+
+    Array<long,1>* tables[3] = {&c.point_offset_x, &c.point_offset_y, &c.point_offset_z};
+    long inner_stride[3] = {long(B)*B, B, 1};
+    for (int d=0; d<3; d++) {
+        for (int i=0; i<N[d]; i++) {
+            long morton = 0;
+            int brick = i/B;
+            for (int b=0; b<bits[d]; b++) {
+                morton |= long((brick>>b)&1) << bit_pos(d, b);
+            }
+            (*tables[d])(i) = morton*B3 + (i%B)*inner_stride[d];
+        }
+    }
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to pack the 3D input fields into the interleaved and/or bricked layout.
+*
+*           The velocity components are copied into V_packed as (Ux, Uy, Uz, 0) per grid point if the interleaved layout or the bricked storage
+*           is selected; the scalar field is copied into T_packed if the bricked storage is selected. The original arrays are then released.
+*
+*************************************************************************************************************************************
+*/
+void pack_fields(SF_context& c) {
+    bool pack_v = not c.scalar_switch and (c.velocity_layout=="interleaved" or c.brick_size>0);
+    bool pack_s = c.scalar_switch and c.brick_size>0;
+    if (not pack_v and not pack_s) {
+        return;
+    }
+
+    compute_point_offsets(c);
+    if (pack_v) {
+        pack_vector(c, c.V1, c.V2, c.V3, c.V_packed);
+        c.V1.free();
+        c.V2.free();
+        c.V3.free();
+    }
+    else {
+        pack_scalar(c, c.T, c.T_packed);
+        c.T.free();
+    }
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to return the number of points of a packed field, as given by the offset tables.
+*
+*************************************************************************************************************************************
+*/
+long packed_size(SF_context& c) {
+    long size = c.point_offset_x(c.point_offset_x.size()-1) + c.point_offset_y(c.point_offset_y.size()-1) + c.point_offset_z(c.point_offset_z.size()-1) + 1;
+    if (c.brick_size > 0) {
+        //Round up to whole bricks
+        long B3 = long(c.brick_size)*c.brick_size*c.brick_size;
+        size = (size+B3-1)/B3*B3;
+    }
+    return size;
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to pack the three components of a 3D velocity field as (Ux, Uy, Uz, 0) per grid point, following the offset tables.
+*
+*\param     Ux, Uy, Uz are the components of the velocity field
+*\param     U is the packed field
+*************************************************************************************************************************************
+*/
+void pack_vector(SF_context& c, Array<double,3> Ux, Array<double,3> Uy, Array<double,3> Uz, Array<double,1>& U) {
+    U.resize(4*packed_size(c));
+    U = 0;
+    for (int i=0; i<Ux.extent(0); i++) {
+        for (int j=0; j<Ux.extent(1); j++) {
+            for (int k=0; k<Ux.extent(2); k++) {
+                long n = 4*(c.point_offset_x(i) + c.point_offset_y(j) + c.point_offset_z(k));
+                U(n) = Ux(i, j, k);
+                U(n+1) = Uy(i, j, k);
+                U(n+2) = Uz(i, j, k);
+            }
+        }
+    }
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to pack a 3D scalar field following the offset tables.
+*
+*\param     T is the scalar field
+*\param     Tp is the packed field
+*************************************************************************************************************************************
+*/
+void pack_scalar(SF_context& c, Array<double,3> T, Array<double,1>& Tp) {
+    Tp.resize(packed_size(c));
+    Tp = 0;
+    for (int i=0; i<T.extent(0); i++) {
+        for (int j=0; j<T.extent(1); j++) {
+            for (int k=0; k<T.extent(2); k++) {
+                Tp(c.point_offset_x(i) + c.point_offset_y(j) + c.point_offset_z(k)) = T(i, j, k);
+            }
+        }
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Structure describing a variant of the 3D kernels, along with its measured time.
+*
+*************************************************************************************************************************************
+*/
+struct Kernel_variant {
+    string layout;
+    int brick;
+    int tile;
+    int threads;
+    double time;
+};
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to decide the variant of the kernels used for the run and to report it.
+*
+*           With --tune the variants are benchmarked. Otherwise, the parameters not given by the user are taken from the tuning profile of
+*           the host if it exists, and from the defaults (planar layout, no bricks, tiles of 16, default number of threads) if not.
+*
+*************************************************************************************************************************************
+*/
+void choose_kernel_variant(SF_context& c) {
+    c.team_size = omp_get_max_threads();
+    if (c.tune_switch) {
+        tune_kernels(c);
+    }
+    else {
+        load_tuning_profile(c);
+    }
+
+    if (c.velocity_layout=="") c.velocity_layout = "planar";
+    if (c.brick_size < 0) c.brick_size = 0;
+    if (c.tile_size < 0) c.tile_size = 16;
+    if (c.num_threads < 0) c.num_threads = 0;
+    if (c.num_threads > 0) {
+        c.team_size = c.num_threads;
+    }
+
+    if (c.rank_mpi==0) {
+        cout<<"\nKernel variant: ";
+        if (c.two_dimension_switch) {
+            cout<<"planar";
+        }
+        else if (c.scalar_switch) {
+            cout<<(c.brick_size>0 ? "bricked" : "planar");
+        }
+        else {
+            cout<<c.velocity_layout;
+        }
+        cout<<", brick size "<<c.brick_size<<", tile size "<<c.tile_size<<", threads ";
+        if (c.num_threads > 0) {
+            cout<<c.num_threads;
+        }
+        else {
+            cout<<c.team_size<<" (default)";
+        }
+        cout<<" ["<<c.kernel_variant_source<<"]"<<endl;
+    }
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to return the path of the tuning profile of this host.
+*
+*           The profile is stored in the directory given by the environment variable FASTSF_TUNING_DIR, or in $HOME/.fastSF by default.
+*
+*************************************************************************************************************************************
+*/
+string tuning_profile_path() {
+    string dir;
+    if (getenv("FASTSF_TUNING_DIR")) {
+        dir = getenv("FASTSF_TUNING_DIR");
+    }
+    else if (getenv("HOME")) {
+        dir = string(getenv("HOME")) + "/.fastSF";
+    }
+    else {
+        dir = ".fastSF";
+    }
+    char host[HOST_NAME_MAX+1];
+    if (gethostname(host, sizeof(host)) != 0) {
+        strcpy(host, "unknown");
+    }
+    host[HOST_NAME_MAX] = '\0';
+    return dir + "/profile_" + host + ".yaml";
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to return the name of the entry of the tuning profile for the kind of structure functions being computed.
+*
+*************************************************************************************************************************************
+*/
+string tuning_case(SF_context& c) {
+    if (c.scalar_switch) {
+        return "scalar_3D";
+    }
+    return c.longitudinal ? "vector_3D_longitudinal" : "vector_3D";
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to read all the entries of a tuning profile.
+*
+*\param     path is the path of the profile
+*\param     entries stores the variants of the profile, by the name of the entry
+*************************************************************************************************************************************
+*/
+void read_tuning_profile(SF_context& c, string path, map<string, Kernel_variant>& entries) {
+    ifstream profile(path.c_str());
+    if (not profile.is_open()) {
+        return;
+    }
+    try {
+        YAML::Node doc;
+        YAML::Parser parser(profile);
+        if (not parser.GetNextDocument(doc)) {
+            return;
+        }
+        for (YAML::Iterator it=doc.begin(); it!=doc.end(); ++it) {
+            string name;
+            Kernel_variant v;
+            it.first()>>name;
+            it.second()["Velocity_layout"]>>v.layout;
+            it.second()["Brick_size"]>>v.brick;
+            it.second()["Tile_size"]>>v.tile;
+            it.second()["Threads"]>>v.threads;
+            v.time = 0;
+            entries[name] = v;
+        }
+    }
+    catch(YAML::Exception& e) {
+        if (c.rank_mpi==0) {
+            cerr<<"WARNING: Ignoring the unreadable tuning profile '"<<path<<"': "<<e.what()<<endl;
+        }
+        entries.clear();
+    }
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to take the kernel parameters not given by the user from the tuning profile of the host.
+*
+*\return    true if an entry for the current kind of structure functions was found.
+*************************************************************************************************************************************
+*/
+bool load_tuning_profile(SF_context& c) {
+    if (c.two_dimension_switch) {
+        return false;
+    }
+    string path = tuning_profile_path();
+    map<string, Kernel_variant> entries;
+    read_tuning_profile(c, path, entries);
+    if (entries.count(tuning_case(c)) == 0) {
+        return false;
+    }
+
+    Kernel_variant& v = entries[tuning_case(c)];
+    if (c.velocity_layout=="") c.velocity_layout = v.layout;
+    if (c.brick_size < 0) c.brick_size = v.brick;
+    if (c.tile_size < 0) c.tile_size = v.tile;
+    if (c.num_threads < 0) c.num_threads = v.threads;
+    c.kernel_variant_source = path;
+    return true;
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to store the current kernel parameters in the tuning profile of the host, keeping the other entries.
+*
+*************************************************************************************************************************************
+*/
+void save_tuning_profile(SF_context& c) {
+    string path = tuning_profile_path();
+    map<string, Kernel_variant> entries;
+    read_tuning_profile(c, path, entries);
+
+    Kernel_variant v;
+    v.layout = c.velocity_layout;
+    v.brick = c.brick_size;
+    v.tile = c.tile_size;
+    v.threads = c.num_threads;
+    entries[tuning_case(c)] = v;
+
+    mkdir(path.substr(0, path.rfind('/')).c_str(), 0777);
+    ofstream profile(path.c_str());
+    if (not profile.is_open()) {
+        cerr<<"WARNING: Unable to write the tuning profile '"<<path<<"'"<<endl;
+        return;
+    }
+    profile<<"#Kernel variants chosen by fastSF --tune on this host\n";
+    for (map<string, Kernel_variant>::iterator it=entries.begin(); it!=entries.end(); ++it) {
+        profile<<it->first<<":\n";
+        profile<<"    Velocity_layout: "<<it->second.layout<<"\n";
+        profile<<"    Brick_size: "<<it->second.brick<<"\n";
+        profile<<"    Tile_size: "<<it->second.tile<<"\n";
+        profile<<"    Threads: "<<it->second.threads<<"\n";
+    }
+    cout<<"\nTuning profile written to "<<path<<endl;
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to measure the time taken by a kernel variant on the tuning sub-grid.
+*
+*           The sums for a fixed set of displacements are computed twice by all the processors simultaneously, and the larger time over the
+*           processors of the faster repetition is returned.
+*
+*\param     t is the context of the sub-grid on which the variant is timed
+*\param     v is the variant to be timed
+*\param     shifts stores the displacements, three indices per displacement
+*************************************************************************************************************************************
+*/
+double time_kernel_variant(SF_context& t, Kernel_variant& v, vector<int>& shifts) {
+    t.velocity_layout = v.layout;
+    t.brick_size = v.brick;
+    t.tile_size = v.tile;
+    t.team_size = v.threads;
+
+    bool packed = t.scalar_switch ? t.brick_size>0 : (t.velocity_layout=="interleaved" or t.brick_size>0);
+    if (packed) {
+        compute_point_offsets(t);
+        if (t.scalar_switch) {
+            pack_scalar(t, t.T, t.T_packed);
+        }
+        else {
+            pack_vector(t, t.V1, t.V2, t.V3, t.V_packed);
+        }
+    }
+
+    int nq = num_orders(t);
+    Array<double,1> S1(sum_size(t)), S2(sum_size(t)), S3(5*nq);
+    double best = 0;
+    for (int rep=0; rep<2; rep++) {
+        MPI_Barrier(t.comm);
+        double time = MPI_Wtime();
+        for (size_t n=0; n<shifts.size(); n+=3) {
+            int x=shifts[n], y=shifts[n+1], z=shifts[n+2];
+            S1 = 0;
+            S2 = 0;
+            S3 = 0;
+            if (t.scalar_switch) {
+                if (packed) moments_scalar_3D_packed(t, t.T_packed, x, y, z, S1);
+                else moments_scalar_3D_planar(t, t.T, x, y, z, S1);
+            }
+            else {
+                if (packed) moments_3D_packed(t, t.V_packed, x, y, z, S1, S2, S3, not t.longitudinal);
+                else moments_3D_planar(t, t.V1, t.V2, t.V3, x, y, z, S1, S2, S3, not t.longitudinal);
+            }
+        }
+        time = MPI_Wtime() - time;
+        MPI_Allreduce(MPI_IN_PLACE, &time, 1, MPI_DOUBLE, MPI_MAX, t.comm);
+        if (rep==0 || time < best) {
+            best = time;
+        }
+    }
+    t.V_packed.free();
+    t.T_packed.free();
+    v.time = best;
+    return best;
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to benchmark the kernel variants on a sub-grid of the input fields and to keep the fastest one.
+*
+*           The candidates are the planar layout, the interleaved layout with tiles of 8, 16 and 32, and the bricked storage with bricks of
+*           4, 8 and 16; the parameters given by the user are kept fixed. The fastest candidate is then timed with 1, 2, 4, ... threads. The
+*           sub-grid is the corner of the input fields with at most 64 points per direction. The winner is written to the tuning profile.
+*
+*************************************************************************************************************************************
+*/
+void tune_kernels(SF_context& c) {
+    if (c.two_dimension_switch) {
+        if (c.rank_mpi==0) {
+            cout<<"\nTuning: only the 3D kernels have variants; nothing to tune.\n";
+        }
+        return;
+    }
+
+    //Context of the sub-grid on which the variants are timed
+    SF_context t = c;
+    int nx = min(c.Nx, 64), ny = min(c.Ny, 64), nz = min(c.Nz, 64);
+    t.Nx = nx;
+    t.Ny = ny;
+    t.Nz = nz;
+    t.T.free();
+    t.V1.free();
+    t.V2.free();
+    t.V3.free();
+    resize_input(t);
+    if (c.scalar_switch) {
+        t.T = c.T(Range(0,nx-1), Range(0,ny-1), Range(0,nz-1));
+    }
+    else {
+        t.V1 = c.V1(Range(0,nx-1), Range(0,ny-1), Range(0,nz-1));
+        t.V2 = c.V2(Range(0,nx-1), Range(0,ny-1), Range(0,nz-1));
+        t.V3 = c.V3(Range(0,nx-1), Range(0,ny-1), Range(0,nz-1));
+    }
+
+    //Small, intermediate and large displacements along the axes and the diagonals
+    int sx[8] = {1, nx/4, nx/2-1, 0, 0, nx/2-1, 1, nx/2-1};
+    int sy[8] = {1, ny/4, ny/2-1, ny/2-1, 0, 0, ny/2-1, 1};
+    int sz[8] = {1, nz/4, nz/2-1, 0, nz/2-1, 0, nz/2-1, 1};
+    vector<int> shifts;
+    for (int n=0; n<8; n++) {
+        shifts.push_back(max(sx[n], 0));
+        shifts.push_back(max(sy[n], 0));
+        shifts.push_back(max(sz[n], 0));
+    }
+
+    string layout_given = c.velocity_layout;
+    int brick_given = c.brick_size, tile_given = c.tile_size, threads_given = c.num_threads;
+    int max_threads = c.team_size;
+
+    vector<Kernel_variant> candidates;
+    Kernel_variant v;
+    v.threads = threads_given>0 ? threads_given : max_threads;
+    v.layout = "planar"; v.brick = 0; v.tile = 16;
+    candidates.push_back(v);
+    int tiles[3] = {8, 16, 32}, bricks[3] = {4, 8, 16};
+    for (int n=0; n<3; n++) {
+        if (not c.scalar_switch) {
+            v.layout = "interleaved"; v.brick = 0; v.tile = tiles[n];
+            candidates.push_back(v);
+        }
+        v.layout = c.scalar_switch ? "planar" : "interleaved"; v.brick = bricks[n]; v.tile = 16;
+        candidates.push_back(v);
+    }
+
+    if (c.rank_mpi==0) {
+        cout<<"\nTuning the kernels on a "<<nx<<" x "<<ny<<" x "<<nz<<" sub-grid..\n";
+    }
+    Kernel_variant best;
+    best.time = -1;
+    for (size_t n=0; n<candidates.size(); n++) {
+        Kernel_variant& cand = candidates[n];
+        bool packed = cand.brick>0 or cand.layout=="interleaved";
+        if ((layout_given!="" and cand.layout!=layout_given and cand.brick==0)
+            or (brick_given>=0 and cand.brick!=brick_given)
+            or (tile_given>0 and packed and cand.brick==0 and cand.tile!=tile_given)) {
+            continue;
+        }
+        time_kernel_variant(t, cand, shifts);
+        if (c.rank_mpi==0) {
+            cout<<"  layout "<<cand.layout<<", brick size "<<cand.brick<<", tile size "<<cand.tile<<": "<<cand.time<<" s\n";
+        }
+        if (best.time < 0 or cand.time < best.time) {
+            best = cand;
+        }
+    }
+    if (best.time < 0) {
+        //The user fixed a combination outside the candidates
+        best.layout = layout_given=="" ? "planar" : layout_given;
+        best.brick = max(brick_given, 0);
+        best.tile = tile_given>0 ? tile_given : 16;
+        best.threads = threads_given>0 ? threads_given : max_threads;
+    }
+
+    //The planar kernels are not threaded; their entry keeps the default number of threads
+    bool threaded = best.brick>0 or (not c.scalar_switch and best.layout=="interleaved");
+    if (not threaded and threads_given <= 0) {
+        best.threads = 0;
+    }
+    if (threaded and threads_given < 0) {
+        for (int n=1; n<max_threads; n*=2) {
+            Kernel_variant cand = best;
+            cand.threads = n;
+            time_kernel_variant(t, cand, shifts);
+            if (c.rank_mpi==0) {
+                cout<<"  threads "<<n<<": "<<cand.time<<" s\n";
+            }
+            if (cand.time < best.time) {
+                best = cand;
+            }
+        }
+    }
+
+    c.velocity_layout = best.layout;
+    c.brick_size = best.brick;
+    c.tile_size = best.tile;
+    c.num_threads = best.threads;
+    c.kernel_variant_source = "tuning";
+
+    if (c.rank_mpi==0) {
+        save_tuning_profile(c);
+    }
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function resize the structure function arrays according to the inputs.
+*  
+*************************************************************************************************************************************
+*/
+void resize_SFs(SF_context& c){
+    resize_angular(c);
+    if (c.rank_mpi==0) {
+        if (not c.two_dimension_switch) {
+            if (c.scalar_switch) {
+                c.SF_Grid_scalar.resize(c.Nx/2, c.Ny/2, c.Nz/2, num_orders(c));
+                c.SF_Grid_scalar = 0; 
+            }
+            else {
+                c.SF_Grid_pll.resize(c.Nx/2, c.Ny/2, c.Nz/2, num_orders(c));
+                c.SF_Grid_pll = 0;
+                if (not c.longitudinal) {
+                    c.SF_Grid_perp.resize(c.Nx/2, c.Ny/2, c.Nz/2, num_orders(c));
+                    c.SF_Grid_perp = 0;
+                }
+            }
+            
+        }
+        else {
+            if (c.scalar_switch) {
+                c.SF_Grid2D_scalar.resize(c.Nx/2, c.Nz/2, num_orders(c));
+                c.SF_Grid2D_scalar = 0; 
+            }
+            else {
+                c.SF_Grid2D_pll.resize(c.Nx/2, c.Nz/2, num_orders(c));
+                c.SF_Grid2D_pll = 0; 
+                if (not c.longitudinal) {
+                    c.SF_Grid2D_perp.resize(c.Nx/2, c.Nz/2, num_orders(c));
+                    c.SF_Grid2D_perp = 0;
+                }
+            }
+        }   
+
+        if (c.error_blocks > 1) {
+            if (not c.two_dimension_switch) {
+                Array<double,4>* grids[] = {&c.SF_Grid_scalar, &c.SF_Grid_pll, &c.SF_Grid_perp};
+                Array<double,4>* errors[] = {&c.SF_Grid_scalar_err, &c.SF_Grid_pll_err, &c.SF_Grid_perp_err};
+                for (int n=0; n<3; n++) {
+                    if (grids[n]->size() > 0) {
+                        errors[n]->resize(c.Nx/2, c.Ny/2, c.Nz/2, num_orders(c));
+                        *errors[n] = 0;
+                    }
+                }
+            }
+            else {
+                Array<double,3>* grids[] = {&c.SF_Grid2D_scalar, &c.SF_Grid2D_pll, &c.SF_Grid2D_perp};
+                Array<double,3>* errors[] = {&c.SF_Grid2D_scalar_err, &c.SF_Grid2D_pll_err, &c.SF_Grid2D_perp_err};
+                for (int n=0; n<3; n++) {
+                    if (grids[n]->size() > 0) {
+                        errors[n]->resize(c.Nx/2, c.Nz/2, num_orders(c));
+                        *errors[n] = 0;
+                    }
+                }
+            }
+        }
+
+        if (not c.transverse_axis.empty() and not c.scalar_switch) {
+            c.SF_Grid_comp.resize(5, c.Nx/2, c.Ny/2, c.Nz/2, num_orders(c));
+            c.SF_Grid_comp = 0;
+        }
+
+        if (c.write_sums) {
+            if (not c.two_dimension_switch) {
+                c.SF_count.resize(c.Nx/2, c.Ny/2, c.Nz/2, 1);
+                c.SF_count = 0;
+            }
+            else {
+                c.SF_count_2D.resize(c.Nx/2, c.Nz/2, 1);
+                c.SF_count_2D = 0;
+            }
+        }
+
+        if (c.conditional_bins > 0) {
+            if (not c.two_dimension_switch) {
+                Array<double,4>* grids[] = {&c.SF_Grid_scalar, &c.SF_Grid_pll, &c.SF_Grid_perp};
+                Array<double,5>* conds[] = {&c.SF_Grid_scalar_cond, &c.SF_Grid_pll_cond, &c.SF_Grid_perp_cond};
+                for (int n=0; n<3; n++) {
+                    if (grids[n]->size() > 0) {
+                        conds[n]->resize(c.conditional_bins, c.Nx/2, c.Ny/2, c.Nz/2, num_orders(c));
+                        *conds[n] = 0;
+                    }
+                }
+            }
+            else {
+                Array<double,3>* grids[] = {&c.SF_Grid2D_scalar, &c.SF_Grid2D_pll, &c.SF_Grid2D_perp};
+                Array<double,4>* conds[] = {&c.SF_Grid2D_scalar_cond, &c.SF_Grid2D_pll_cond, &c.SF_Grid2D_perp_cond};
+                for (int n=0; n<3; n++) {
+                    if (grids[n]->size() > 0) {
+                        conds[n]->resize(c.conditional_bins, c.Nx/2, c.Nz/2, num_orders(c));
+                        *conds[n] = 0;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to compute the structure functions based on the inputs provided by the user.
+*************************************************************************************************************************************
+*/
+void calc_SFs(SF_context& c) {
+    if (c.two_dimension_switch){
+        if (c.scalar_switch) {
+            SF_scalar_2D(c, c.T_2D);
+        }
+        else {
+            if (c.longitudinal) {
+                SFunc_long_2D(c, c.V1_2D, c.V3_2D);
+            } 
+            else {
+                SFunc2D(c, c.V1_2D, c.V3_2D);
+            }
+        }
+    }
+    
+    else {
+        if (c.scalar_switch) {
+            if (c.brick_size > 0) {
+                SF_scalar_3D_packed(c, c.T_packed);
+            }
+            else {
+                SF_scalar_3D(c, c.T);
+            }
+        }
+        else {
+            if (c.velocity_layout=="interleaved" or c.brick_size > 0) {
+                if (c.longitudinal) {
+                    SFunc_long_3D_packed(c, c.V_packed);
+                }
+                else {
+                    SFunc3D_packed(c, c.V_packed);
+                }
+            }
+            else if (c.longitudinal) {
+                SFunc_long_3D(c, c.V1, c.V2, c.V3);
+            }
+            else {
+                SFunc3D(c, c.V1, c.V2, c.V3);
+            }
+        }
+    }
+    reduce_angular(c);
+    if (not c.pdf_separations.empty()) {
+        joint_pdfs(c);
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to write the structure function arrays to the disk.
+*************************************************************************************************************************************
+*/
+void write_SFs(SF_context& c) {
+    if (c.rank_mpi==0){
+        mkdir("out",0777);
+
+        //The writer takes the only references to the result arrays, so that they are released as soon as they are written
+        shared_ptr<Written_results> results(new Written_results);
+        Written_results& R = *results;
+        R.labels = order_labels(c);
+        R.edges = c.conditional_edges;
+        R.fraction = c.conditional_fraction;
+        R.bins_file = (c.scalar_switch ? c.SF_Grid_scalar_name : c.SF_Grid_pll_name)+"_cond_bins";
+        if (c.joint_pdf.count.size() > 0) {
+            R.joint_pdf.push_back(make_pair(c.joint_pdf, c.SF_Grid_pll_name+"_joint_pdf"));
+        }
+        c.joint_pdf.separations.free();
+        c.joint_pdf.count.free();
+        c.joint_pdf.edges_pll.free();
+        c.joint_pdf.edges_perp.free();
+        c.joint_pdf.edges_scalar.free();
+        c.joint_pdf.pll_perp.free();
+        c.joint_pdf.pll_scalar.free();
+        if (not c.angular_bins.empty()) {
+            R.angular.push_back(make_pair(c.angular[0], c.scalar_switch ? c.SF_Grid_scalar_name : c.SF_Grid_pll_name));
+            if (not c.scalar_switch and not c.longitudinal) {
+                R.angular.push_back(make_pair(c.angular[1], c.SF_Grid_perp_name));
+            }
+            for (size_t i=0; i<R.angular.size(); i++) {
+                normalize_angular(c, R.angular[i].first);
+            }
+            for (int n=0; n<2; n++) {
+                c.angular[n].sector.free();
+                c.angular[n].sector_count.free();
+                c.angular[n].harmonic.free();
+                c.angular[n].shell_count.free();
+                c.angular[n].r_edges.free();
+            }
+        }
+        c.output_files.clear();
+        if (c.two_dimension_switch) {
+            if (c.scalar_switch){
+                R.grids_2D.push_back(make_pair(c.SF_Grid2D_scalar, c.SF_Grid_scalar_name));
+            }
+            else {
+                R.grids_2D.push_back(make_pair(c.SF_Grid2D_pll, c.SF_Grid_pll_name));
+                if (not c.longitudinal) {
+                    R.grids_2D.push_back(make_pair(c.SF_Grid2D_perp, c.SF_Grid_perp_name));
+                }
+            }
+            if (c.write_sums) {
+                R.sums_2D = R.grids_2D;
+            }
+            for (size_t i=0; i<R.grids_2D.size() and c.scaling_bins>0; i++) {
+                Array<double,3> A = R.grids_2D[i].first;
+                R.summaries.push_back(make_pair(Scaling_summary(), R.grids_2D[i].second));
+                scaling_summary(c, A.data(), A.extent(0), 1, A.extent(1), R.summaries.back().first);
+            }
+            Array<double,3>* errors[] = {&c.SF_Grid2D_scalar_err, &c.SF_Grid2D_pll_err, &c.SF_Grid2D_perp_err};
+            Array<double,4>* conds[] = {&c.SF_Grid2D_scalar_cond, &c.SF_Grid2D_pll_cond, &c.SF_Grid2D_perp_cond};
+            string names[] = {c.SF_Grid_scalar_name, c.SF_Grid_pll_name, c.SF_Grid_perp_name};
+            for (int n=0; n<3; n++) {
+                if (errors[n]->size() > 0) {
+                    R.grids_2D.push_back(make_pair(*errors[n], names[n]+"_err"));
+                    errors[n]->free();
+                }
+                for (int b=0; b<conds[n]->extent(0) and conds[n]->size()>0; b++) {
+                    R.grids_2D.push_back(make_pair((*conds[n])(b,Range::all(),Range::all(),Range::all()), names[n]+"_cond"+int_to_str(b)));
+                }
+                conds[n]->free();
+            }
+            for (size_t i=0; i<R.grids_2D.size(); i++) {
+                c.output_files.push_back(R.grids_2D[i].second+".h5");
+            }
+            for (size_t i=0; i<R.sums_2D.size(); i++) {
+                c.output_files.push_back(R.sums_2D[i].second+"_sums.h5");
+            }
+            R.count_2D.reference(c.SF_count_2D);
+            c.SF_count_2D.free();
+            c.SF_Grid2D_scalar.free();
+            c.SF_Grid2D_pll.free();
+            c.SF_Grid2D_perp.free();
+        }
+        else {
+            if (c.scalar_switch){
+                R.grids.push_back(make_pair(c.SF_Grid_scalar, c.SF_Grid_scalar_name));
+            }
+            else {
+                R.grids.push_back(make_pair(c.SF_Grid_pll, c.SF_Grid_pll_name));
+                if (not c.longitudinal) {
+                    R.grids.push_back(make_pair(c.SF_Grid_perp, c.SF_Grid_perp_name));
+                }
+            }
+            if (c.write_sums) {
+                R.sums = R.grids;
+            }
+            for (size_t i=0; i<R.grids.size() and c.scaling_bins>0; i++) {
+                Array<double,4> A = R.grids[i].first;
+                R.summaries.push_back(make_pair(Scaling_summary(), R.grids[i].second));
+                scaling_summary(c, A.data(), A.extent(0), A.extent(1), A.extent(2), R.summaries.back().first);
+            }
+            Array<double,4>* errors[] = {&c.SF_Grid_scalar_err, &c.SF_Grid_pll_err, &c.SF_Grid_perp_err};
+            Array<double,5>* conds[] = {&c.SF_Grid_scalar_cond, &c.SF_Grid_pll_cond, &c.SF_Grid_perp_cond};
+            string names[] = {c.SF_Grid_scalar_name, c.SF_Grid_pll_name, c.SF_Grid_perp_name};
+            for (int n=0; n<3; n++) {
+                if (errors[n]->size() > 0) {
+                    R.grids.push_back(make_pair(*errors[n], names[n]+"_err"));
+                    errors[n]->free();
+                }
+                for (int b=0; b<conds[n]->extent(0) and conds[n]->size()>0; b++) {
+                    R.grids.push_back(make_pair((*conds[n])(b,Range::all(),Range::all(),Range::all(),Range::all()), names[n]+"_cond"+int_to_str(b)));
+                }
+                conds[n]->free();
+            }
+            string components[] = {c.SF_Grid_pll_name+"_dUx", c.SF_Grid_pll_name+"_dUy", c.SF_Grid_pll_name+"_dUz",
+                                   c.SF_Grid_perp_name+"_1", c.SF_Grid_perp_name+"_2"};
+            for (int n=0; n<c.SF_Grid_comp.extent(0) and c.SF_Grid_comp.size()>0; n++) {
+                R.grids.push_back(make_pair(c.SF_Grid_comp(n,Range::all(),Range::all(),Range::all(),Range::all()), components[n]));
+                if (c.write_sums) {
+                    R.sums.push_back(R.grids.back());
+                }
+            }
+            for (size_t i=0; i<R.grids.size(); i++) {
+                c.output_files.push_back(R.grids[i].second+".h5");
+            }
+            for (size_t i=0; i<R.sums.size(); i++) {
+                c.output_files.push_back(R.sums[i].second+"_sums.h5");
+            }
+            R.count.reference(c.SF_count);
+            c.SF_count.free();
+            c.SF_Grid_comp.free();
+            c.SF_Grid_scalar.free();
+            c.SF_Grid_pll.free();
+            c.SF_Grid_perp.free();
+        }
+        for (size_t i=0; i<R.summaries.size(); i++) {
+            c.output_files.push_back(R.summaries[i].second+"_summary.h5");
+        }
+        for (size_t i=0; i<R.angular.size(); i++) {
+            c.output_files.push_back(R.angular[i].second+"_angular.h5");
+        }
+        if (not R.fraction.empty()) {
+            c.output_files.push_back(R.bins_file+".h5");
+        }
+        for (size_t i=0; i<R.joint_pdf.size(); i++) {
+            c.output_files.push_back(R.joint_pdf[i].second+".h5");
+        }
+
+        for (size_t i=0; i<R.summaries.size(); i++) {
+            Scaling_summary& S = R.summaries[i].first;
+            cout<<"\nScaling exponents of "<<R.summaries[i].second<<" for r in ["<<S.fit_range(0)<<", "<<S.fit_range(1)<<"]:\n";
+            for (int p=0; p<num_orders(c); p++) {
+                cout<<"    zeta_"<<R.labels[p]<<" = "<<S.zeta(p);
+                if (S.ess.size() > 0) {
+                    cout<<",  ESS zeta_"<<R.labels[p]<<"/zeta_"<<c.ess_order<<" = "<<S.ess(p);
+                }
+                cout<<endl;
+            }
+        }
+
+        submit_write(c, bind(write_results, std::move(results)));
+    }
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function run by the writer to write the results handed over by write_SFs() or flush_progress().
+*
+*           The structure functions of a partial result are stamped with its attribute "resolved_l", and nothing else is written.
+*************************************************************************************************************************************
+*/
+void write_results(const shared_ptr<Written_results>& results) {
+    Written_results& R = *results;
+    for (size_t i=0; i<R.grids_2D.size(); i++) {
+        write_3D(R.grids_2D[i].first, R.grids_2D[i].second, R.labels);
+    }
+    for (size_t i=0; i<R.grids.size(); i++) {
+        write_4D(R.grids[i].first, R.grids[i].second, R.labels);
+    }
+    if (R.resolved_l >= 0) {
+        for (size_t i=0; i<R.grids_2D.size(); i++) {
+            write_attribute("out/"+R.grids_2D[i].second+".h5", "resolved_l", R.resolved_l);
+        }
+        for (size_t i=0; i<R.grids.size(); i++) {
+            write_attribute("out/"+R.grids[i].second+".h5", "resolved_l", R.resolved_l);
+        }
+        return;
+    }
+    for (size_t i=0; i<R.sums_2D.size(); i++) {
+        write_sums_3D(R.sums_2D[i].first, R.count_2D, R.sums_2D[i].second+"_sums", R.labels);
+    }
+    for (size_t i=0; i<R.sums.size(); i++) {
+        write_sums_4D(R.sums[i].first, R.count, R.sums[i].second+"_sums", R.labels);
+    }
+    for (size_t i=0; i<R.summaries.size(); i++) {
+        write_summary(R.summaries[i].first, R.summaries[i].second);
+    }
+    for (size_t i=0; i<R.angular.size(); i++) {
+        write_angular(R.angular[i].first, R.angular[i].second);
+    }
+    if (not R.fraction.empty()) {
+        write_conditional_bins(R.edges, R.fraction, R.bins_file);
+    }
+    for (size_t i=0; i<R.joint_pdf.size(); i++) {
+        write_joint_pdfs(R.joint_pdf[i].first, R.joint_pdf[i].second);
+    }
+    cout<<"\nWriting completed\n";
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to average the structure functions over logarithmic bins of the magnitude of the displacement, and to fit their exponents.
+ *
+ *          The bins span the magnitudes of the nonzero displacements of the grid, from the smallest grid spacing to the largest displacement.
+ *          The local slopes \f$ d \log |S_q| / d \log r \f$ are the centred differences between the neighbouring non-empty bins. The scaling
+ *          exponents \f$ \zeta_q \f$ are the least-squares slopes of \f$ \log |S_q| \f$ against \f$ \log r \f$ over the bins within the fit range,
+ *          and the extended self-similarity exponents those of \f$ \log |S_q| \f$ against \f$ \log |S_{q_{ref}}| \f$ over all the bins. The
+ *          magnitudes are used so that the odd orders of the signed increments can be fitted. Undefined values are stored as NaN.
+ *
+ * \param grid points to the structure functions, of shape \f$ (n_x, n_y, n_z, q_2-q_1+1) \f$ (\f$ n_y = 1 \f$ for 2D fields)
+ * \param nx, ny, nz are the numbers of displacements along \f$ x, y, z \f$
+ * \param S stores the summary
+ ********************************************************************************************************************************************
+ */
+void scaling_summary(SF_context& c, const double* grid, int nx, int ny, int nz, Scaling_summary& S)
+{
+    int nq = num_orders(c);
+    int nb = c.scaling_bins;
+    double dy = c.two_dimension_switch ? 0 : c.dy;
+    double r_lo, r_hi, bin_width;
+    radial_binning(c, nx, ny, nz, nb, r_lo, r_hi, bin_width);
+
+    S.r.resize(nb);
+    S.count.resize(nb);
+    S.S.resize(nb, nq);
+    S.slope.resize(nb, nq);
+    S.r = 0;
+    S.count = 0;
+    S.S = 0;
+    for (int x=0; x<nx; x++) {
+        for (int y=0; y<ny; y++) {
+            for (int z=0; z<nz; z++) {
+                if (x==0 and y==0 and z==0) {
+                    continue;
+                }
+                double r = sqrt(pow(x*c.dx,2)+pow(y*dy,2)+pow(z*c.dz,2));
+                int b = max(0, min(nb-1, int(log(r/r_lo)/bin_width)));
+                const double* Sq = grid + ((long(x)*ny+y)*nz+z)*nq;
+                S.count(b) += 1;
+                S.r(b) += log(r);
+                for (int p=0; p<nq; p++) {
+                    S.S(b,p) += Sq[p];
+                }
+            }
+        }
+    }
+
+    vector<int> used;
+    for (int b=0; b<nb; b++) {
+        if (S.count(b) > 0) {
+            S.r(b) = exp(S.r(b)/S.count(b));
+            for (int p=0; p<nq; p++) {
+                S.S(b,p) /= S.count(b);
+            }
+            used.push_back(b);
+        }
+        else {
+            S.r(b) = r_lo*exp((b+0.5)*bin_width);
+            for (int p=0; p<nq; p++) {
+                S.S(b,p) = NAN;
+            }
+        }
+    }
+
+    S.slope = NAN;
+    for (size_t n=0; n<used.size() and used.size()>1; n++) {
+        int lo = used[n>0 ? n-1 : n];
+        int hi = used[n+1<used.size() ? n+1 : n];
+        for (int p=0; p<nq; p++) {
+            S.slope(used[n],p) = (log(fabs(S.S(hi,p)))-log(fabs(S.S(lo,p))))/(log(S.r(hi))-log(S.r(lo)));
+        }
+    }
+
+    S.fit_range.resize(2);
+    S.fit_range(0) = c.scaling_range.empty() ? r_lo : c.scaling_range[0];
+    S.fit_range(1) = c.scaling_range.empty() ? r_hi : c.scaling_range[1];
+    S.zeta.resize(nq);
+    for (int p=0; p<nq; p++) {
+        vector<double> X, Y;
+        for (size_t n=0; n<used.size(); n++) {
+            int b = used[n];
+            if (S.r(b) >= S.fit_range(0) and S.r(b) <= S.fit_range(1) and S.S(b,p) != 0) {
+                X.push_back(log(S.r(b)));
+                Y.push_back(log(fabs(S.S(b,p))));
+            }
+        }
+        S.zeta(p) = fit_slope(X, Y);
+    }
+
+    int ref = -1;
+    for (int p=0; p<nq; p++) {
+        if (order_value(c, p) == c.ess_order) {
+            ref = p;
+        }
+    }
+    if (ref >= 0) {
+        S.ess.resize(nq);
+        for (int p=0; p<nq; p++) {
+            vector<double> X, Y;
+            for (size_t n=0; n<used.size(); n++) {
+                int b = used[n];
+                if (S.S(b,ref) != 0 and S.S(b,p) != 0) {
+                    X.push_back(log(fabs(S.S(b,ref))));
+                    Y.push_back(log(fabs(S.S(b,p))));
+                }
+            }
+            S.ess(p) = fit_slope(X, Y);
+        }
+    }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to return the least-squares slope of Y against X (NaN for fewer than two points).
+ ********************************************************************************************************************************************
+ */
+double fit_slope(const vector<double>& X, const vector<double>& Y)
+{
+    int n = X.size();
+    double mx = 0, my = 0;
+    for (int i=0; i<n; i++) {
+        mx += X[i]/n;
+        my += Y[i]/n;
+    }
+    double sxx = 0, sxy = 0;
+    for (int i=0; i<n; i++) {
+        sxx += (X[i]-mx)*(X[i]-mx);
+        sxy += (X[i]-mx)*(Y[i]-my);
+    }
+    return (n < 2 or sxx == 0) ? NAN : sxy/sxx;
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to find the logarithmic bins of the magnitude of the displacement.
+ *
+ *          The bins span the magnitudes of the nonzero displacements, from the smallest grid spacing to the largest displacement. The
+ *          displacement of magnitude \f$ r \f$ falls in the bin \f$ \lfloor \log(r/r_{lo})/w \rfloor \f$, \f$ w \f$ being the width of the bins.
+ *
+ * \param nx, ny, nz are the numbers of displacements along \f$ x, y, z \f$
+ * \param nb is the number of bins
+ * \param r_lo, r_hi store the smallest and the largest magnitude of the displacements
+ * \param width stores the width of the bins in \f$ \log r \f$
+ ********************************************************************************************************************************************
+ */
+void radial_binning(SF_context& c, int nx, int ny, int nz, int nb, double& r_lo, double& r_hi, double& width)
+{
+    double dy = c.two_dimension_switch ? 0 : c.dy;
+    r_lo = numeric_limits<double>::max();
+    if (nx > 1) r_lo = min(r_lo, c.dx);
+    if (ny > 1) r_lo = min(r_lo, dy);
+    if (nz > 1) r_lo = min(r_lo, c.dz);
+    r_hi = sqrt(pow((nx-1)*c.dx,2)+pow((ny-1)*dy,2)+pow((nz-1)*c.dz,2));
+    width = r_hi > r_lo ? log(r_hi/r_lo)/nb : 1;
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to allocate and clear the angular sums of the structure functions on every processor.
+ ********************************************************************************************************************************************
+ */
+void resize_angular(SF_context& c)
+{
+    if (c.angular_bins.empty()) {
+        return;
+    }
+    int nq = num_orders(c);
+    int nr = c.angular_bins[0], nt = c.angular_bins[1], np = c.angular_bins[2];
+    int nlm = c.two_dimension_switch ? 0 : (c.angular_degree+1)*(c.angular_degree+1);
+    double r_lo, r_hi, width;
+    radial_binning(c, c.Nx/2, c.two_dimension_switch ? 1 : c.Ny/2, c.Nz/2, nr, r_lo, r_hi, width);
+    for (int n=0; n<2; n++) {
+        Angular_moments& A = c.angular[n];
+        A.sector.resize(nr, nt, np, nq);
+        A.sector_count.resize(nr, nt, np);
+        A.harmonic.resize(nr, max(nlm,1), nq);
+        A.shell_count.resize(nr);
+        A.r_edges.resize(nr+1);
+        A.sector = 0;
+        A.sector_count = 0;
+        A.harmonic = 0;
+        A.shell_count = 0;
+        for (int b=0; b<=nr; b++) {
+            A.r_edges(b) = r_lo*exp(b*width);
+        }
+    }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to compute the real spherical harmonics up to a degree.
+ *
+ *          \f$ Y_{lm} = N_{lm} P_l^{|m|}(\cos\theta) \f$ times \f$ \sqrt{2}\cos(m\phi) \f$ for \f$ m > 0 \f$, 1 for \f$ m = 0 \f$ and
+ *          \f$ \sqrt{2}\sin(|m|\phi) \f$ for \f$ m < 0 \f$, with \f$ N_{lm} = \sqrt{(2l+1)/(4\pi)\,(l-|m|)!/(l+|m|)!} \f$, so that they are
+ *          orthonormal on the sphere. \f$ Y_{lm} \f$ is stored at the index \f$ l^2 + l + m \f$.
+ *
+ * \param L is the largest degree
+ * \param theta, phi are the polar angle and the azimuth
+ * \param Y stores the \f$ (L+1)^2 \f$ harmonics
+ ********************************************************************************************************************************************
+ */
+void real_harmonics(int L, double theta, double phi, double* Y)
+{
+    double x = cos(theta), s = sin(theta);
+    double P_mm = 1;
+    for (int m=0; m<=L; m++) {
+        if (m > 0) {
+            P_mm *= -(2*m-1)*s;
+        }
+        double P_lm2 = 0, P_lm1 = P_mm;
+        for (int l=m; l<=L; l++) {
+            double P_lm;
+            if (l == m) {
+                P_lm = P_mm;
+            }
+            else if (l == m+1) {
+                P_lm = x*(2*m+1)*P_mm;
+            }
+            else {
+                P_lm = ((2*l-1)*x*P_lm1 - (l+m-1)*P_lm2)/(l-m);
+            }
+            if (l > m) {
+                P_lm2 = P_lm1;
+                P_lm1 = P_lm;
+            }
+            double N = (2*l+1)/(4*M_PI);
+            for (int k=l-m+1; k<=l+m; k++) {
+                N /= k;
+            }
+            N = sqrt(N);
+            if (m == 0) {
+                Y[l*l+l] = N*P_lm;
+            }
+            else {
+                Y[l*l+l+m] = sqrt(2.0)*N*P_lm*cos(m*phi);
+                Y[l*l+l-m] = sqrt(2.0)*N*P_lm*sin(m*phi);
+            }
+        }
+    }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to add the structure functions of a displacement to the angular sums.
+ *
+ *          The angles are measured in the octant of the computed displacements: \f$ \theta \f$ from the \f$ z \f$ axis and \f$ \phi \f$ from
+ *          the \f$ x \f$ axis in the \f$ x \f$-\f$ y \f$ plane (for 2D fields, \f$ \theta \f$ is the angle from the \f$ z \f$ axis in the
+ *          \f$ x \f$-\f$ z \f$ plane). For the projections onto the spherical harmonics, the structure functions are extended to the whole sphere
+ *          by the reflections of the axes; each distinct image of the displacement is weighted by its number of pairs of points.
+ *
+ * \param x, y, z are the indices of the displacement
+ * \param count is the number of pairs of points of the displacement
+ * \param S1, S2 store the structure functions of the displacement in their first num_orders() entries
+ * \param two_grids decides whether S2 is to be added
+ ********************************************************************************************************************************************
+ */
+void accumulate_angular(SF_context& c, int x, int y, int z, double count, Array<double,1> S1, Array<double,1> S2, bool two_grids)
+{
+    if (c.angular_bins.empty() or (x==0 and y==0 and z==0)) {
+        return;
+    }
+    int nq = num_orders(c);
+    int nr = c.angular_bins[0], nt = c.angular_bins[1], np = c.angular_bins[2];
+    double lx = x*c.dx, ly = c.two_dimension_switch ? 0 : y*c.dy, lz = z*c.dz;
+    double r = sqrt(lx*lx+ly*ly+lz*lz);
+    double r_lo = c.angular[0].r_edges(0);
+    double width = log(c.angular[0].r_edges(1)/r_lo);
+    int b = max(0, min(nr-1, int(log(r/r_lo)/width)));
+    double theta = acos(lz/r), phi = atan2(ly, lx);
+    int t = min(nt-1, int(theta/(M_PI/2)*nt));
+    int k = min(np-1, int(phi/(M_PI/2)*np));
+
+    Array<double,1>* S[] = {&S1, &S2};
+    for (int n=0; n<(two_grids ? 2 : 1); n++) {
+        Angular_moments& A = c.angular[n];
+        A.sector_count(b,t,k) += count;
+        for (int p=0; p<nq; p++) {
+            A.sector(b,t,k,p) += count*(*S[n])(p);
+        }
+    }
+
+    if (c.two_dimension_switch or c.angular_degree < 0) {
+        return;
+    }
+    int nlm = (c.angular_degree+1)*(c.angular_degree+1);
+    vector<double> Y(nlm);
+    for (int sx=-1; sx<=1; sx+=2) {
+        for (int sy=-1; sy<=1; sy+=2) {
+            for (int sz=-1; sz<=1; sz+=2) {
+                if ((sx<0 and x==0) or (sy<0 and y==0) or (sz<0 and z==0)) {
+                    continue;
+                }
+                real_harmonics(c.angular_degree, acos(sz*lz/r), atan2(sy*ly, sx*lx), Y.data());
+                for (int n=0; n<(two_grids ? 2 : 1); n++) {
+                    Angular_moments& A = c.angular[n];
+                    A.shell_count(b) += count;
+                    for (int lm=0; lm<nlm; lm++) {
+                        for (int p=0; p<nq; p++) {
+                            A.harmonic(b,lm,p) += count*Y[lm]*(*S[n])(p);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to add up the angular sums of all the processors on the first processor.
+ ********************************************************************************************************************************************
+ */
+void reduce_angular(SF_context& c)
+{
+    if (c.angular_bins.empty()) {
+        return;
+    }
+    for (int n=0; n<2; n++) {
+        Angular_moments& A = c.angular[n];
+        double* data[] = {A.sector.data(), A.sector_count.data(), A.harmonic.data(), A.shell_count.data()};
+        long size[] = {A.sector.size(), A.sector_count.size(), A.harmonic.size(), A.shell_count.size()};
+        for (int i=0; i<4; i++) {
+            if (c.rank_mpi==0) {
+                MPI_Reduce(MPI_IN_PLACE, data[i], size[i], MPI_DOUBLE, MPI_SUM, 0, c.comm);
+            }
+            else {
+                MPI_Reduce(data[i], NULL, size[i], MPI_DOUBLE, MPI_SUM, 0, c.comm);
+            }
+        }
+    }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to reduce the angular sums to the pair-weighted means.
+ *
+ *          The sectors store the mean structure functions (NaN for empty sectors). The projections are normalized as
+ *          \f$ S_{lm}(r) = \sqrt{4\pi}\,\langle S\,Y_{lm} \rangle \f$, the average being over the pairs of points of the shell, so that
+ *          \f$ S_{00} \f$ is the mean structure function of the shell.
+ ********************************************************************************************************************************************
+ */
+void normalize_angular(SF_context& c, Angular_moments& A)
+{
+    int nq = num_orders(c);
+    for (int b=0; b<A.sector.extent(0); b++) {
+        for (int t=0; t<A.sector.extent(1); t++) {
+            for (int k=0; k<A.sector.extent(2); k++) {
+                for (int p=0; p<nq; p++) {
+                    A.sector(b,t,k,p) = A.sector_count(b,t,k) > 0 ? A.sector(b,t,k,p)/A.sector_count(b,t,k) : NAN;
+                }
+            }
+        }
+        for (int lm=0; lm<A.harmonic.extent(1); lm++) {
+            for (int p=0; p<nq; p++) {
+                A.harmonic(b,lm,p) = A.shell_count(b) > 0 ? sqrt(4*M_PI)*A.harmonic(b,lm,p)/A.shell_count(b) : NAN;
+            }
+        }
+    }
+    if (c.two_dimension_switch or c.angular_degree < 0) {
+        A.harmonic.free();
+        A.shell_count.free();
+    }
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to test the correctness of the code.
+*************************************************************************************************************************************
+*/
+void test_cases(SF_context& c) {
+    if(c.rank_mpi==0){
+        cout<<"\nCOMMENCING TESTING OF THE CODE.\n";
+        if (c.scalar_switch){
+            if (c.two_dimension_switch){
+                SCALAR_TEST_CASE_2D(c);
+            }
+            else{
+                SCALAR_TEST_CASE_3D(c);
+            }
+        }
+        else{
+            if (c.two_dimension_switch){
+                VECTOR_TEST_CASE_2D(c);
+            }
+            else{
+                VECTOR_TEST_CASE_3D(c);
+            }
+        }
+    }
+    
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to obtain the \$ x \$ and \$ y \$ ranks of the processor.
+*
+*
+*\param     rank is the rank of the processor.
+*\param     py is the number of processors in \$ y \$ direction.
+*\param     rankx is the \$ x \$ rank of the processor.
+*\param     ranky is the \$ y \$ rank of the processor.
+* 
+*************************************************************************************************************************************
+*/
+void get_rank(int rank, int py, int& rankx, int& ranky){
+    ranky=rank%py;
+    rankx=(rank-ranky)/py;
+}
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to allocate the index list along a given direction for a particular rank.
+*           
+*     
+*
+* \param    index_list stores the list of indices.
+* \param    Nx is half of the number of points along the given direction.
+* \param    px is the number of processors along the given direction.
+* \param    rank is the \$ x \$ or \$ y \$ rank of the processor.
+*************************************************************************************************************************************
+*/
+void compute_index_list(Array<int,1>& index_list, int Nx, int px, int rank){
+    int list_size=Nx/px;
+    index_list.resize(list_size);
+    for (int i=0; i<list_size; i+=2){
+        index_list(i)=rank+i*px;
+        if (px!=Nx) {
+          index_list(i+1)=Nx-1-index_list(i);
+        }
+    }
+}
+
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to distribute load equally among all the MPI processors.
+*           
+*           
+* \param    index_list stores the matrix of the indices for different ranks.
+* \param    Nx is the number of points along \$ x \$ direction.
+* \param    Ny is the number of points along \$ y \$ (or \$ z \$) direction. 
+*************************************************************************************************************************************
+*/
+void compute_index_list(SF_context& c, Array<int,3>& index_list, int Nx, int Ny){
+    int list_size=(Nx*Ny)/(4*c.P);
+    index_list.resize(list_size,2,c.P);
+
+    int py=(c.P/c.px);
+    Array<int,1> x;
+    Array<int,1> y;
+    
+    int rankx,ranky;
+    int nx=Nx/(2*c.px),ny=Ny/(2*py);
+
+    
+    for (int rank_id=0; rank_id<c.P; rank_id++){
+        get_rank(rank_id, py, rankx, ranky);
+        compute_index_list(x, Nx/2, c.px, rankx);
+        compute_index_list(y, Ny/2, py, ranky);
+        for (int i=0; i<nx; i++){
+            index_list(Range(ny*i,(i+1)*ny-1),0,rank_id)=x(i);
+            index_list(Range(ny*i,(i+1)*ny-1),1,rank_id)=y(Range::all());
+        }
+    }
+
+
+}
+
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to return the magnitude of a displacement weighted by schedule_priority, which sets the radial order.
+*
+* \param    x, y, z are the indices of the displacement (y is 0 for 2D fields).
+*************************************************************************************************************************************
+*/
+double displacement_priority(SF_context& c, int x, int y, int z){
+    const vector<double>& w = c.schedule_priority;
+    double wx = w.empty() ? 1 : w[0];
+    double wy = w.size() == 3 ? w[1] : 1;
+    double wz = w.empty() ? 1 : w.back();
+    double lx = wx*x*c.dx, ly = wy*y*c.dy, lz = wz*z*c.dz;
+    return sqrt(lx*lx + ly*ly + lz*lz);
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to list the displacements computed by every processor at every step.
+*
+*           All the processors compute one displacement per step, since the results of a step are gathered together. In the default
+*           order, the displacements follow compute_index_list, with all the displacements along \$ z \$ of a pair \$ (x, y) \$ in a row
+*           for 3D fields. In the radial order, the displacements are sorted by displacement_priority and dealt to the processors in turn,
+*           so that when a step is completed, all the displacements of smaller weighted magnitude than those of the later steps are.
+*           The bounds of the later steps are kept in schedule_bound.
+*
+* \param    schedule stores the indices \$ (x, y, z) \$ of the displacement of each step and processor (y is 0 for 2D fields).
+*************************************************************************************************************************************
+*/
+void compute_schedule(SF_context& c, Array<int,3>& schedule){
+    int nx=c.Nx/2, ny=c.two_dimension_switch ? 1 : c.Ny/2, nz=c.Nz/2;
+    int steps=nx*ny*nz/c.P;
+    schedule.resize(steps,3,c.P);
+
+    if (c.schedule_order == "radial") {
+        vector<pair<double,int> > keys(nx*ny*nz);
+        for (int i=0; i<nx*ny*nz; i++) {
+            keys[i] = make_pair(displacement_priority(c, i/(ny*nz), i/nz%ny, i%nz), i);
+        }
+        sort(keys.begin(), keys.end());
+        for (int n=0; n<nx*ny*nz; n++) {
+            int i = keys[n].second;
+            schedule(n/c.P,0,n%c.P) = i/(ny*nz);
+            schedule(n/c.P,1,n%c.P) = i/nz%ny;
+            schedule(n/c.P,2,n%c.P) = i%nz;
+        }
+    }
+    else if (c.two_dimension_switch) {
+        Array<int,3> index_list;
+        compute_index_list(c, index_list, c.Nx, c.Nz);
+        schedule(Range::all(),0,Range::all()) = index_list(Range::all(),0,Range::all());
+        schedule(Range::all(),1,Range::all()) = 0;
+        schedule(Range::all(),2,Range::all()) = index_list(Range::all(),1,Range::all());
+    }
+    else {
+        Array<int,3> index_list;
+        compute_index_list(c, index_list, c.Nx, c.Ny);
+        for (int ix=0; ix<index_list.extent(0); ix++) {
+            for (int z=0; z<nz; z++) {
+                schedule(ix*nz+z,0,Range::all()) = index_list(ix,0,Range::all());
+                schedule(ix*nz+z,1,Range::all()) = index_list(ix,1,Range::all());
+                schedule(ix*nz+z,2,Range::all()) = z;
+            }
+        }
+    }
+
+    c.schedule_bound.assign(steps+1, numeric_limits<double>::infinity());
+    for (int st=steps-1; st>=0; st--) {
+        double bound = c.schedule_bound[st+1];
+        for (int r=0; r<c.P; r++) {
+            bound = min(bound, displacement_priority(c, schedule(st,0,r), schedule(st,1,r), schedule(st,2,r)));
+        }
+        c.schedule_bound[st] = bound;
+    }
+    c.last_flush = MPI_Wtime();
+    c.loop_start = MPI_Wtime();
+    c.steps_done = steps;
+    c.trace_batch = max(1, steps/256);
+    c.trace_first = c.first_step;
+    c.trace_begin = c.loop_start;
+    c.trace_wait = 0;
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to decide whether the displacement loop stops before the step st to stay within the walltime.
+*
+*           The loop also stops once the run has computed max_steps steps. The time per step is the mean time of the steps computed so far. The loop stops if the time elapsed since the start of the
+*           program, plus two steps and a reserve of 5% of the walltime for the reduction and the writes, exceeds the walltime. The
+*           decision is taken on rank 0 and broadcast, so that all the processors stop at the same step. Nothing is done without walltime and max_steps.
+*
+* \param    st is the step about to be computed.
+* \return   true if the loop stops, with the number of steps done in c.steps_done.
+*************************************************************************************************************************************
+*/
+bool out_of_time(SF_context& c, int st){
+    int steps = c.schedule_bound.size()-1;
+    if (c.max_steps > 0 and st-c.first_step >= c.max_steps) {
+        if (c.rank_mpi==0) {
+            cout<<"\nStopping before step "<<st+1<<" of "<<steps<<" after the "<<c.max_steps<<" steps of this run"<<endl;
+        }
+        c.steps_done = st;
+        trace_step(c, st-1, true);
+        return true;
+    }
+    if (c.walltime <= 0) {
+        return false;
+    }
+    int stop = 0;
+    if (c.rank_mpi==0) {
+        double now = MPI_Wtime();
+        double per_step = st > c.first_step ? (now-c.loop_start)/(st-c.first_step) : 0;
+        stop = now-program_start + 2*per_step + 0.05*c.walltime > c.walltime;
+        if (stop) {
+            cout<<"\nStopping before step "<<st+1<<" of "<<steps<<" to stay within the walltime of "<<c.walltime<<" s: "
+                <<c.walltime-(now-program_start)<<" s left, "<<per_step*(steps-st)<<" s of computation predicted"<<endl;
+        }
+    }
+    double begin = trace_clock();
+    MPI_Bcast(&stop, 1, MPI_INT, 0, c.comm);
+    trace_collective(c, "MPI_Bcast", begin);
+    if (stop) {
+        c.steps_done = st;
+        trace_step(c, st-1, true);
+    }
+    return stop;
+}
+
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to return the path of the resume file of an analysis, out/[name]_resume.yaml.
+*************************************************************************************************************************************
+*/
+string resume_path(SF_context& c){
+    return "out/"+(c.scalar_switch ? c.SF_Grid_scalar_name : c.SF_Grid_pll_name)+"_resume.yaml";
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to return the hash of the parameters of an analysis, which a resumed run must share with the stopped one.
+*************************************************************************************************************************************
+*/
+string parameters_hash(SF_context& c){
+    string parameters = analysis_parameters(c);
+    ostringstream hex;
+    hex<<std::hex<<setw(16)<<setfill('0')<<hash_bytes(parameters.data(), parameters.size(), 0);
+    return hex.str();
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to read the resume file of an analysis and to set the first step of the schedule.
+*
+*           The run is resumed only with resume_switch and if the resume file exists. The resumed run must have the same parameters,
+*           number of processors and schedule as the stopped one, since the steps are those of the schedule. The angular decomposition,
+*           the conditional and component structure functions and the sums are accumulated over all the displacements, and cannot be
+*           resumed.
+*************************************************************************************************************************************
+*/
+void read_resume(SF_context& c){
+    c.first_step = 0;
+    if (not c.resume_switch) {
+        return;
+    }
+    string path = resume_path(c);
+    ifstream file(path.c_str());
+    if (not file.is_open()) {
+        if (c.rank_mpi==0) {
+            cout<<"\nNo resume file "<<path<<"; computing all the displacements"<<endl;
+        }
+        return;
+    }
+
+    string error = "";
+    int steps_done = 0, steps = 0, processors = 0, processors_x = 0;
+    string order, parameters;
+    try {
+        YAML::Node doc;
+        YAML::Parser parser(file);
+        parser.GetNextDocument(doc);
+        doc["Steps_done"]>>steps_done;
+        doc["Steps"]>>steps;
+        doc["Processors"]>>processors;
+        doc["Processors_X"]>>processors_x;
+        doc["Order"]>>order;
+        doc["Parameters"]>>parameters;
+    }
+    catch(YAML::Exception& e) {
+        error = "The resume file "+path+" is unreadable: "+e.what();
+    }
+    int nsteps = (c.Nx/2)*(c.two_dimension_switch ? 1 : c.Ny/2)*(c.Nz/2)/c.P;
+    if (error == "" and (parameters != parameters_hash(c) or steps != nsteps or processors != c.P or processors_x != c.px
+                         or order != c.schedule_order or steps_done < 0 or steps_done > steps)) {
+        error = "The resume file "+path+" was written by a run with other parameters, processors or schedule";
+    }
+    if (error == "" and (not c.angular_bins.empty() or c.conditional_bins > 0 or not c.transverse_axis.empty() or c.write_sums)) {
+        error = "The angular decomposition, the conditional and component structure functions and the sums cannot be resumed";
+    }
+    if (error != "") {
+        if (c.rank_mpi==0) {
+            cerr<<"\n"<<error<<"\n\n";
+        }
+        fail_analysis();
+    }
+
+    c.first_step = steps_done;
+    if (c.rank_mpi==0) {
+        cout<<"\nResuming from step "<<steps_done+1<<" of "<<steps<<" ("<<path<<")"<<endl;
+    }
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to read the structure functions and their errors written by the stopped run into the arrays of a resumed run.
+*
+*           It is called on rank 0 once the arrays are allocated; the displacements of the remaining steps are overwritten.
+*************************************************************************************************************************************
+*/
+void load_resume(SF_context& c){
+    vector<string> labels = order_labels(c);
+    string names[] = {c.SF_Grid_scalar_name, c.SF_Grid_pll_name, c.SF_Grid_perp_name};
+    flush_writes();
+    if (c.two_dimension_switch) {
+        Array<double,3>* grids[] = {&c.SF_Grid2D_scalar, &c.SF_Grid2D_pll, &c.SF_Grid2D_perp,
+                                    &c.SF_Grid2D_scalar_err, &c.SF_Grid2D_pll_err, &c.SF_Grid2D_perp_err};
+        Array<double,2> temp(c.Nx/2, c.Nz/2);
+        for (int n=0; n<6; n++) {
+            string name = names[n%3]+(n<3 ? "" : "_err");
+            for (int q=0; q<grids[n]->extent(2) and grids[n]->size()>0; q++) {
+                read_2D(temp, "out/", name, name+labels[q]);
+                (*grids[n])(Range::all(),Range::all(),q) = temp;
+            }
+        }
+    }
+    else {
+        Array<double,4>* grids[] = {&c.SF_Grid_scalar, &c.SF_Grid_pll, &c.SF_Grid_perp,
+                                    &c.SF_Grid_scalar_err, &c.SF_Grid_pll_err, &c.SF_Grid_perp_err};
+        Array<double,3> temp(c.Nx/2, c.Ny/2, c.Nz/2);
+        for (int n=0; n<6; n++) {
+            string name = names[n%3]+(n<3 ? "" : "_err");
+            for (int q=0; q<grids[n]->extent(3) and grids[n]->size()>0; q++) {
+                read_3D(temp, "out/", name, name+labels[q]);
+                (*grids[n])(Range::all(),Range::all(),Range::all(),q) = temp;
+            }
+        }
+    }
+}
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to write the resume file of a run stopped by the walltime.
+*
+*           It is called on rank 0 after the results computed so far are handed over to the writer. The structure functions of the
+*           written files are complete for the displacements whose weighted magnitude is below "Resolved_l" (see flush_progress()), which
+*           is also stored as the attribute "resolved_l" of the files.
+*************************************************************************************************************************************
+*/
+void write_resume(SF_context& c){
+    int steps = c.schedule_bound.size()-1;
+    double resolved = c.schedule_bound[c.steps_done];
+    ofstream file(resume_path(c).c_str());
+    file<<"#Resume file of a run stopped by its walltime; rerun with Resume: true to compute the remaining displacements\n";
+    file<<"Steps_done: "<<c.steps_done<<"\n";
+    file<<"Steps: "<<steps<<"\n";
+    file<<"Processors: "<<c.P<<"\n";
+    file<<"Processors_X: "<<c.px<<"\n";
+    file<<"Order: "<<c.schedule_order<<"\n";
+    file<<"Parameters: \""<<parameters_hash(c)<<"\"\n";
+    file<<"Resolved_l: "<<setprecision(17)<<resolved<<"\n";
+    file.close();
+    cout<<"\nPartial results of "<<c.steps_done<<" of "<<steps<<" steps written; resume file "<<resume_path(c)<<endl;
+
+    vector<string> files;
+    if (c.scalar_switch) {
+        files.push_back(c.SF_Grid_scalar_name);
+    }
+    else {
+        files.push_back(c.SF_Grid_pll_name);
+        if (not c.longitudinal) {
+            files.push_back(c.SF_Grid_perp_name);
+        }
+    }
+    submit_write(c, [files, resolved]() {
+        for (size_t i=0; i<files.size(); i++) {
+            write_attribute("out/"+files[i]+".h5", "resolved_l", resolved);
+        }
+    });
+}
+
+
+
+/**
+*************************************************************************************************************************************
+*\brief     Function to write the structure functions computed so far, every flush_interval seconds.
+*
+*           It is called on all the processors after the step st of the schedule is gathered, and writes on rank 0 only. Copies of the
+*           structure functions (without the errors, components and other results) are handed over to the writer, so that a run that is
+*           stopped leaves the results of the completed steps. The files have the attribute "resolved_l": the structure functions of all
+*           the displacements of smaller weighted magnitude (see displacement_priority()) are complete.
+*
+* \param    st is the step of the schedule that has been gathered.
+*************************************************************************************************************************************
+*/
+void flush_progress(SF_context& c, int st){
+    if (c.flush_interval <= 0 or c.rank_mpi != 0 or st+2 >= int(c.schedule_bound.size())
+        or MPI_Wtime()-c.last_flush < c.flush_interval) {
+        return;
+    }
+    c.last_flush = MPI_Wtime();
+    double resolved = c.schedule_bound[st+1];
+    cout<<"\nWriting the structure functions of "<<st+1<<" of "<<c.schedule_bound.size()-1<<" steps, complete for |l| < "<<resolved<<endl;
+
+    mkdir("out",0777);
+    shared_ptr<Written_results> results(new Written_results);
+    results->labels = order_labels(c);
+    results->resolved_l = resolved;
+    if (c.two_dimension_switch) {
+        Array<double,3>* arrays[] = {&c.SF_Grid2D_scalar, &c.SF_Grid2D_pll, &c.SF_Grid2D_perp};
+        string names[] = {c.SF_Grid_scalar_name, c.SF_Grid_pll_name, c.SF_Grid_perp_name};
+        for (int n=0; n<3; n++) {
+            if (arrays[n]->size() > 0) {
+                Array<double,3> A(arrays[n]->shape());
+                A = *arrays[n];
+                A(0,0,Range::all()) = 0;
+                results->grids_2D.push_back(make_pair(A, names[n]));
+            }
+        }
+    }
+    else {
+        Array<double,4>* arrays[] = {&c.SF_Grid_scalar, &c.SF_Grid_pll, &c.SF_Grid_perp};
+        string names[] = {c.SF_Grid_scalar_name, c.SF_Grid_pll_name, c.SF_Grid_perp_name};
+        for (int n=0; n<3; n++) {
+            if (arrays[n]->size() > 0) {
+                Array<double,4> A(arrays[n]->shape());
+                A = *arrays[n];
+                A(0,0,0,Range::all()) = 0;
+                results->grids.push_back(make_pair(A, names[n]));
+            }
+        }
+    }
+    submit_write(c, bind(write_results, std::move(results)));
+}
+
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Test function to validate the calculation of structure functions of 3D velocity field data.
+ *
+ *          This function validates the calculation of the structure functions computed using 3D velocity field data. The velocity field is
+ *          generated as \f$ \mathbf{u} = x \hat{x} + y \hat{y} + z \hat{z} \f$. For such field, the velocity structure functions of order
+ *          \f$ q \f$ is given as \f$ S_q^u(l_x, l_y, l_z) = (\sqrt{l_x^2 + l_y^2 + l_z^2})^q \f$. In this function, the theoretical values
+ *          obtained from the aforementioned equation are compared with the computed values. If the percentage difference between the two values
+ *          is less than \f$1 \times 10^{-10} \f$, the test is passed.
+ *
+ ********************************************************************************************************************************************
+ */
+void VECTOR_TEST_CASE_3D(SF_context& c)
+{	
+    double epsilon=1e-10;
+    double err1 = 0, err2 = 0;
+    double max = 0;
+	Array<double,3> test1,test2;
+
+	if (c.longitudinal==true){
+		test1.resize(c.Nx/2,c.Ny/2,c.Nz/2);
+
+		for (int order=0 ; order<=c.q2-c.q1; order++){
+			string name=order_label(c, order);
+			read_3D(test1,"out/",c.SF_Grid_pll_name,c.SF_Grid_pll_name+name);
+			for (int i=0; i<test1.extent(0); i++){
+				double lx=c.dx*i;
+				for (int j=0; j<test1.extent(1); j++){
+					double ly=c.dy*j;
+					for (int k=0; k<test1.extent(2); k++){
+						double lz=c.dz*k;
+                        if (lx*lx + ly*ly + lz*lz > epsilon) {
+                            err1 = abs((test1(i,j,k)-pow(lx*lx+ly*ly+lz*lz,order_value(c, order)/2.))/pow(lx*lx+ly*ly+lz*lz,order_value(c, order)/2.));
+                        }
+                        else {
+                            err1 = abs(test1(i,j,k));
+                        }
+
+                        if (err1 > max) {
+                            max = err1;
+                        }
+
+
+					}
+				}
+			}
+		}
+
+	}
+	else{
+        cout<<"\nTESTING BOTH TRANSVERSE AND LONGITUDINAL\n";
+		test1.resize(c.Nx/2,c.Ny/2,c.Nz/2);
+		test2.resize(c.Nx/2,c.Ny/2,c.Nz/2);
+		for (int order=0 ; order<=c.q2-c.q1; order++){
+			string name=order_label(c, order);
+
+			read_3D(test1,"out/",c.SF_Grid_pll_name,c.SF_Grid_pll_name+name);
+			read_3D(test2,"out/",c.SF_Grid_perp_name,c.SF_Grid_perp_name+name);
+
+
+			for (int i=0; i<test1.extent(0); i++){
+				double lx=c.dx*i;
+				for (int j=0; j<test1.extent(1); j++){
+					double ly=c.dy*j;
+					for (int k=0; k<test1.extent(2); k++){
+						double lz=c.dz*k;
+						if (lx*lx + ly*ly + lz*lz > epsilon) {
+                            err1 = abs((test1(i,j,k)-pow(lx*lx+ly*ly+lz*lz,order_value(c, order)/2.))/pow(lx*lx+ly*ly+lz*lz,order_value(c, order)/2.));
+                        }
+                        else {
+                            err1 = abs(test1(i,j,k));
+                        }
+                        err2 = abs(test2(i,j,k));
+                        // Fractional orders amplify the round-off in the vanishing transverse increments.
+                        if (order_value(c, order) < 1) {
+                            err2 = pow(err2, 1./order_value(c, order));
+                        }
+                        if (err1 > max) {
+                            max = err1;
+                            
+                        }
+
+                        if (err2 > max) {
+                            max = err2;
+                    
+                        }
+
+					}
+				}
+			}
+
+		}
+	}
+
+
+	if (max > epsilon){
+		cout<<"\n\nVECTOR_3D: TEST_FAILED. The structure functions computed numerically using the code do NOT match with the analytically obtained values. \n\n";
+	}
+	else{
+		cout<<"\n\nVECTOR_3D: TEST_PASSED. The structure functions computed numerically using the code match with the analytically obtained values. \n\n";
+	}
+
+    cout<<"MAXIMUM PERCENTAGE ERROR: "<<max<<endl<<endl;
+
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Test function to validate the calculation of structure functions of 2D velocity field data.
+ *
+ *          This function validates the calculation of the structure functions computed using 2D velocity field data. The velocity field is
+ *          generated as \f$ \mathbf{u} = x \hat{x} + z \hat{z} \f$. For such field, the velocity structure functions of order
+ *          \f$ q \f$ is given as \f$ S_q^u(l_x, l_z) = (\sqrt{l_x^2 + l_z^2})^q \f$. In this function, the analytically obtained  values
+ *          obtained from the aforementioned equation are compared with the computed values. If the percentage difference between the two values is less
+            than \f$1 \times 10^{-10} \f$, the test is passed.
+ *
+ ********************************************************************************************************************************************
+ */
+void VECTOR_TEST_CASE_2D(SF_context& c)
+{	
+	double epsilon=1e-10;
+	double max=0;
+	double err1=0, err2 = 0;
+    Array<double,2> test1,test2;
+	int count=0;
+
+	if (c.longitudinal==true){
+		test1.resize(c.Nx/2,c.Nz/2);
+
+		for (int order=0 ; order<=c.q2-c.q1; order++){
+			string name=order_label(c, order);
+			read_2D(test1,"out/",c.SF_Grid_pll_name, c.SF_Grid_pll_name+name);
+			for (int i=0; i<test1.extent(0); i++){
+				double lx=c.dx*i;
+				for (int k=0; k<test1.extent(1); k++){
+					double lz=c.dz*k;
+                    if ((lx*lx + lz*lz)>epsilon) {
+                        err1 = abs((test1(i,k)-pow(lx*lx+lz*lz,order_value(c, order)/2.))/pow(lx*lx+lz*lz,order_value(c, order)/2.));
+                    }
+                    else {
+                        err1 =  abs(test1(i,k));
+                    }
+
+                    if (err1 > max) {
+                        max=err1;
+                    }
+
+				}
+			}
+		}
+
+	}
+	else{
+		test1.resize(c.Nx/2,c.Nz/2);
+		test2.resize(c.Nx/2,c.Nz/2);
+		for (int order=0 ; order<=c.q2-c.q1; order++){
+			string name=order_label(c, order);
+
+			read_2D(test1,"out/",c.SF_Grid_pll_name,c.SF_Grid_pll_name+name);
+			read_2D(test2,"out/",c.SF_Grid_perp_name,c.SF_Grid_perp_name+name);
+
+
+			for (int i=0; i<test1.extent(0); i++){
+				double lx=c.dx*i;
+
+				for (int k=0; k<test1.extent(1); k++){
+					double lz=c.dz*k;
+                    if ((lx*lx + lz*lz)>epsilon) {
+                        err1 = abs((test1(i,k)-pow(lx*lx+lz*lz,order_value(c, order)/2.))/pow(lx*lx+lz*lz,order_value(c, order)/2.));
+                    }
+                    else {
+                        err1 =  abs(test1(i,k));
+                    }
+
+                    err2 = abs(test2(i,k));
+                    if (order_value(c, order) < 1) {
+                        err2 = pow(err2, 1./order_value(c, order));
+                    }
+
+                    if (err1 > max) {
+                        max = err1;
+                    }
+                    if (err2 > max) {
+                        max = err2;
+                    }
+
+				}
+			}
+		}
+	}
+
+
+	if (max > epsilon){
+		cout<<"\n\nVECTOR_2D: TEST_FAILED. The structure functions computed numerically using the code do NOT match with the analytically obtained values. \n\n";
+	}
+	else{
+		cout<<"\n\nVECTOR_2D: TEST_PASSED. The structure functions computed numerically using the code match with the analytically obtained values. \n\n";
+	}
+
+    cout<<"MAXIMUM ERROR: "<<max<<endl<<endl;
+
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Test function to validate the calculation of structure functions of 2D scalar field data.
+ *
+ *          This function validates the calculation of the structure functions computed using 2D scalar field data. The scalar field is
+ *          generated as \f$ \theta = x + z \f$. For such field, the structure functions of order
+ *          \f$ q \f$ is given as \f$ S_q^u(l_x, l_z) = (l_x^2 + l_z^2)^q \f$. In this function, the theoretical values
+ *          obtained from the aforementioned equation are compared with the computed values. If the percentage difference between the two values is less
+ *          than \f$1 \times 10^{-10} \f$, the test is passed.
+ *
+ ********************************************************************************************************************************************
+ */
+void SCALAR_TEST_CASE_2D(SF_context& c)
+{	double epsilon=1e-10;
+	double max=0;
+	double err=0;
+	Array<double,2> test1;
+	int count=0;
+	test1.resize(c.Nx/2,c.Nz/2);
+	for (int order=0 ; order<=c.q2-c.q1; order++){
+		string name=order_label(c, order);
+
+		read_2D(test1,"out/",c.SF_Grid_scalar_name, c.SF_Grid_scalar_name+name);
+
+
+
+		for (int i=0; i<test1.extent(0); i++){
+			double lx=c.dx*i;
+
+			for (int k=0; k<test1.extent(1); k++){
+				double lz=c.dz*k;
+				if (abs(lx+lz)>epsilon){
+					err=abs((test1(i,k)-pow(lx+lz,order_value(c, order)))/pow(lx+lz,order_value(c, order)));
+
+				}
+				else{
+					err=abs(test1(i,k));
+
+				}
+
+                if (err>max) {
+                    max = err;
+                }
+                
+
+			}
+            
+		}
+	}
+	if (max > epsilon){
+		cout<<"\n\nSCALAR_2D: TEST_FAILED. The structure functions computed numerically using the code do NOT match with the analytically obtained values. \n\n";
+	}
+	else{
+		cout<<"\n\nSCALAR_2D: TEST_PASSED. The structure functions computed numerically using the code match with the analytically obtained values. \n\n";
+	}
+
+	cout<<"MAXIMUM ERROR: "<<max<<endl<<endl;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Test function to validate the calculation of structure functions of 3D scalar field data.
+ *
+ *          This function validates the calculation of the structure functions computed using 3D scalar field data. The scalar field is
+ *          generated as \f$ \theta = x + y + z \f$. For such field, the structure functions of order
+ *          \f$ q \f$ is given as \f$ S_q^u(l_x, l_y, l_z) = (l_x^2 + l_y^2 + l_z^2)^q \f$. In this function, the theoretical values
+ *          obtained from the aforementioned equation are compared with the computed values. If the percentage difference between the two values is less
+ *          than \f$1 \times 10^{-10} \f$, the test is passed.
+ *
+ ********************************************************************************************************************************************
+ */
+void SCALAR_TEST_CASE_3D(SF_context& c){
+
+	double epsilon=1e-10;
+	double max=0;
+	double err=0;
+    Array<double,3> test1;
+	int count=0;
+	test1.resize(c.Nx/2,c.Ny/2,c.Nz/2);
+	for (int order=0 ; order<=c.q2-c.q1; order++){
+		string name=order_label(c, order);
+		read_3D(test1,"out/",c.SF_Grid_scalar_name, c.SF_Grid_scalar_name+name);
+		for (int i=0; i<test1.extent(0); i++){
+			double lx=c.dx*i;
+			for (int j=0; j<test1.extent(1); j++){
+				double ly=c.dy*j;
+				for (int k=0; k<test1.extent(2); k++){
+					double lz=c.dz*k;
+					if (abs(lx+ly+lz)>epsilon){
+						err=abs((test1(i,j,k)-pow(lx+ly+lz,order_value(c, order)))/pow(lx+ly+lz,order_value(c, order)));
+
+					}
+					else{
+						err=abs(test1(i,j,k));
+
+					}
+
+                    if (err>max) {
+                        max=err;
+                    }
+				}
+			}
+		}
+	}
+	if (max > epsilon){
+		cout<<"\n\nSCALAR_3D: TEST_FAILED. The structure functions computed numerically using the code do NOT match with the analytically obtained values. \n\n";
+	}
+	else{
+		cout<<"\n\nSCALAR_3D: TEST_PASSED. The structure functions computed numerically using the code match with the analytically obtained values. \n\n";
+
+	}
+
+    cout<<"MAXIMUM ERROR: "<<max<<endl<<endl;
+
+}
+
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to convert an integer type value to string.
+ *
+ *
+ * \param   number is the integer value of to be converted.
+ *
+ * \return  The value as a string.
+ *
+ ********************************************************************************************************************************************
+ */
+string int_to_str(int number)
+{
+    stringstream ss;
+
+    ss << number;
+
+    return ss.str();
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to compute the time elapsed.
+ *
+ *          This function computes the time elapsed in seconds between a start point and an end point during the execution of the
+ *          program
+ *
+ * \param start_t is the time corresponding to the start point
+ * \param end_t is the time corresponding to the end point
+ * \param elapsed stores the time elapsed in seconds
+ ********************************************************************************************************************************************
+ */
+void compute_time_elapsed(timeval start_t, timeval end_t, double& elapsed){
+    long elapsed_2 = (end_t.tv_sec-start_t.tv_sec)*1000000u + end_t.tv_usec-start_t.tv_usec;
+    elapsed=elapsed_2/1.0e6;
+}
+
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write the structure functions as function of \f$ (l_x,l_y,l_z) \f$ as a 3D hdf5 file.
+ *
+ *          This function reads the structure functions as a 4D array of dimensions \f$ (l_x \times l_y \times l_z \times p)\f$, where \f$ p \f$ is the order of the number of orders of
+ *          structure function.
+ *          The structure functions of different orders are then stored as separate 3D hdf5 files.
+ *
+ * \param   A is the 4D array representing the structure functions.
+ * \param   file is the name of the hdf5 file and the dataset in which the structure functions are stored.
+ * \param   labels are the labels of the orders of the structure functions stored in A, appended to the names of the datasets.
+ ********************************************************************************************************************************************
+ */
+void write_4D(Array<double,4> A, string file, vector<string> labels) {
+  int nx=A(Range::all(),0,0,0).size();
+  int ny=A(0,Range::all(),0,0).size();
+  int nz=A(0,0,Range::all(),0).size();
+  lock_guard<mutex> h5_guard(h5_mutex);
+  h5::File f("out/"+file+".h5", "w");
+  Array<double,3> temp(nx,ny,nz);
+  for (size_t q=0; q<labels.size(); q++){
+      cout<<"Writing "<<labels[q]<<" order to file.\n";
+      h5::Dataset ds = f.create_dataset(file+labels[q], h5::shape(nx,ny,nz), "double");
+      temp(Range::all(),Range::all(),Range::all())=A(Range::all(),Range::all(),Range::all(),q);
+      ds << temp.data();
+  }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write the structure functions as function of lx,lz as a 2D hdf5 file.
+ *
+ *          This function reads the structure functions as a 3D array of dimensions \f$ (l_x \times l_z \times p) \f$, where \f$ p \f$ is the number of orders of the structure function.
+ *          The structure functions of different orders are then stored as separate 2D hdf5 files.
+ *
+ * \param   A is the 3D array representing the structure functions.
+ * \param   file is the name of the hdf5 file and the dataset in which the structure functions are stored.
+ * \param   labels are the labels of the orders of the structure functions stored in A, appended to the names of the datasets.
+ ********************************************************************************************************************************************
+ */
+void write_3D(Array<double,3> A, string file, vector<string> labels) {
+  int nx=A(Range::all(),0,0).size();
+  int nz=A(0,Range::all(),0).size();
+  lock_guard<mutex> h5_guard(h5_mutex);
+  h5::File f("out/"+file+".h5", "w");
+  Array<double,2> temp(nx,nz);
+  for (size_t q=0; q<labels.size(); q++) {
+      cout<<"Writing "<<labels[q]<<" order to file.\n";
+      h5::Dataset ds = f.create_dataset(file+labels[q], h5::shape(nx,nz), "double");
+      temp(Range::all(),Range::all())=A(Range::all(),Range::all(),q);
+      ds << temp.data();
+  }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to set a numerical attribute of the root group of an hdf5 file.
+ *
+ * \param   file is the path of the hdf5 file.
+ * \param   name is the name of the attribute.
+ * \param   value is the value of the attribute.
+ ********************************************************************************************************************************************
+ */
+void write_attribute(string file, string name, double value) {
+  lock_guard<mutex> h5_guard(h5_mutex);
+  hid_t f = H5Fopen(file.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+  if (f < 0) {
+      return;
+  }
+  if (H5Aexists(f, name.c_str()) > 0) {
+      H5Adelete(f, name.c_str());
+  }
+  hid_t space = H5Screate(H5S_SCALAR);
+  hid_t attr = H5Acreate2(f, name.c_str(), H5T_NATIVE_DOUBLE, space, H5P_DEFAULT, H5P_DEFAULT);
+  H5Awrite(attr, H5T_NATIVE_DOUBLE, &value);
+  H5Aclose(attr);
+  H5Sclose(space);
+  H5Fclose(f);
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write the sums of the structure functions as function of \f$ (l_x,l_y,l_z) \f$ and the numbers of pairs of points.
+ *
+ *          The sum of each order is the structure function times the number of pairs of points of the displacement, stored as for
+ *          write_4D. The numbers of pairs are stored in the dataset "count" of the same file; the files of several runs are merged by
+ *          merge_sums().
+ *
+ * \param   A is the 4D array representing the structure functions.
+ * \param   N is the 4D array of the numbers of pairs of points, with a last dimension of 1.
+ * \param   file is the name of the hdf5 file and the dataset in which the sums are stored.
+ * \param   labels are the labels of the orders of the structure functions stored in A, appended to the names of the datasets.
+ ********************************************************************************************************************************************
+ */
+void write_sums_4D(Array<double,4> A, Array<double,4> N, string file, vector<string> labels) {
+  int nx=A(Range::all(),0,0,0).size();
+  int ny=A(0,Range::all(),0,0).size();
+  int nz=A(0,0,Range::all(),0).size();
+  lock_guard<mutex> h5_guard(h5_mutex);
+  h5::File f("out/"+file+".h5", "w");
+  Array<double,3> temp(nx,ny,nz);
+  cout<<"Writing the sums to file.\n";
+  for (size_t q=0; q<labels.size(); q++){
+      h5::Dataset ds = f.create_dataset(file+labels[q], h5::shape(nx,ny,nz), "double");
+      temp(Range::all(),Range::all(),Range::all())=A(Range::all(),Range::all(),Range::all(),q)*N(Range::all(),Range::all(),Range::all(),0);
+      ds << temp.data();
+  }
+  h5::Dataset count = f.create_dataset("count", h5::shape(nx,ny,nz), "double");
+  temp(Range::all(),Range::all(),Range::all())=N(Range::all(),Range::all(),Range::all(),0);
+  count << temp.data();
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write the sums of the structure functions as function of lx,lz and the numbers of pairs of points.
+ *
+ *          This is the 2D counterpart of write_sums_4D().
+ *
+ * \param   A is the 3D array representing the structure functions.
+ * \param   N is the 3D array of the numbers of pairs of points, with a last dimension of 1.
+ * \param   file is the name of the hdf5 file and the dataset in which the sums are stored.
+ * \param   labels are the labels of the orders of the structure functions stored in A, appended to the names of the datasets.
+ ********************************************************************************************************************************************
+ */
+void write_sums_3D(Array<double,3> A, Array<double,3> N, string file, vector<string> labels) {
+  int nx=A(Range::all(),0,0).size();
+  int nz=A(0,Range::all(),0).size();
+  lock_guard<mutex> h5_guard(h5_mutex);
+  h5::File f("out/"+file+".h5", "w");
+  Array<double,2> temp(nx,nz);
+  cout<<"Writing the sums to file.\n";
+  for (size_t q=0; q<labels.size(); q++) {
+      h5::Dataset ds = f.create_dataset(file+labels[q], h5::shape(nx,nz), "double");
+      temp(Range::all(),Range::all())=A(Range::all(),Range::all(),q)*N(Range::all(),Range::all(),0);
       ds << temp.data();
-      q++;
   }
+  h5::Dataset count = f.create_dataset("count", h5::shape(nx,nz), "double");
+  temp(Range::all(),Range::all())=N(Range::all(),Range::all(),0);
+  count << temp.data();
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Callback of H5Literate collecting the names of the datasets of a file.
+ ********************************************************************************************************************************************
+ */
+herr_t collect_dataset_name(hid_t group, const char* name, const H5L_info_t*, void* names)
+{
+    H5O_info_t info;
+    if (H5Oget_info_by_name(group, name, &info, H5P_DEFAULT) >= 0 and info.type == H5O_TYPE_DATASET) {
+        static_cast<vector<string>*>(names)->push_back(name);
+    }
+    return 0;
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to merge the sums files written by several runs (with Sums in the partial section of para.yaml) into structure functions.
+ *
+ *          The runs may cover different snapshots, or disjoint ranges of displacements of the same snapshot (X_range). For each dataset
+ *          of sums, the sums and the numbers of pairs of points of the files are added, and the structure function is the total sum
+ *          divided by the total number of pairs (zero for a displacement without pairs). The datasets are processed in slabs along their
+ *          first dimension, so that the files are never loaded whole. The merged datasets are named as the ones written by a single run,
+ *          with the total numbers of pairs in the dataset "count". The merge runs on the first process only.
+ *
+ * \param   nfiles is the number of file names.
+ * \param   files are the name of the output file followed by the names of the sums files to be merged.
+ ********************************************************************************************************************************************
+ */
+void merge_sums(int nfiles, char* files[])
+{
+    string error = "";
+    if (nfiles < 2) {
+        error = "--merge needs the name of the output file followed by the sums files to be merged";
+    }
+
+    if (rank_mpi==0 and error == "") {
+        lock_guard<mutex> h5_guard(h5_mutex);
+        vector<hid_t> in;
+        for (int i=1; i<nfiles and error == ""; i++) {
+            hid_t file = access(files[i], R_OK) == 0 ? H5Fopen(files[i], H5F_ACC_RDONLY, H5P_DEFAULT) : -1;
+            if (file < 0) {
+                error = "Unable to open "+string(files[i])+" as an hdf5 file";
+            }
+            else {
+                in.push_back(file);
+            }
+        }
+
+        //The datasets of the first file, with "count" first, have to be in all the files with the same shape
+        vector<string> names;
+        vector<hsize_t> dims;
+        if (error == "") {
+            H5Literate(in[0], H5_INDEX_NAME, H5_ITER_NATIVE, NULL, collect_dataset_name, &names);
+            vector<string>::iterator count = find(names.begin(), names.end(), "count");
+            if (count == names.end()) {
+                error = string(files[1])+" has no dataset count; it was not written with Sums";
+            }
+            else {
+                names.erase(count);
+                names.insert(names.begin(), "count");
+            }
+        }
+        for (size_t d=0; d<names.size() and error == ""; d++) {
+            for (size_t i=0; i<in.size() and error == ""; i++) {
+                if (H5Lexists(in[i], names[d].c_str(), H5P_DEFAULT) <= 0) {
+                    error = "Dataset "+names[d]+" not found in "+files[i+1];
+                    break;
+                }
+                hid_t dset = H5Dopen2(in[i], names[d].c_str(), H5P_DEFAULT);
+                hid_t space = H5Dget_space(dset);
+                vector<hsize_t> shape(H5Sget_simple_extent_ndims(space));
+                H5Sget_simple_extent_dims(space, shape.data(), NULL);
+                H5Sclose(space);
+                H5Dclose(dset);
+                if (dims.empty()) {
+                    dims = shape;
+                }
+                else if (shape != dims) {
+                    error = "Dataset "+names[d]+" in "+files[i+1]+" does not have the shape of the datasets of "+files[1];
+                }
+            }
+        }
+
+        hid_t out = -1;
+        if (error == "") {
+            out = H5Fcreate(files[0], H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+            if (out < 0) {
+                error = "Unable to create "+string(files[0]);
+            }
+        }
+
+        if (error == "") {
+            cout<<"Merging "<<in.size()<<" sums files into "<<files[0]<<"\n";
+            hsize_t row = 1;
+            for (size_t k=1; k<dims.size(); k++) {
+                row *= dims[k];
+            }
+            hsize_t rows = max(hsize_t(1), input_slab_size/row);
+            vector<hid_t> merged;
+            hid_t space = H5Screate_simple(dims.size(), dims.data(), NULL);
+            for (size_t d=0; d<names.size(); d++) {
+                string name = names[d];
+                size_t pos = name.find("_sums");
+                if (pos != string::npos) {
+                    name.erase(pos, 5);
+                }
+                merged.push_back(H5Dcreate2(out, name.c_str(), H5T_NATIVE_DOUBLE, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT));
+            }
+            H5Sclose(space);
+
+            vector<double> N, total, buffer;
+            for (hsize_t first=0; first<dims[0]; first+=rows) {
+                vector<hsize_t> offset(dims.size(), 0), count(dims);
+                offset[0] = first;
+                count[0] = min(rows, dims[0]-first);
+                hsize_t n = count[0]*row;
+                hid_t memspace = H5Screate_simple(count.size(), count.data(), NULL);
+                buffer.resize(n);
+                for (size_t d=0; d<names.size(); d++) {
+                    total.assign(n, 0);
+                    for (size_t i=0; i<in.size(); i++) {
+                        hid_t dset = H5Dopen2(in[i], names[d].c_str(), H5P_DEFAULT);
+                        hid_t filespace = H5Dget_space(dset);
+                        H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset.data(), NULL, count.data(), NULL);
+                        H5Dread(dset, H5T_NATIVE_DOUBLE, memspace, filespace, H5P_DEFAULT, buffer.data());
+                        H5Sclose(filespace);
+                        H5Dclose(dset);
+                        #pragma omp parallel for
+                        for (hsize_t k=0; k<n; k++) {
+                            total[k] += buffer[k];
+                        }
+                    }
+                    if (d == 0) {
+                        N = total;
+                    }
+                    else {
+                        #pragma omp parallel for
+                        for (hsize_t k=0; k<n; k++) {
+                            total[k] = N[k] > 0 ? total[k]/N[k] : 0;
+                        }
+                    }
+                    hid_t filespace = H5Dget_space(merged[d]);
+                    H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset.data(), NULL, count.data(), NULL);
+                    H5Dwrite(merged[d], H5T_NATIVE_DOUBLE, memspace, filespace, H5P_DEFAULT, total.data());
+                    H5Sclose(filespace);
+                }
+                H5Sclose(memspace);
+            }
+            for (size_t d=0; d<merged.size(); d++) {
+                H5Dclose(merged[d]);
+            }
+            H5Fclose(out);
+            cout<<"Merged "<<names.size()-1<<" structure functions\n";
+        }
+        for (size_t i=0; i<in.size(); i++) {
+            H5Fclose(in[i]);
+        }
+    }
+
+    int failed = error != "";
+    MPI_Bcast(&failed, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (failed) {
+        if (rank_mpi==0) {
+            cerr<<"\n"<<error<<"\n\n";
+        }
+        exit_on_error();
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write the scaling summary of the structure functions stored in a file to the file file_summary.h5.
+ *
+ * \param   S is the scaling summary.
+ * \param   file is the name of the hdf5 file of the structure functions.
+ ********************************************************************************************************************************************
+ */
+void write_summary(Scaling_summary S, string file) {
+  int nb=S.S.extent(0);
+  int nq=S.S.extent(1);
+  lock_guard<mutex> h5_guard(h5_mutex);
+  cout<<"Writing the scaling summary to file.\n";
+  h5::File f("out/"+file+"_summary.h5", "w");
+  h5::Dataset r = f.create_dataset("r", h5::shape(nb), "double");
+  r << S.r.data();
+  h5::Dataset count = f.create_dataset("count", h5::shape(nb), "double");
+  count << S.count.data();
+  h5::Dataset SF = f.create_dataset("S", h5::shape(nb,nq), "double");
+  SF << S.S.data();
+  h5::Dataset slope = f.create_dataset("local_slope", h5::shape(nb,nq), "double");
+  slope << S.slope.data();
+  h5::Dataset range = f.create_dataset("fit_range", h5::shape(2), "double");
+  range << S.fit_range.data();
+  h5::Dataset zeta = f.create_dataset("zeta", h5::shape(nq), "double");
+  zeta << S.zeta.data();
+  if (S.ess.size() > 0) {
+      h5::Dataset ess = f.create_dataset("ess", h5::shape(nq), "double");
+      ess << S.ess.data();
+  }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write the angular decomposition of the structure functions stored in a file to the file file_angular.h5.
+ *
+ * \param   A is the angular decomposition, reduced to means by normalize_angular().
+ * \param   file is the name of the hdf5 file of the structure functions.
+ ********************************************************************************************************************************************
+ */
+void write_angular(Angular_moments A, string file) {
+  int nr=A.sector.extent(0), nt=A.sector.extent(1), np=A.sector.extent(2), nq=A.sector.extent(3);
+  lock_guard<mutex> h5_guard(h5_mutex);
+  cout<<"Writing the angular decomposition to file.\n";
+  h5::File f("out/"+file+"_angular.h5", "w");
+  h5::Dataset r = f.create_dataset("r_edges", h5::shape(nr+1), "double");
+  r << A.r_edges.data();
+  h5::Dataset sector = f.create_dataset("sector", h5::shape(nr,nt,np,nq), "double");
+  sector << A.sector.data();
+  h5::Dataset count = f.create_dataset("sector_count", h5::shape(nr,nt,np), "double");
+  count << A.sector_count.data();
+  if (A.harmonic.size() > 0) {
+      h5::Dataset harmonic = f.create_dataset("harmonic", h5::shape(nr,A.harmonic.extent(1),nq), "double");
+      harmonic << A.harmonic.data();
+      h5::Dataset shell = f.create_dataset("shell_count", h5::shape(nr), "double");
+      shell << A.shell_count.data();
+  }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write the edges of the bins of the conditioning field and the fraction of the points in each bin as an hdf5 file.
+ *
+ * \param edges stores the edges of the bins
+ * \param fraction stores the fraction of the points of the field in each bin
+ * \param file is the name of the file
+ ********************************************************************************************************************************************
+ */
+void write_conditional_bins(vector<double> edges, vector<double> fraction, string file) {
+  lock_guard<mutex> h5_guard(h5_mutex);
+  cout<<"Writing the bins of the conditioning field to file.\n";
+  h5::File f("out/"+file+".h5", "w");
+  h5::Dataset e = f.create_dataset("edges", h5::shape(edges.size()), "double");
+  e << edges.data();
+  h5::Dataset p = f.create_dataset("fraction", h5::shape(fraction.size()), "double");
+  p << fraction.data();
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write the joint PDFs of the increments at the selected displacements as an hdf5 file.
+ *
+ * \param J stores the joint PDFs
+ * \param file is the name of the file
+ ********************************************************************************************************************************************
+ */
+void write_joint_pdfs(Joint_pdfs J, string file) {
+  int ns=J.pll_perp.extent(0), n1=J.pll_perp.extent(1);
+  lock_guard<mutex> h5_guard(h5_mutex);
+  cout<<"Writing the joint PDFs to file.\n";
+  h5::File f("out/"+file+".h5", "w");
+  h5::Dataset sep = f.create_dataset("separations", h5::shape(ns,3), "double");
+  sep << J.separations.data();
+  h5::Dataset count = f.create_dataset("count", h5::shape(ns), "double");
+  count << J.count.data();
+  h5::Dataset pll = f.create_dataset("edges_pll", h5::shape(ns,n1+1), "double");
+  pll << J.edges_pll.data();
+  if (J.pll_perp.size() > 0) {
+      h5::Dataset edges = f.create_dataset("edges_perp", h5::shape(ns,J.edges_perp.extent(1)), "double");
+      edges << J.edges_perp.data();
+      h5::Dataset pdf = f.create_dataset("pll_perp", h5::shape(ns,n1,J.pll_perp.extent(2)), "double");
+      pdf << J.pll_perp.data();
+  }
+  if (J.pll_scalar.size() > 0) {
+      h5::Dataset edges = f.create_dataset("edges_scalar", h5::shape(ns,J.edges_scalar.extent(1)), "double");
+      edges << J.edges_scalar.data();
+      h5::Dataset pdf = f.create_dataset("pll_scalar", h5::shape(ns,n1,J.pll_scalar.extent(2)), "double");
+      pdf << J.pll_scalar.data();
+  }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   State of the background thread writing the structure functions to the disk.
+ ********************************************************************************************************************************************
+ */
+struct Async_writer {
+    thread* worker = NULL;
+    mutex lock;
+    condition_variable changed;
+    deque<function<void()> > jobs;
+    int pending = 0;
+    bool stopping = false;
+};
+
+Async_writer writer;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function run by the background writer; it writes the handed over results in order until it is stopped.
+ ********************************************************************************************************************************************
+ */
+void writer_loop() {
+    trace_name_thread("writer");
+    unique_lock<mutex> guard(writer.lock);
+    while (true) {
+        writer.changed.wait(guard, [] { return writer.stopping or not writer.jobs.empty(); });
+        if (writer.jobs.empty()) {
+            return;
+        }
+        function<void()> job = std::move(writer.jobs.front());
+        writer.jobs.pop_front();
+        guard.unlock();
+        {
+            Trace_scope trace("write", "io");
+            job();
+        }
+        //Release the result arrays before the next result is admitted
+        job = nullptr;
+        guard.lock();
+        writer.pending--;
+        writer.changed.notify_all();
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to hand over a write to the background writer.
+ *
+ *          The call blocks while the write_queue results of the analysis are pending. If it is 0, the write is done immediately by the
+ *          calling thread.
+ *
+ * \param   c is the context of the analysis whose result is written.
+ * \param   job writes a result to the disk; it must hold the only references to the arrays it writes (see Written_results), and is moved
+ *          to the writer so that no copy of it is left to the calling thread.
+ ********************************************************************************************************************************************
+ */
+void submit_write(SF_context& c, function<void()> job) {
+    if (c.write_queue == 0) {
+        Trace_scope trace("write", "io");
+        job();
+        return;
+    }
+    unique_lock<mutex> guard(writer.lock);
+    if (writer.worker == NULL) {
+        writer.stopping = false;
+        writer.worker = new thread(writer_loop);
+    }
+    int limit = c.write_queue;
+    writer.changed.wait(guard, [limit] { return writer.pending < limit; });
+    writer.jobs.push_back(std::move(job));
+    writer.pending++;
+    writer.changed.notify_all();
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to wait until all the results handed over to the background writer are written.
+ ********************************************************************************************************************************************
+ */
+void flush_writes() {
+    unique_lock<mutex> guard(writer.lock);
+    writer.changed.wait(guard, [] { return writer.pending == 0; });
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write the pending results and stop the background writer.
+ ********************************************************************************************************************************************
+ */
+void stop_writer() {
+    {
+        lock_guard<mutex> guard(writer.lock);
+        if (writer.worker == NULL) {
+            return;
+        }
+        writer.stopping = true;
+        writer.changed.notify_all();
+    }
+    writer.worker->join();
+    delete writer.worker;
+    writer.worker = NULL;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to end the program after an error reported by the caller.
+ *
+ *          The results already handed over to the background writer are written first, so that hdf5 is not closed in the middle of a write
+ *          and the outputs of the analyses completed before the error stay valid. Once the processors of a job manifest are split into
+ *          groups, the whole job is aborted.
+ ********************************************************************************************************************************************
+ */
+void exit_on_error() {
+    stop_writer();
+    //The other groups of processors of a job manifest do not know about the error
+    if (comm_sf != MPI_COMM_WORLD) {
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    h5::finalize();
+    MPI_Finalize();
+    exit(1);
+}
+
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Events of the trace of this processor, the names of its threads, and the lock guarding them against the writer thread.
+ ********************************************************************************************************************************************
+ */
+vector<Trace_event> trace_events;
+vector<string> trace_threads;
+mutex trace_lock;
+double trace_origin = 0;
+thread_local int trace_thread = -1;
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to start the trace, if a trace file is given: the processors synchronize so that their timestamps share an origin.
+ ********************************************************************************************************************************************
+ */
+void trace_init() {
+    trace_enabled = not trace_file.empty();
+    if (not trace_enabled) {
+        return;
+    }
+    trace_events.reserve(4096);
+    trace_name_thread("main");
+    MPI_Barrier(MPI_COMM_WORLD);
+    trace_origin = MPI_Wtime();
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to give a name to the calling thread in the trace.
+ ********************************************************************************************************************************************
+ */
+void trace_name_thread(string name) {
+    if (not trace_enabled) {
+        return;
+    }
+    lock_guard<mutex> guard(trace_lock);
+    trace_thread = trace_threads.size();
+    trace_threads.push_back(name);
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to record an event of the calling thread; the arguments first, last and wait are left out of the trace if negative.
+ ********************************************************************************************************************************************
+ */
+void trace_event(const char* name, const char* category, double begin, double end, long first, long last, double wait) {
+    lock_guard<mutex> guard(trace_lock);
+    Trace_event event = {name, category, begin, end, max(trace_thread, 0), first, last, wait};
+    trace_events.push_back(event);
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function returning the time used to timestamp the events, or 0 without trace so that disabled tracing costs no clock read.
+ ********************************************************************************************************************************************
+ */
+double trace_clock() {
+    return trace_enabled ? MPI_Wtime() : 0;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to end a collective started at begin.
+ *
+ *          Its duration is added to the waiting time of the current batch of steps; it is also recorded as an event of its own if it lasts
+ *          at least trace_threshold, so that the trace stays small while the slow collectives, which show the load imbalance, stand out.
+ ********************************************************************************************************************************************
+ */
+void trace_collective(SF_context& c, const char* name, double begin) {
+    if (not trace_enabled) {
+        return;
+    }
+    double end = MPI_Wtime();
+    c.trace_wait += end-begin;
+    if (end-begin >= trace_threshold) {
+        trace_event(name, "mpi", begin, end, -1, -1, -1);
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to close the batch of steps containing the step st, if it is full or if last is true.
+ *
+ *          A batch is recorded with its first and last steps and the time its collectives took; there are at most about 256 batches per
+ *          displacement loop.
+ ********************************************************************************************************************************************
+ */
+void trace_step(SF_context& c, int st, bool last) {
+    if (not trace_enabled or st < c.trace_first) {
+        return;
+    }
+    if (not last and st+1-c.trace_first < c.trace_batch and st+1 < (int)c.schedule_bound.size()-1) {
+        return;
+    }
+    double end = MPI_Wtime();
+    trace_event("steps", "compute", c.trace_begin, end, c.trace_first, st, c.trace_wait);
+    c.trace_first = st+1;
+    c.trace_begin = end;
+    c.trace_wait = 0;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to escape a string for a JSON string literal: quotes, backslashes and control characters.
+ ********************************************************************************************************************************************
+ */
+string json_escape(string s) {
+    ostringstream out;
+    for (size_t i=0; i<s.size(); i++) {
+        unsigned char ch = s[i];
+        if (ch == '"' or ch == '\\') {
+            out<<'\\'<<ch;
+        }
+        else if (ch < 0x20) {
+            out<<"\\u"<<hex<<setw(4)<<setfill('0')<<int(ch)<<dec;
+        }
+        else {
+            out<<ch;
+        }
+    }
+    return out.str();
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to write the trace of all the processors to trace_file, in the Chrome trace event format.
+ *
+ *          Each processor appears as a process named by its rank, with a thread for the computation, one for the background writer and one
+ *          for each analysis run concurrently, named after the analysis. The file can be opened with chrome://tracing or Perfetto.
+ ********************************************************************************************************************************************
+ */
+void write_trace() {
+    if (not trace_enabled) {
+        return;
+    }
+    //The ranks of the job manifest groups are not unique, the world ranks are
+    int rank, P;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &P);
+
+    ostringstream out;
+    out<<setprecision(15);
+    out<<"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":"<<rank<<",\"args\":{\"name\":\"rank "<<rank<<"\"}},\n";
+    out<<"{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":"<<rank<<",\"args\":{\"sort_index\":"<<rank<<"}},\n";
+    for (size_t t=0; t<trace_threads.size(); t++) {
+        out<<"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":"<<rank<<",\"tid\":"<<t
+           <<",\"args\":{\"name\":\""<<json_escape(trace_threads[t])<<"\"}},\n";
+    }
+    for (size_t i=0; i<trace_events.size(); i++) {
+        Trace_event& e = trace_events[i];
+        out<<"{\"name\":\""<<e.name<<"\",\"cat\":\""<<e.category<<"\",\"ph\":\"X\",\"pid\":"<<rank<<",\"tid\":"<<e.thread
+           <<",\"ts\":"<<(e.begin-trace_origin)*1e6<<",\"dur\":"<<(e.end-e.begin)*1e6;
+        if (e.first >= 0) {
+            out<<",\"args\":{\"first\":"<<e.first<<",\"last\":"<<e.last<<",\"collectives_s\":"<<e.wait<<"}";
+        }
+        out<<"},\n";
+    }
+    string local = out.str();
+
+    int length = local.size();
+    vector<int> lengths(P), offsets(P, 0);
+    MPI_Gather(&length, 1, MPI_INT, lengths.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    string all;
+    if (rank==0) {
+        for (int r=1; r<P; r++) {
+            offsets[r] = offsets[r-1]+lengths[r-1];
+        }
+        all.resize(offsets[P-1]+lengths[P-1]);
+    }
+    MPI_Gatherv(&local[0], length, MPI_CHAR, &all[0], lengths.data(), offsets.data(), MPI_CHAR, 0, MPI_COMM_WORLD);
+
+    if (rank==0) {
+        //Drop the separator after the last event
+        all.erase(all.size()-2);
+        ofstream file(trace_file.c_str());
+        file<<"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"<<all<<"\n]}\n";
+        if (not file) {
+            cerr<<"Warning: the trace could not be written to "<<trace_file<<endl;
+        }
+        else {
+            cout<<"Trace of "<<P<<" processors written to "<<trace_file<<endl;
+        }
+    }
+}
+
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to open a hardware counter of the calling thread with perf_event_open; the counters are user-space only, which the
+ *          default perf_event_paranoid setting allows.
+ *
+ * \param   counter is 0 for the cycles, 1 for the instructions, 2 for the last-level cache misses and 3 for the raw event flop_event.
+ * \param   leader is the counter leading the group of the new counter, or -1 for a new group, opened disabled.
+ * \return  the file descriptor of the counter, or -1 (with errno set) if it is not available.
+ ********************************************************************************************************************************************
+ */
+int perf_open_counter(int counter, string flop_event, int leader) {
+#ifdef __linux__
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = counter < 3 ? PERF_TYPE_HARDWARE : PERF_TYPE_RAW;
+    unsigned long long configs[] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, 0};
+    attr.config = counter < 3 ? configs[counter] : stoull(flop_event, NULL, 0);
+    attr.disabled = leader < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to start (enable true) or stop the counters of all the threads of the team.
+ ********************************************************************************************************************************************
+ */
+void perf_enable(SF_context& c, bool enable) {
+#ifdef __linux__
+    for (size_t t=0; t<c.perf_fds.size(); t+=4) {
+        ioctl(c.perf_fds[t], enable ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to open the hardware counters of the threads of the team, if perf_switch is set.
+ *
+ *          Every OpenMP thread opens its own group of counters, since a counter only counts the thread that opened it; the threads of the
+ *          team are kept by the OpenMP runtime for the kernels. If the cycles cannot be counted by every thread, for example in a virtual
+ *          machine without a performance monitoring unit or with perf_event_paranoid above 2, the counters are closed and only the time
+ *          and the pairs of points of the kernels are reported. The cache misses and flop_event are left out where they are not available.
+ ********************************************************************************************************************************************
+ */
+void perf_open(SF_context& c) {
+    c.perf_fds.clear();
+    c.perf_counts.assign(4, 0);
+    c.perf_time = 0;
+    c.perf_pairs = 0;
+    if (not c.perf_switch) {
+        return;
+    }
+
+    vector<int> fds(4*c.team_size, -1), errors(c.team_size, 0);
+    #pragma omp parallel num_threads(c.team_size)
+    {
+        int* fd = &fds[4*omp_get_thread_num()];
+        fd[0] = perf_open_counter(0, c.flop_event, -1);
+        if (fd[0] < 0) {
+            errors[omp_get_thread_num()] = errno;
+        }
+        else {
+            fd[1] = perf_open_counter(1, c.flop_event, fd[0]);
+            fd[2] = perf_open_counter(2, c.flop_event, fd[0]);
+            if (not c.flop_event.empty()) {
+                fd[3] = perf_open_counter(3, c.flop_event, fd[0]);
+            }
+        }
+    }
+
+    int error = 0;
+    for (int t=0; t<c.team_size; t++) {
+        error = error ? error : errors[t];
+    }
+    int unavailable = error != 0, total = 0;
+    MPI_Reduce(&unavailable, &total, 1, MPI_INT, MPI_SUM, 0, c.comm);
+    if (c.rank_mpi==0 and total > 0) {
+        cerr<<"WARNING: The hardware counters are not available on "<<total<<" of "<<c.P<<" processors"
+            <<(error ? " ("+string(strerror(error))+")" : "")<<"; only the time and the pairs of points of their kernels are reported."<<endl;
+    }
+    if (error) {
+        for (size_t n=0; n<fds.size(); n++) {
+            if (fds[n] >= 0) {
+                close(fds[n]);
+            }
+        }
+        return;
+    }
+    c.perf_fds = fds;
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to start the counters and the timer of the kernel of one step of the displacement loop.
+ ********************************************************************************************************************************************
+ */
+void perf_start(SF_context& c) {
+    if (not c.perf_switch) {
+        return;
+    }
+    perf_enable(c, true);
+    c.perf_begin = MPI_Wtime();
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to stop the counters and the timer of the kernel of one step of the displacement loop.
+ ********************************************************************************************************************************************
+ */
+void perf_stop(SF_context& c) {
+    if (not c.perf_switch) {
+        return;
+    }
+    c.perf_time += MPI_Wtime()-c.perf_begin;
+    perf_enable(c, false);
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to read and close the counters, and to print the metrics of the kernels of every processor.
+ *
+ *          The counts of the threads are summed, scaled by the fraction of the time they were counted if the performance monitoring unit
+ *          multiplexed them. The metrics are the instructions per cycle, the bytes read from the memory per pair of points (a cache line of
+ *          64 bytes per last-level cache miss) and the floating-point rate. Without flop_event, the floating-point operations are
+ *          estimated as a multiplication and an addition per order and per increment of a pair of points, which leaves out the increments
+ *          and, for real orders, the logarithms and exponentials.
+ ********************************************************************************************************************************************
+ */
+void perf_report(SF_context& c) {
+    if (not c.perf_switch) {
+        return;
+    }
+    vector<double> counts(4, -1);
+    for (size_t t=0; t<c.perf_fds.size(); t+=4) {
+        uint64_t values[7] = {0};
+        if (read(c.perf_fds[t], values, sizeof(values)) > 0) {
+            double scale = values[2] > 0 ? double(values[1])/values[2] : 0;
+            for (int k=0, n=3; k<4; k++) {
+                if (c.perf_fds[t+k] >= 0) {
+                    counts[k] = max(counts[k], 0.0) + scale*values[n++];
+                }
+            }
+        }
+        for (int k=0; k<4; k++) {
+            if (c.perf_fds[t+k] >= 0) {
+                close(c.perf_fds[t+k]);
+            }
+        }
+    }
+    c.perf_fds.clear();
+    c.perf_counts = counts;
+
+    int increments = c.scalar_switch or c.longitudinal ? 1 : 2;
+    if (not c.transverse_axis.empty() and not c.scalar_switch) {
+        increments += 5;
+    }
+    double estimate = 2.0*increments*num_orders(c)*c.perf_pairs;
+
+    double local[7] = {c.perf_time, c.perf_pairs, counts[0], counts[1], counts[2], counts[3] >= 0 ? counts[3] : estimate,
+                       counts[3] >= 0 ? 1.0 : 0.0};
+    vector<double> all(7*c.P);
+    MPI_Gather(local, 7, MPI_DOUBLE, all.data(), 7, MPI_DOUBLE, 0, c.comm);
+
+    if (c.rank_mpi==0) {
+        cout<<"\nHardware counters of the kernels (n/a: not available):\n";
+        cout<<setw(6)<<"rank"<<setw(12)<<"time (s)"<<setw(14)<<"pairs"<<setw(8)<<"IPC"<<setw(14)<<"bytes/pair"<<setw(12)<<"GFLOP/s"<<endl;
+        bool estimated = false;
+        for (int r=0; r<c.P; r++) {
+            double* v = &all[7*r];
+            ostringstream ipc, bytes, rate;
+            ipc<<fixed<<setprecision(2);
+            bytes<<fixed<<setprecision(2);
+            rate<<fixed<<setprecision(3);
+            if (v[2] > 0 and v[3] >= 0) {
+                ipc<<v[3]/v[2];
+            }
+            else {
+                ipc<<"n/a";
+            }
+            if (v[4] >= 0 and v[1] > 0) {
+                bytes<<64*v[4]/v[1];
+            }
+            else {
+                bytes<<"n/a";
+            }
+            if (v[0] > 0) {
+                rate<<v[5]/v[0]*1e-9<<(v[6] > 0 ? "" : "*");
+            }
+            else {
+                rate<<"n/a";
+            }
+            estimated = estimated or v[6] == 0;
+            cout<<setw(6)<<r<<setw(12)<<setprecision(4)<<v[0]<<setw(14)<<setprecision(6)<<v[1]<<setw(8)<<ipc.str()<<setw(14)<<bytes.str()
+                <<setw(12)<<rate.str()<<endl;
+        }
+        if (estimated) {
+            cout<<"*: estimated from the number of pairs (two operations per order and increment); set Flop_event to count them"<<endl;
+        }
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to show the checklist for proper input files
+ ********************************************************************************************************************************************
+ */
+void show_checklist(){
+	
+  	cerr<<"Error: Please check the following\n\n";
+  	cerr<<"a. 'in' folder contains the input files\n\n";
+    cerr<<"b. Unless specified otherwise via command-line arguments, the input files should be as follows:\n";
+  	cerr<<"\tCase Vector:\n";
+ 	cerr<<"\t\tCase 2D: U.V1r.h5, U.V3r.h5\n";
+ 	cerr<<"\t\tCase 3D: U.V1r.h5, U.V2r.h5, U.V3r.h5\n";
+ 	cerr<<"\tCase Scalar: \n\t\tT.Fr.h5\n";
+    cerr<<"NOTE: The dataset name should be the same as the file name (without the .h5 extension).\n\n";
+	cerr<<"c. All the input datasets must have the same dimensions\n";
+	cerr<<"Please refer to Readme for details\n\n";
+    
+    
+
+
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to read a 2D field from an hdf5 file.
+ *
+ *          This function reads an hdf5 file containing a 2D field, which can be the \f$ x \f$ or \f$ z \f$ component of a 2D velocity field. The dimensions of the
+ *          2D field is \f$(N_x \times N_z)\f$, where \f$N_x\f$ and \f$N_z\f$ are the number of gridpoints in \f$ x \f$ and \f$ z \f$ directions respectively.
+ *          The hdf5 file should have only
+ *          one dataset, and the names of the hdf5 file and the dataset must be identical. This function makes use of the H5SI library for reading the
+ *          hdf5 file.
+ *
+ * \param   A is the 2D array to store the field that is read from the file.
+ * \param   fold is the name of the folder in which the input files are kept.
+ * \param   file is a string storing the name of the file to be read.
+ ********************************************************************************************************************************************
+ */
+void read_2D(Array<double,2> A, string fold, string file, string dset) {
+  ifstream file_name(fold+file+".h5");
+  lock_guard<mutex> h5_guard(h5_mutex);
+  h5::File f(fold+file+".h5", "r");
+  f[dset] >> A.data();
+}
+
+
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to read a 3D field from an hdf5 file.
+ *
+ *          This function reads an hdf5 file containing a 4D field, which can be the \f$ x \f$, \f$ y \f$, or \f$ z \f$ component of a 3D velocity field. The dimensions of the
+ *          3D field is \f$(N_x \times N_y \times N_z)\f$, where \f$N_x\f$, \f$N_y\f$, and \f$N_z\f$ are the number of gridpoints in \f$ x \f$, \f$ y \f$, and \f$ z \f$ directions
+ *          respectively. The hdf5 file should
+ *          have only one dataset, and the names of the hdf5 file and the dataset must be identical. This function makes use of the H5SI library for
+ *          reading the hdf5 file.
+ *
+ * \param A is the 3D array to store the field that is read from the file.
+ * \param fold is the name of the folder in which the input files are kept.
+ * \param file is a string storing the name of the file to be read.
+ * \param dset is the name of the dataset storing the input field.
+ ********************************************************************************************************************************************
+ */
+void read_3D(Array<double,3> A, string fold, string file, string dset) {
+	ifstream file_name(fold+file+".h5");
+	lock_guard<mutex> h5_guard(h5_mutex);
+	h5::File f(fold+file+".h5", "r");
+	f[dset] >> A.data();
+}
+
+
+/**
+***********************************************************************************************************************************
+* \brief Function to outputs the run-time instructions for the user
+*
+***********************************************************************************************************************************
+*/
+
+
+void help_command(){
+	if(rank_mpi==0){
+		cout<<"### iii) Running Instructions and Command-Line Arguments \n \
+		To run `fastSF`, change to `fastSF` directory. Ensure that the input\n\
+		hdf5 files follow the schema described in the previous subsection. \n\
+		If you want all the relevant parameters to be read from 'in/para.yaml', \n\
+		you can simply type the following: `mpirun -np [number of MPI processors] src/fastSF.out`\n\
+		`fastSF` allows the user to pass the input parameters using command line arguments as well.\n \
+		If inputs are provided via the command-line, the corresponding inputs read from the 'in/para.yaml'\n\
+		file get overriden. The user can also specify the input and output hdf5 file names via the \n\
+		command-line. The command line arguments are given as follows:\n\n\n\
+		`mpirun -np [number of MPI processors] src/fastSF.out -s [scalar_switch]` \n\
+		`-d [2D_switch] -l [Only_longitudinal] -p [Processors_X] -X [Nx] -Y [Ny]`\n\
+		`-Z [Nz] -x [Lx] -y [Ly] -z [Lz] -1 [q1] -2 [q2] -t [test_switch]`\n\
+		`-U [Name of the hdf5 file storing Ux]`\n\
+		`-V [Name of the hdf5 file storing Uy]`\n\
+		`-W [Name of the hdf5 file storing Uz]`\n\
+		`-Q [Name of the hdf5 file storing T]`\n\
+		`-u [Name of the dataset storing Ux]`\n\
+		`-v [Name of the dataset storing Uy]`\n\
+		`-w [Name of the dataset storing Uz]`\n\
+		`-q [Name of the dataset storing T]`\n\
+		`-P [Name of the hdf5 file storing the transverse structure functions]`\n\
+		`-L [Name of the hdf5 file storing the longitudinal structure functions]`\n\
+		`-f [Velocity_layout: planar or interleaved]`\n\
+		`-b [Brick_size]`\n\
+		`-k [Tile_size]`\n\
+		`-n [Threads]`\n\
+		`-o [Write_queue]`\n\
+		`-c [Stacked_velocity: read all velocity components from the -U file and -u dataset]`\n\
+		`-m [Pyramid_crossover]`\n\
+		`-e [Error_blocks]`\n\
+		`--tune [Benchmark the kernel variants and store the fastest]`\n\
+		`-J [Job manifest listing analyses to run concurrently]`\n\
+		`--merge [Output file followed by the sums files of several runs to be merged]`\n\
+		`--cache [Directory of the result cache]`\n\
+		`--walltime [Walltime budget in seconds]`\n\
+		`--resume [Continue from the resume file of a run stopped by its walltime]`\n\
+		`--trace [File to which the timeline of the processors is written in the Chrome trace format]`\n\
+		`--perf [Read the hardware counters of the kernels]`\n\
+		`--orders [Real orders separated by commas, replacing q1 and q2]`\n\
+        `-h [Help]`\n\n\n\
+		The user need not give all the command line arguments; the arguments that \n\
+		are not provided will be read by the `in/para.yaml` file. For, if the user wants \n\
+		to run `fastSF` with 16 processors with 4 processors in x direction, and wants to compute\n\
+		only the longitudinal structure functions, the following command should be entered:\n\
+		`mpirun -np 16 ./src/fastSF.out -p 4 -l true`\n\
+		In this case, the number of processors in the x-direction and the longitudinal\n\
+		structure function switch will be taken via the command line. The rest of the parameters \n\
+		will be taken from the `in/para.yaml` file.";
+	}
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to parse the parameters from the yaml file and from the command-line arguments.
+ *
+ * \param   argc is the number of command-line arguments passed by the user including the name of the program.
+ * \param   argv is the array of character pointers listing all the arguments.
+ *
+ ********************************************************************************************************************************************
+ */
+void get_Inputs(int argc, char* argv[]) {
+    YAML::Node para;
+    ifstream para_yaml,input_field;
+    string para_path="in/para.yaml";
+    para_yaml.open(para_path.c_str());
+  
+    if (para_yaml.is_open())
+    {
+      try
+      {
+        YAML::Parser parser(para_yaml);
+        parser.GetNextDocument(para);
+      }
+      catch(YAML::ParserException& e)
+      {
+        cerr << "Global::Parse: Error reading parameter file: \n" << e.what() << endl;
+      }
+  
+    }
+    else
+    {
+      cerr << "Global::Parse: Unable to open '" + para_path + "'." << endl;
+      exit_on_error();
+    }
+    para["program"]["scalar_switch"]>>scalar_switch;
+    para["program"]["Only_longitudinal"]>>longitudinal;
+    para["program"]["2D_switch"]>>two_dimension_switch;
+    para["program"]["Processors_X"]>>px;
+    if (const YAML::Node* layout = para["program"].FindValue("Velocity_layout")) {
+        *layout>>velocity_layout;
+    }
+    if (const YAML::Node* brick = para["program"].FindValue("Brick_size")) {
+        *brick>>brick_size;
+    }
+    if (const YAML::Node* tile = para["program"].FindValue("Tile_size")) {
+        *tile>>tile_size;
+    }
+    if (const YAML::Node* threads = para["program"].FindValue("Threads")) {
+        *threads>>num_threads;
+    }
+    if (const YAML::Node* queue = para["program"].FindValue("Write_queue")) {
+        *queue>>write_queue;
+    }
+    if (const YAML::Node* stacked = para["program"].FindValue("Stacked_velocity")) {
+        *stacked>>stacked_velocity;
+    }
+    if (const YAML::Node* crossover = para["program"].FindValue("Pyramid_crossover")) {
+        *crossover>>pyramid_crossover;
+    }
+    if (const YAML::Node* blocks = para["program"].FindValue("Error_blocks")) {
+        *blocks>>error_blocks;
+    }
+
+    para["test"]["test_switch"]>>test_switch;
+    
+    if (test_switch){
+    	para["grid"]["Nx"]>>Nx;
+    	para["grid"]["Ny"]>>Ny;
+    	para["grid"]["Nz"]>>Nz;
+	}
+    if (const YAML::Node* region = para.FindValue("region")) {
+        if (const YAML::Node* offset = region->FindValue("Offset")) {
+            *offset>>region_offset;
+        }
+        if (const YAML::Node* count = region->FindValue("Count")) {
+            *count>>region_count;
+        }
+        if (const YAML::Node* stride = region->FindValue("Stride")) {
+            *stride>>region_stride;
+        }
+    }
+    if (const YAML::Node* scaling = para.FindValue("scaling")) {
+        if (const YAML::Node* bins = scaling->FindValue("Bins")) {
+            *bins>>scaling_bins;
+        }
+        if (const YAML::Node* range = scaling->FindValue("Fit_range")) {
+            *range>>scaling_range;
+        }
+        if (const YAML::Node* order = scaling->FindValue("ESS_order")) {
+            *order>>ess_order;
+        }
+    }
+    if (const YAML::Node* angular = para.FindValue("angular")) {
+        if (const YAML::Node* bins = angular->FindValue("Bins")) {
+            *bins>>angular_bins;
+        }
+        if (const YAML::Node* degree = angular->FindValue("Degree")) {
+            *degree>>angular_degree;
+        }
+    }
+    if (const YAML::Node* conditional = para.FindValue("conditional")) {
+        (*conditional)["File"]>>conditional_file;
+        (*conditional)["Dataset"]>>conditional_dataset;
+        if (const YAML::Node* bins = conditional->FindValue("Bins")) {
+            *bins>>conditional_bins;
+        }
+        if (const YAML::Node* edges = conditional->FindValue("Edges")) {
+            *edges>>conditional_edges;
+        }
+    }
+    if (const YAML::Node* components = para.FindValue("components")) {
+        (*components)["Axis"]>>transverse_axis;
+    }
+    if (const YAML::Node* schedule = para.FindValue("schedule")) {
+        if (const YAML::Node* order = schedule->FindValue("Order")) {
+            *order>>schedule_order;
+        }
+        if (const YAML::Node* priority = schedule->FindValue("Priority")) {
+            *priority>>schedule_priority;
+        }
+        if (const YAML::Node* interval = schedule->FindValue("Flush_interval")) {
+            *interval>>flush_interval;
+        }
+        if (const YAML::Node* budget = schedule->FindValue("Walltime")) {
+            *budget>>walltime;
+        }
+        if (const YAML::Node* limit = schedule->FindValue("Max_steps")) {
+            *limit>>max_steps;
+        }
+        if (const YAML::Node* resume = schedule->FindValue("Resume")) {
+            *resume>>resume_switch;
+        }
+    }
+    if (const YAML::Node* trace = para.FindValue("trace")) {
+        if (const YAML::Node* file = trace->FindValue("File")) {
+            *file>>trace_file;
+        }
+        if (const YAML::Node* threshold = trace->FindValue("Threshold")) {
+            *threshold>>trace_threshold;
+        }
+    }
+    if (const YAML::Node* perf = para.FindValue("perf")) {
+        if (const YAML::Node* counters = perf->FindValue("Counters")) {
+            *counters>>perf_switch;
+        }
+        if (const YAML::Node* event = perf->FindValue("Flop_event")) {
+            *event>>flop_event;
+        }
+    }
+    if (const YAML::Node* cache = para.FindValue("cache")) {
+        if (const YAML::Node* directory = cache->FindValue("Directory")) {
+            *directory>>cache_dir;
+        }
+    }
+    if (const YAML::Node* partial = para.FindValue("partial")) {
+        if (const YAML::Node* sums = partial->FindValue("Sums")) {
+            *sums>>write_sums;
+        }
+        if (const YAML::Node* range = partial->FindValue("X_range")) {
+            *range>>x_range;
+        }
+    }
+    if (const YAML::Node* derived = para.FindValue("derived")) {
+        (*derived)["Field"]>>derived_field;
+        if (const YAML::Node* periodic = derived->FindValue("Periodic")) {
+            *periodic>>derived_periodic;
+        }
+    }
+    if (const YAML::Node* pdf = para.FindValue("joint_pdf")) {
+        (*pdf)["Separations"]>>pdf_separations;
+        if (const YAML::Node* bins = pdf->FindValue("Bins")) {
+            *bins>>pdf_bins;
+        }
+        if (const YAML::Node* scalar = pdf->FindValue("Scalar")) {
+            *scalar>>pdf_scalar;
+        }
+    }
+    para["domain_dimension"]["Lx"]>>Lx;
+    para["domain_dimension"]["Ly"]>>Ly;
+    para["domain_dimension"]["Lz"]>>Lz;
+  
+    para["structure_function"]["q1"]>>q1;
+    para["structure_function"]["q2"]>>q2;
+    orders.clear();
+    if (const YAML::Node* real_orders = para["structure_function"].FindValue("Orders")) {
+        *real_orders>>orders;
+    }
+    if (const YAML::Node* absolute = para["structure_function"].FindValue("Absolute")) {
+        *absolute>>absolute_moments;
+    }
+    
+  
+    static struct option long_options[] = {
+        {"tune", no_argument, 0, 'T'},
+        {"manifest", required_argument, 0, 'J'},
+        {"cache", required_argument, 0, 'C'},
+        {"walltime", required_argument, 0, 'B'},
+        {"resume", no_argument, 0, 'R'},
+        {"trace", required_argument, 0, 'G'},
+        {"perf", no_argument, 0, 'K'},
+        {"orders", required_argument, 0, 'O'},
+        {0, 0, 0, 0}
+    };
+
+    //The inputs set by the options are kept by reset_inputs()
+    int option;
+    while ((option=getopt_long(argc, argv, "X:Y:Z:1:2:x:y:z:l:d:p:t:s:U:V:W:Q:P:L:M:h:u:v:w:q:f:b:k:n:o:c:m:e:J:", long_options, NULL))!=-1){
+    	switch(option){
+    		case 'h':
+    			help_command();
+    			exit(1);
+    			break;
+    		case 'X':
+    			Nx=std::stoi(optarg);
+    			break;
+    		case 'Y':
+    			Ny=std::stoi(optarg);
+    			break;
+    		case 'Z':
+    			Nz=std::stoi(optarg);
+    			break;
+    		case 'x':
+    			Lx=std::stod(optarg);
+    			break;
+    		case 'y':
+    			Ly=std::stod(optarg);
+    			break;
+    		case 'z':
+    			Lz=std::stod(optarg);
+    			break;
+    		case 'p':
+    			px=std::stod(optarg);
+    			break;
+    		case '1':
+    			q1=str_to_order(optarg);
+    			break;
+    		case '2':
+    			q2=str_to_order(optarg);
+    			break;
+    		case 't':
+    			test_switch=str_to_bool(optarg);
+    			break;
+    		case 's':
+    			scalar_switch=str_to_bool(optarg);
+    			break;
+    		case 'd':
+    			two_dimension_switch=str_to_bool(optarg);
+    			break;
+    		case 'l':
+    			longitudinal=str_to_bool(optarg);
+    			break;
+            case 'U':
+                UName = optarg;
+                break;
+            case 'V':
+                VName = optarg;
+                break;
+            case 'W':
+                WName = optarg;
+                break;
+            case 'Q':
+                TName = optarg;
+                break;
+            case 'u':
+                UdName = optarg;
+                break;
+            case 'v':
+                VdName = optarg;
+                break;
+            case 'w':
+                WdName = optarg;
+                break;
+            case 'q':
+                TdName = optarg;
+                break;
+            case 'P':
+                SF_Grid_perp_name = optarg;
+                break;
+            case 'L':
+                SF_Grid_pll_name = optarg;
+                break;
+            case 'M':
+                SF_Grid_scalar_name = optarg;
+                break;
+            case 'f':
+                velocity_layout = optarg;
+                break;
+            case 'b':
+                brick_size = std::stoi(optarg);
+                break;
+            case 'k':
+                tile_size = std::stoi(optarg);
+                break;
+            case 'n':
+                num_threads = std::stoi(optarg);
+                break;
+            case 'o':
+                write_queue = std::stoi(optarg);
+                break;
+            case 'c':
+                stacked_velocity = str_to_bool(optarg);
+                break;
+            case 'm':
+                pyramid_crossover = std::stoi(optarg);
+                break;
+            case 'e':
+                error_blocks = std::stoi(optarg);
+                break;
+            case 'T':
+                tune_switch = true;
+                break;
+            case 'J':
+                manifest_name = optarg;
+                break;
+            case 'C':
+                cache_dir = optarg;
+                break;
+            case 'B':
+                walltime = std::stod(optarg);
+                break;
+            case 'R':
+                resume_switch = true;
+                break;
+            case 'G':
+                trace_file = optarg;
+                break;
+            case 'K':
+                perf_switch = true;
+                break;
+            case 'O':
+                orders = str_to_orders(optarg);
+                break;
+            default:
+                if (rank_mpi==0){
+                    cout<<"\nNo command line options given; reading all the inputs from para.yaml.\n";
+                }
+    	}
+    }
+
+    if (velocity_layout!="" && velocity_layout!="planar" && velocity_layout!="interleaved") {
+        if (rank_mpi==0) {
+            cerr<<"Invalid velocity layout '"<<velocity_layout<<"'; use 'planar' or 'interleaved'\n";
+        }
+        exit_on_error();
+    }
+    if (brick_size < -1 || tile_size == 0 || tile_size < -1 || num_threads < -1) {
+        if (rank_mpi==0) {
+            cerr<<"Invalid brick size, tile size or number of threads; they have to be positive (0 is allowed for no bricks or default threads)\n";
+        }
+        exit_on_error();
+    }
+    if (pyramid_crossover < 0) {
+        if (rank_mpi==0) {
+            cerr<<"Invalid pyramid crossover; it has to be positive (0 is allowed to use all the base points)\n";
+        }
+        exit_on_error();
+    }
+    if (scaling_bins < 0 or (not scaling_range.empty() and (scaling_range.size() != 2 or scaling_range[0] < 0
+        or scaling_range[1] <= scaling_range[0]))) {
+        if (rank_mpi==0) {
+            cerr<<"Invalid scaling summary; Bins has to be positive (0 for no summary) and Fit_range has to be [r_min, r_max] with 0 <= r_min < r_max\n";
+        }
+        exit_on_error();
+    }
+    if ((not angular_bins.empty() and (angular_bins.size() != 3 or *min_element(angular_bins.begin(), angular_bins.end()) < 1))
+        or angular_degree < -1) {
+        if (rank_mpi==0) {
+            cerr<<"Invalid angular decomposition; Bins has to be [n_r, n_theta, n_phi] with positive entries, and Degree at least -1\n";
+        }
+        exit_on_error();
+    }
+    if (not conditional_file.empty() and (conditional_edges.empty() ? conditional_bins < 1
+        : (conditional_edges.size() < 2 or not is_sorted(conditional_edges.begin(), conditional_edges.end())))) {
+        if (rank_mpi==0) {
+            cerr<<"Invalid conditional structure functions; Bins has to be positive, or Edges has to list at least two increasing edges\n";
+        }
+        exit_on_error();
+    }
+    if (not transverse_axis.empty() and (transverse_axis.size() != 3 or scalar_switch
+        or transverse_axis[0]*transverse_axis[0]+transverse_axis[1]*transverse_axis[1]+transverse_axis[2]*transverse_axis[2] == 0)) {
+        if (rank_mpi==0) {
+            cerr<<"Invalid component structure functions; they need a velocity field, and Axis has to be a nonzero vector [a_x, a_y, a_z]\n";
+        }
+        exit_on_error();
+    }
+    int component, axis;
+    if (not derived_field.empty() and (test_switch or (derived_field == "vorticity" ? scalar_switch
+        : not parse_gradient(derived_field, scalar_switch, two_dimension_switch, component, axis)))) {
+        if (rank_mpi==0) {
+            cerr<<"Invalid derived field; Field has to be vorticity (for velocity fields) or a derivative such as dUx_dy or dT_dz of a component of"
+                <<" the input fields along x, y or z (x or z for 2D fields), and the input fields have to be read from files\n";
+        }
+        exit_on_error();
+    }
+    bool derived_scalar = not derived_field.empty() and (derived_field != "vorticity" or two_dimension_switch);
+    if (derived_scalar and not scalar_switch and (not transverse_axis.empty() or not pdf_separations.empty())) {
+        if (rank_mpi==0) {
+            cerr<<"The component structure functions and the joint PDFs need a velocity field, but the derived field "<<derived_field
+                <<" is a scalar\n";
+        }
+        exit_on_error();
+    }
+    bool separations_valid = true;
+    for (size_t s=0; s<pdf_separations.size(); s++) {
+        int d = pdf_separations[s].size();
+        separations_valid = separations_valid and (d == 2 or d == 3)
+            and *min_element(pdf_separations[s].begin(), pdf_separations[s].end()) >= 0
+            and *max_element(pdf_separations[s].begin(), pdf_separations[s].end()) > 0;
+    }
+    if (not pdf_separations.empty() and (not separations_valid or pdf_bins.size() != 2 or min(pdf_bins[0], pdf_bins[1]) < 1
+        or scalar_switch or (pdf_scalar and test_switch))) {
+        if (rank_mpi==0) {
+            cerr<<"Invalid joint PDFs; they need a velocity field read from files if Scalar is true, Separations has to list nonzero displacements"
+                <<" [x, y, z] (or [x, z] for 2D fields) with non-negative entries, and Bins has to be [n_pll, n_perp] with positive entries\n";
+        }
+        exit_on_error();
+    }
+    if (not x_range.empty() and (x_range.size() != 2 or x_range[0] < 0 or x_range[1] < x_range[0])) {
+        if (rank_mpi==0) {
+            cerr<<"Invalid X_range; it has to be [first, last] with 0 <= first <= last\n";
+        }
+        exit_on_error();
+    }
+    if (walltime == 0 and getenv("FASTSF_WALLTIME") != NULL) {
+        walltime = atof(getenv("FASTSF_WALLTIME"));
+    }
+    if (walltime < 0) {
+        if (rank_mpi==0) {
+            cerr<<"Invalid walltime; it has to be a time in seconds (0 for no walltime)\n";
+        }
+        exit_on_error();
+    }
+    size_t parsed = 0;
+    try {
+        stoull(flop_event, &parsed, 0);
+    }
+    catch (logic_error&) {
+    }
+    if (not flop_event.empty() and parsed != flop_event.size()) {
+        if (rank_mpi==0) {
+            cerr<<"Invalid perf Flop_event '"<<flop_event<<"'; it has to be the raw code of a hardware event, for example 0x01c7\n";
+        }
+        exit_on_error();
+    }
+    if (trace_threshold < 0) {
+        if (rank_mpi==0) {
+            cerr<<"Invalid trace Threshold; it has to be a time in seconds\n";
+        }
+        exit_on_error();
+    }
+    bool positive = true;
+    for (size_t i=0; i<schedule_priority.size(); i++) {
+        positive = positive and schedule_priority[i] > 0;
+    }
+    if ((schedule_order != "default" and schedule_order != "radial") or not positive
+        or (not schedule_priority.empty() and schedule_priority.size() != 2 and schedule_priority.size() != 3) or flush_interval < 0
+        or max_steps < 0) {
+        if (rank_mpi==0) {
+            cerr<<"Invalid schedule; Order has to be 'default' or 'radial', Priority a positive weight per dimension of the fields, "
+                <<"Flush_interval a time in seconds (0 for no intermediate writes), and Max_steps a number of steps (0 for no limit)\n";
+        }
+        exit_on_error();
+    }
+    if (not x_range.empty() and not conditional_file.empty()) {
+        if (rank_mpi==0) {
+            cerr<<"X_range cannot be combined with the conditional structure functions\n";
+        }
+        exit_on_error();
+    }
+    if (error_blocks < 0) {
+        if (rank_mpi==0) {
+            cerr<<"Invalid number of error blocks; it has to be positive (0 is allowed for no error estimate)\n";
+        }
+        exit_on_error();
+    }
+    if (write_queue < 0) {
+        if (rank_mpi==0) {
+            cerr<<"Invalid write queue length; it has to be positive (0 is allowed for synchronous writing)\n";
+        }
+        exit_on_error();
+    }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to generate an idealized 3D velocity field.
+ *
+ *          This function generates the following 3D velocity field.
+ *          \f$u_x = x, \quad u_y = y, \quad u_z = z\f$.
+ *
+ * \param Ux is a 3D array representing the x-component of 3D velocity field.
+ * \param Uy is a 3D array representing the y-component of 3D velocity field.
+ * \param Uz is a 3D array representing the z-component of 3D velocity field.
+ ********************************************************************************************************************************************
+ */
+void Read_Init(SF_context& c, Array<double,3>& Ux, Array<double,3>& Uy, Array<double,3>& Uz){
+  if (c.rank_mpi==0)
+  {cout<<"\nGenerating the 3D velocity field: U = [x, y, z] \n";
+  }
+  for (int i=0; i<c.Nx; i++){
+      for (int j=0; j<c.Ny; j++){
+        for (int k=0; k<c.Nz; k++){
+            Ux(i, j, k) = i*c.dx;
+            Uy(i, j, k) = j*c.dy;
+            Uz(i, j, k) = k*c.dz;
+          }
+        }
+    }
+    if (c.rank_mpi==0)
+    {cout<<"\nField has been generated.\n";
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to generate an idealized 2D velocity field.
+ *
+ *          This function generates the following 2D velocity field.
+ *          \f$u_x = x, \quad u_z = z\f$.
+ *
+ * \param Ux is a 2D array representing the x-component of 2D velocity field.
+ * \param Uz is a 2D array representing the z-component of 2D velocity field.
+ ********************************************************************************************************************************************
+ */
+void Read_Init(SF_context& c, Array<double,2>& Ux, Array<double,2>& Uz){
+	if (c.rank_mpi==0){
+		cout<<"\nGenerating the 2D velocity field: U = [x, z] \n";
+	}
+    for (int i=0;i<c.Nx;i++){
+      for (int k=0;k<c.Nz;k++){
+          Ux(i, k) = i*c.dx;
+          Uz(i, k) = k*c.dz;
+       }
+  }
+  if (c.rank_mpi==0)
+    {cout<<"\nField has been generated.\n";
+    }
+}
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to generate an idealized 2D scalar field.
+ *
+ *          This function generates the following 2D scalar field.
+ *          \f$\theta = x + z \f$
+ *
+ * \param T is a 2D array representing the x-component of 2D velocity field.
+ ********************************************************************************************************************************************
+ */
+void Read_Init(SF_context& c, Array<double,2>& T) {
+	if (c.rank_mpi==0){
+		cout<<"\nGenerating the scalar field: T = x + z \n";
+	}
+    for (int i=0;i<c.Nx;i++){
+      for (int k=0;k<c.Nz;k++){
+          T(i, k) = i*c.dx + k*c.dz;
+       }
+  }
+  if (c.rank_mpi==0)
+    {cout<<"\nField has been generated.\n";
+    }
 }
+
 /**
  ********************************************************************************************************************************************
- * \brief   Function to show the checklist for proper input files
+ * \brief   Function to generate an idealized 3D scalar field.
+ *
+ *          This function generates the following 2D scalar field.
+ *          \f$\theta = x + y + z \f$
+ *
+ * \param T is a 3D array representing the x-component of 2D velocity field.
  ********************************************************************************************************************************************
  */
-void show_checklist(){
-	
-  	cerr<<"Error: Please check the following\n\n";
-  	cerr<<"a. 'in' folder contains the input files\n\n";
-    cerr<<"b. Unless specified otherwise via command-line arguments, the input files should be as follows:\n";
-  	cerr<<"\tCase Vector:\n";
- 	cerr<<"\t\tCase 2D: U.V1r.h5, U.V3r.h5\n";
- 	cerr<<"\t\tCase 3D: U.V1r.h5, U.V2r.h5, U.V3r.h5\n";
- 	cerr<<"\tCase Scalar: \n\t\tT.Fr.h5\n";
-    cerr<<"NOTE: The dataset name should be the same as the file name (without the .h5 extension).\n\n";
-	cerr<<"c. All the input datasets must have the same dimensions\n";
-	cerr<<"Please refer to Readme for details\n\n";
-    
-    
+void Read_Init(SF_context& c, Array<double,3>& T) {
+	if (c.rank_mpi==0){
+		cout<<"\nGenerating the scalar field: T = x + y + z \n";
+	}
+    for (int i=0;i<c.Nx;i++){
+      for (int j=0;j<c.Ny;j++){
+          for (int k=0;k<c.Nz;k++){
+              T(i, j, k) = i*c.dx + j*c.dy + k*c.dz;
+          }
+      }
+  }
+  if (c.rank_mpi==0)
+    {cout<<"\nField has been generated.\n";
+    }
+}
+
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to add the powers \f$ v^{q_1}, \dots, v^{q_2} \f$ of an increment to the running sums.
+ *
+ *          With absolute_moments, the magnitudes \f$ |v^{q}| = |v|^{q} \f$ of the same products are added to the q2-q1+1 sums that follow.
+ *
+ *          For real orders, the powers \f$ |v|^{q} = \exp(q \log |v|) \f$ take one logarithm per increment and one exponential per order. A
+ *          zero increment adds nothing to any order, so that the negative orders stay finite.
+ *
+ * \param v is the increment
+ * \param S points to the num_orders() running sums
+ ********************************************************************************************************************************************
+ */
+inline void add_powers(SF_context& c, double v, double* S)
+{
+    if (not c.orders.empty()) {
+        if (v != 0) {
+            double log_v = log(fabs(v));
+            const double* q = c.orders.data();
+            int nq = c.orders.size();
+            #pragma omp simd
+            for (int p=0; p<nq; p++) {
+                S[p] += exp(q[p]*log_v);
+            }
+        }
+        return;
+    }
+    double v_q = pow(v, c.q1);
+    if (c.absolute_moments) {
+        int nq = c.q2-c.q1+1;
+        for (int p=0; p<nq; p++) {
+            S[p] += v_q;
+            S[nq+p] += fabs(v_q);
+            v_q *= v;
+        }
+        return;
+    }
+    for (int p=0; p<=c.q2-c.q1; p++) {
+        S[p] += v_q;
+        v_q *= v;
+    }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to add the sums of the powers of the increments of an array to the running sums, as add_powers() does for one increment.
+ *
+ * \param A stores the increments
+ * \param S points to the num_orders() running sums
+ ********************************************************************************************************************************************
+ */
+template<int N>
+void add_power_sums(SF_context& c, Array<double,N> A, double* S)
+{
+    if (c.absolute_moments) {
+        int nq = c.q2-c.q1+1;
+        Array<double,N> A_q(A.shape());
+        A_q = pow(A, c.q1);
+        for (int p=0; p<nq; p++) {
+            S[p] += sum(A_q);
+            S[nq+p] += sum(abs(A_q));
+            A_q = A_q*A;
+        }
+        return;
+    }
+    if (c.orders.empty()) {
+        for (int p=0; p<=c.q2-c.q1; p++) {
+            S[p] += sum(pow(A, c.q1+p));
+        }
+        return;
+    }
+    Array<double,N> log_A(A.shape());
+    log_A = where(A == 0, 0., log(abs(A)));
+    for (size_t p=0; p<c.orders.size(); p++) {
+        S[p] += sum(where(A == 0, 0., exp(c.orders[p]*log_A)));
+    }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to return the order of the p-th structure function.
+ ********************************************************************************************************************************************
+ */
+double order_value(SF_context& c, int p)
+{
+    return c.orders.empty() ? c.q1+p%(c.q2-c.q1+1) : c.orders[p];
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to return the number of structure functions computed per displacement: the orders q1 to q2 (or the real orders),
+ *          followed by the absolute moments of the orders q1 to q2 with absolute_moments.
+ ********************************************************************************************************************************************
+ */
+int num_orders(SF_context& c)
+{
+    return c.absolute_moments ? 2*(c.q2-c.q1+1) : c.q2-c.q1+1;
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to return whether the displacements of index x along \f$ x \f$ are computed, as set by X_range.
+ *
+ *          The structure functions and the numbers of pairs of points of the displacements that are not computed are zero, so that the
+ *          sums of runs over disjoint ranges can be merged.
+ ********************************************************************************************************************************************
+ */
+bool displacement_selected(SF_context& c, int x)
+{
+    return c.x_range.empty() or (x >= c.x_range[0] and x <= c.x_range[1]);
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to return the label of the p-th order, used in the names of the datasets.
+ ********************************************************************************************************************************************
+ */
+string order_label(SF_context& c, int p)
+{
+    if (c.orders.empty()) {
+        int nq = c.q2-c.q1+1;
+        return p < nq ? int_to_str(c.q1+p) : "_abs"+int_to_str(c.q1+p-nq);
+    }
+    ostringstream label;
+    label<<c.orders[p];
+    return label.str();
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to return the labels of all the orders.
+ ********************************************************************************************************************************************
+ */
+vector<string> order_labels(SF_context& c)
+{
+    vector<string> labels;
+    for (int p=0; p<num_orders(c); p++) {
+        labels.push_back(order_label(c, p));
+    }
+    return labels;
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to return the spacing of the base points used for a displacement by the multi-resolution estimator.
+ *
+ *          The spacing is 1 below the crossover and doubles each time the largest component of the displacement doubles beyond it.
+ *
+ * \param x, y, z are the indices of the displacement
+ ********************************************************************************************************************************************
+ */
+inline int pyramid_stride(SF_context& c, int x, int y, int z)
+{
+    int f = 1;
+    if (c.pyramid_crossover > 0) {
+        int m = max(x, max(y, z));
+        while (m >= f*c.pyramid_crossover) {
+            f *= 2;
+        }
+    }
+    return f;
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to return the number of blocks of base points for the error estimate (1 if no errors are estimated).
+ ********************************************************************************************************************************************
+ */
+int num_blocks(SF_context& c)
+{
+    int B = max(1, c.error_blocks);
+    return c.two_dimension_switch ? B*B : B*B*B;
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to find the base points of each block along one direction.
+ *
+ *          The base point \f$ i \f$ of a direction of \f$ n \f$ points belongs to the block \f$ \lfloor i B/n \rfloor \f$, \f$ B \f$ being the
+ *          number of blocks. The base points used for a displacement are \f$ i = f\,i' \f$ with \f$ i' < m \f$.
+ *
+ * \param n is the number of points along the direction
+ * \param m is the number of base points used along the direction
+ * \param f is the spacing of the base points
+ * \param first, last store the range of \f$ i' \f$ of each block (last is smaller than first for an empty block)
+ ********************************************************************************************************************************************
+ */
+void block_ranges(SF_context& c, int n, int m, int f, vector<int>& first, vector<int>& last)
+{
+    int B = max(1, c.error_blocks);
+    first.resize(B);
+    last.resize(B);
+    for (int b=0; b<B; b++) {
+        long lo = (long(b)*n+B-1)/B;
+        long hi = (long(b+1)*n+B-1)/B-1;
+        first[b] = int((lo+f-1)/f);
+        last[b] = int(min(long(m-1), hi/f));
+    }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to count the base points of each block used for a displacement.
+ *
+ * \param x, y, z are the indices of the displacement (y is ignored for 2D fields)
+ * \param f is the spacing of the base points
+ * \param count stores the number of base points of each block
+ ********************************************************************************************************************************************
+ */
+void block_counts(SF_context& c, int x, int y, int z, int f, vector<double>& count)
+{
+    vector<int> fx, lx, fy, ly, fz, lz;
+    block_ranges(c, c.Nx, (c.Nx-x-1)/f+1, f, fx, lx);
+    block_ranges(c, c.Nz, (c.Nz-z-1)/f+1, f, fz, lz);
+    if (c.two_dimension_switch) {
+        fy.assign(1, 0);
+        ly.assign(1, 0);
+    }
+    else {
+        block_ranges(c, c.Ny, (c.Ny-y-1)/f+1, f, fy, ly);
+    }
+    count.clear();
+    for (size_t bx=0; bx<fx.size(); bx++) {
+        for (size_t by=0; by<fy.size(); by++) {
+            for (size_t bz=0; bz<fz.size(); bz++) {
+                count.push_back(double(max(0, lx[bx]-fx[bx]+1))*max(0, ly[by]-fy[by]+1)*max(0, lz[bz]-fz[bz]+1));
+            }
+        }
+    }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to tabulate the block of each base point of a 3D field.
+ *
+ *          The base point (i, j, k) belongs to the block bx[i] + by[j] + bz[k].
+ ********************************************************************************************************************************************
+ */
+void block_offsets(SF_context& c, vector<int>& bx, vector<int>& by, vector<int>& bz)
+{
+    int B = max(1, c.error_blocks);
+    bx.resize(c.Nx);
+    by.resize(c.Ny);
+    bz.resize(c.Nz);
+    for (int i=0; i<c.Nx; i++) {
+        bx[i] = int(long(i)*B/c.Nx)*B*B;
+    }
+    for (int j=0; j<c.Ny; j++) {
+        by[j] = int(long(j)*B/c.Ny)*B;
+    }
+    for (int k=0; k<c.Nz; k++) {
+        bz[k] = int(long(k)*B/c.Nz);
+    }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to add the powers of the increments of a displacement per block of base points.
+ *
+ * \param A stores the increments of the base points used, of shape \f$ (m_x, m_y, m_z) \f$
+ * \param nx, ny, nz are the numbers of points of the field
+ * \param f is the spacing of the base points
+ * \param S stores the sums of the orders q1 to q2 of each group, followed by the number of base points of each group if the structure
+ *          functions are conditioned (see num_groups())
+ ********************************************************************************************************************************************
+ */
+void block_sums_3D(SF_context& c, Array<double,3> A, int nx, int ny, int nz, int f, Array<double,1> S)
+{
+    int nq = num_orders(c);
+    if (c.conditional_bins > 0) {
+        int nt = num_groups(c)*nq;
+        vector<int> bx, by, bz;
+        block_offsets(c, bx, by, bz);
+        for (int i=0; i<A.extent(0); i++) {
+            for (int j=0; j<A.extent(1); j++) {
+                long r_ij = (long(i)*f*ny+j*f)*nz;
+                for (int k=0; k<A.extent(2); k++) {
+                    int g = bx[i*f]+by[j*f]+bz[k*f]+c.conditional_group[r_ij+k*f];
+                    add_powers(c, A(i,j,k), S.data()+g*nq);
+                    S(nt+g) += 1;
+                }
+            }
+        }
+        return;
+    }
+    vector<int> fx, lx, fy, ly, fz, lz;
+    block_ranges(c, nx, A.extent(0), f, fx, lx);
+    block_ranges(c, ny, A.extent(1), f, fy, ly);
+    block_ranges(c, nz, A.extent(2), f, fz, lz);
+    int b = 0;
+    for (size_t bx=0; bx<fx.size(); bx++) {
+        for (size_t by=0; by<fy.size(); by++) {
+            for (size_t bz=0; bz<fz.size(); bz++, b++) {
+                if (lx[bx] < fx[bx] or ly[by] < fy[by] or lz[bz] < fz[bz]) {
+                    continue;
+                }
+                add_power_sums(c, A(Range(fx[bx],lx[bx]),Range(fy[by],ly[by]),Range(fz[bz],lz[bz])), S.data()+b*nq);
+            }
+        }
+    }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to add the powers of the increments of a displacement per block of base points for a 2D field.
+ *
+ * \param A stores the increments of the base points used, of shape \f$ (m_x, m_z) \f$
+ * \param nx, nz are the numbers of points of the field
+ * \param f is the spacing of the base points
+ * \param S stores the sums of the orders q1 to q2 of each group, followed by the number of base points of each group if the structure
+ *          functions are conditioned (see num_groups())
+ ********************************************************************************************************************************************
+ */
+void block_sums_2D(SF_context& c, Array<double,2> A, int nx, int nz, int f, Array<double,1> S)
+{
+    int nq = num_orders(c);
+    if (c.conditional_bins > 0) {
+        int B = max(1, c.error_blocks);
+        int nt = num_groups(c)*nq;
+        for (int i=0; i<A.extent(0); i++) {
+            for (int k=0; k<A.extent(1); k++) {
+                int g = int(long(i*f)*B/nx)*B + int(long(k*f)*B/nz) + c.conditional_group[long(i*f)*nz+k*f];
+                add_powers(c, A(i,k), S.data()+g*nq);
+                S(nt+g) += 1;
+            }
+        }
+        return;
+    }
+    vector<int> fx, lx, fz, lz;
+    block_ranges(c, nx, A.extent(0), f, fx, lx);
+    block_ranges(c, nz, A.extent(1), f, fz, lz);
+    int b = 0;
+    for (size_t bx=0; bx<fx.size(); bx++) {
+        for (size_t bz=0; bz<fz.size(); bz++, b++) {
+            if (lx[bx] < fx[bx] or lz[bz] < fz[bz]) {
+                continue;
+            }
+            add_power_sums(c, A(Range(fx[bx],lx[bx]),Range(fz[bz],lz[bz])), S.data()+b*nq);
+        }
+    }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to obtain the structure functions of a displacement and their standard errors from the sums per block.
+ *
+ *          The structure function is the total sum divided by the total number of base points. Its standard error is estimated by the
+ *          delete-one-block jackknife: with \f$ \theta_b \f$ the structure function computed without the block \f$ b \f$, and \f$ n \f$ the
+ *          number of non-empty blocks, the variance is \f$ (n-1)/n \sum_b (\theta_b - \bar\theta)^2 \f$.
+ *
+ * \param S stores the sums of each block on entry, and the structure functions in its first num_orders() entries on return
+ * \param count stores the number of base points of each block
+ * \param E stores the standard errors (0 if fewer than two blocks are non-empty)
+ ********************************************************************************************************************************************
+ */
+void block_statistics(SF_context& c, Array<double,1> S, const vector<double>& count, Array<double,1> E)
+{
+    int nq = num_orders(c);
+    int nb = count.size();
+    double total = 0;
+    int used = 0;
+    for (int b=0; b<nb; b++) {
+        total += count[b];
+        if (count[b] > 0) {
+            used++;
+        }
+    }
+
+    for (int p=0; p<nq; p++) {
+        double S_sum = 0;
+        for (int b=0; b<nb; b++) {
+            S_sum += S(b*nq+p);
+        }
+
+        E(p) = 0;
+        if (used > 1) {
+            vector<double> theta;
+            double mean = 0;
+            for (int b=0; b<nb; b++) {
+                if (count[b] > 0) {
+                    theta.push_back((S_sum-S(b*nq+p))/(total-count[b]));
+                    mean += theta.back();
+                }
+            }
+            mean /= used;
+            double var = 0;
+            for (int b=0; b<used; b++) {
+                var += (theta[b]-mean)*(theta[b]-mean);
+            }
+            E(p) = sqrt(var*(used-1)/used);
+        }
+        S(p) = total > 0 ? S_sum/total : 0;
+    }
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to return the number of groups of base points whose sums are kept separately for a displacement.
+ *
+ *          A group is a block of base points (see num_blocks()) within one bin of the conditioning field; the group of a base point is
+ *          its block plus its bin times the number of blocks.
+ ********************************************************************************************************************************************
+ */
+int num_groups(SF_context& c)
+{
+    return num_blocks(c)*max(1, c.conditional_bins);
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to return the size of the array of sums of a displacement: the sums of each group and, if the structure functions are
+ *          conditioned, the number of base points of each group.
+ ********************************************************************************************************************************************
+ */
+int sum_size(SF_context& c)
+{
+    int nq = num_orders(c);
+    return num_groups(c)*nq + (c.conditional_bins > 0 ? num_groups(c) : 0);
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to obtain the conditional structure functions of a displacement from the sums per group.
+ *
+ *          The structure function of a bin is the sum over the blocks of the bin divided by its number of base points (0 if the bin is
+ *          empty). The sums of the bins are then added per block, so that block_statistics() yields the unconditioned structure functions.
+ *
+ * \param S stores the sums of each group on entry, and the sums of each block in its first num_blocks()*num_orders() entries on return
+ * \param groups stores the number of base points of each group
+ * \param S_bins stores the structure functions of each bin, of shape (bins, num_orders())
+ * \param count stores the number of base points of each block on return
+ ********************************************************************************************************************************************
+ */
+void conditional_statistics(SF_context& c, Array<double,1> S, const vector<double>& groups, Array<double,2> S_bins, vector<double>& count)
+{
+    int nq = num_orders(c);
+    int nb = num_blocks(c);
+    count.assign(nb, 0);
+
+    for (int b=0; b<c.conditional_bins; b++) {
+        double total = 0;
+        for (int k=0; k<nb; k++) {
+            total += groups[b*nb+k];
+            count[k] += groups[b*nb+k];
+        }
+        for (int p=0; p<nq; p++) {
+            double S_sum = 0;
+            for (int k=0; k<nb; k++) {
+                S_sum += S((b*nb+k)*nq+p);
+                if (b > 0) {
+                    S(k*nq+p) += S((b*nb+k)*nq+p);
+                }
+            }
+            S_bins(b,p) = total > 0 ? S_sum/total : 0;
+        }
+    }
+}
+
 
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to gather the structure functions computed by all the processors for one displacement each into a 4D grid.
+ *
+ * \param SF_Grid is the 4D array storing the structure functions (used only on rank 0)
+ * \param x, y, z are the indices of the displacement of this processor
+ * \param S stores the structure functions of all the orders for this displacement (or any other values of the last dimension of SF_Grid)
+ ********************************************************************************************************************************************
+ */
+void gather_SF_3D(SF_context& c, Array<double,4> SF_Grid, int x, int y, int z, Array<double,1> S)
+{
+    int nq = S.size();
+    Array<int, 1> X, Y, Z;
+    Array<double, 2> S_arr;
+
+    if (c.rank_mpi==0) {
+        X.resize(c.P);
+        Y.resize(c.P);
+        Z.resize(c.P);
+        S_arr.resize(c.P, nq);
+    }
+
+    double begin = trace_clock();
+    MPI_Gather(&x, 1, MPI_INT, X.data(), 1, MPI_INT, 0, c.comm);
+    MPI_Gather(&y, 1, MPI_INT, Y.data(), 1, MPI_INT, 0, c.comm);
+    MPI_Gather(&z, 1, MPI_INT, Z.data(), 1, MPI_INT, 0, c.comm);
+    MPI_Gather(S.data(), nq, MPI_DOUBLE, S_arr.data(), nq, MPI_DOUBLE, 0, c.comm);
+    trace_collective(c, "MPI_Gather", begin);
 
+    if (c.rank_mpi==0) {
+        for (int i=0; i<c.P; i++) {
+            SF_Grid(X(i), Y(i), Z(i), Range::all()) = S_arr(i, Range::all());
+        }
+    }
 }
 
+
 /**
  ********************************************************************************************************************************************
- * \brief   Function to read a 2D field from an hdf5 file.
- *
- *          This function reads an hdf5 file containing a 2D field, which can be the \f$ x \f$ or \f$ z \f$ component of a 2D velocity field. The dimensions of the
- *          2D field is \f$(N_x \times N_z)\f$, where \f$N_x\f$ and \f$N_z\f$ are the number of gridpoints in \f$ x \f$ and \f$ z \f$ directions respectively.
- *          The hdf5 file should have only
- *          one dataset, and the names of the hdf5 file and the dataset must be identical. This function makes use of the H5SI library for reading the
- *          hdf5 file.
+ * \brief   Function to gather the structure functions computed by all the processors for one displacement each into a 3D grid.
  *
- * \param   A is the 2D array to store the field that is read from the file.
- * \param   fold is the name of the folder in which the input files are kept.
- * \param   file is a string storing the name of the file to be read.
+ * \param SF_Grid is the 3D array storing the structure functions (used only on rank 0)
+ * \param x, z are the indices of the displacement of this processor
+ * \param S stores the structure functions of all the orders for this displacement (or any other values of the last dimension of SF_Grid)
  ********************************************************************************************************************************************
  */
-void read_2D(Array<double,2> A, string fold, string file, string dset) {
-  ifstream file_name(fold+file+".h5");
-  h5::File f(fold+file+".h5", "r");
-  f[dset] >> A.data();
-}
+void gather_SF_2D(SF_context& c, Array<double,3> SF_Grid, int x, int z, Array<double,1> S)
+{
+    int nq = S.size();
+    Array<int, 1> X, Z;
+    Array<double, 2> S_arr;
+
+    if (c.rank_mpi==0) {
+        X.resize(c.P);
+        Z.resize(c.P);
+        S_arr.resize(c.P, nq);
+    }
 
+    double begin = trace_clock();
+    MPI_Gather(&x, 1, MPI_INT, X.data(), 1, MPI_INT, 0, c.comm);
+    MPI_Gather(&z, 1, MPI_INT, Z.data(), 1, MPI_INT, 0, c.comm);
+    MPI_Gather(S.data(), nq, MPI_DOUBLE, S_arr.data(), nq, MPI_DOUBLE, 0, c.comm);
+    trace_collective(c, "MPI_Gather", begin);
 
+    if (c.rank_mpi==0) {
+        for (int i=0; i<c.P; i++) {
+            SF_Grid(X(i), Z(i), Range::all()) = S_arr(i, Range::all());
+        }
+    }
+}
 
 
 /**
  ********************************************************************************************************************************************
- * \brief   Function to read a 3D field from an hdf5 file.
+ * \brief   Function to return the velocity at a grid point, whatever the layout of the velocity field.
  *
- *          This function reads an hdf5 file containing a 4D field, which can be the \f$ x \f$, \f$ y \f$, or \f$ z \f$ component of a 3D velocity field. The dimensions of the
- *          3D field is \f$(N_x \times N_y \times N_z)\f$, where \f$N_x\f$, \f$N_y\f$, and \f$N_z\f$ are the number of gridpoints in \f$ x \f$, \f$ y \f$, and \f$ z \f$ directions
- *          respectively. The hdf5 file should
- *          have only one dataset, and the names of the hdf5 file and the dataset must be identical. This function makes use of the H5SI library for
- *          reading the hdf5 file.
- *
- * \param A is the 3D array to store the field that is read from the file.
- * \param fold is the name of the folder in which the input files are kept.
- * \param file is a string storing the name of the file to be read.
- * \param dset is the name of the dataset storing the input field.
+ * \param i, j, k are the indices of the grid point (j is ignored for 2D fields)
+ * \param u stores the three components of the velocity (the y-component is 0 for 2D fields)
  ********************************************************************************************************************************************
  */
-void read_3D(Array<double,3> A, string fold, string file, string dset) {
-	ifstream file_name(fold+file+".h5");
-	h5::File f(fold+file+".h5", "r");
-	f[dset] >> A.data();
+void velocity_at(SF_context& c, int i, int j, int k, double* u)
+{
+    if (c.two_dimension_switch) {
+        u[0] = c.V1_2D(i, k);
+        u[1] = 0;
+        u[2] = c.V3_2D(i, k);
+    }
+    else if (c.V_packed.size() > 0) {
+        long n = 4*(c.point_offset_x(i) + c.point_offset_y(j) + c.point_offset_z(k));
+        u[0] = c.V_packed(n);
+        u[1] = c.V_packed(n+1);
+        u[2] = c.V_packed(n+2);
+    }
+    else {
+        u[0] = c.V1(i, j, k);
+        u[1] = c.V2(i, j, k);
+        u[2] = c.V3(i, j, k);
+    }
 }
 
 
 /**
-***********************************************************************************************************************************
-* \brief Function to outputs the run-time instructions for the user
-*
-***********************************************************************************************************************************
-*/
+ ********************************************************************************************************************************************
+ * \brief   Function to compute the joint PDFs of the longitudinal and transverse increments, and of the longitudinal and scalar increments,
+ *          at the selected displacements.
+ *
+ *          The displacements are shared among the processors. For each displacement, all the pairs of points are visited twice by the
+ *          OpenMP threads: once to find the range of the increments, over which the bins are spread uniformly, and once to fill the
+ *          histograms, each thread filling a private copy that is added to the shared one at the end. The histograms are reduced on rank 0
+ *          and normalized to PDFs. The transverse increment is the magnitude of the transverse part of the velocity increment.
+ ********************************************************************************************************************************************
+ */
+void joint_pdfs(SF_context& c)
+{
+    int ns = c.pdf_separations.size();
+    int n1 = c.pdf_bins[0], n2 = c.pdf_bins[1];
+    bool perp = not c.longitudinal, scalar = c.pdf_scalar;
+    int Ny = c.two_dimension_switch ? 1 : c.Ny;
+
+    Joint_pdfs& J = c.joint_pdf;
+    J.separations.resize(ns, 3);
+    J.count.resize(ns);
+    J.edges_pll.resize(ns, n1+1);
+    J.edges_perp.resize(ns, perp ? n2+1 : 0);
+    J.edges_scalar.resize(ns, scalar ? n2+1 : 0);
+    J.pll_perp.resize(ns, n1, perp ? n2 : 0);
+    J.pll_scalar.resize(ns, n1, scalar ? n2 : 0);
+    J.separations = 0;
+    J.count = 0;
+    J.edges_pll = 0;
+    J.edges_perp = 0;
+    J.edges_scalar = 0;
+    J.pll_perp = 0;
+    J.pll_scalar = 0;
+
+    for (int s=c.rank_mpi; s<ns; s+=c.P) {
+        const vector<int>& l = c.pdf_separations[s];
+        int x = l[0], y = c.two_dimension_switch ? 0 : l[1], z = l.back();
+        double lx = x*c.dx, ly = y*c.dy, lz = z*c.dz;
+        double r = sqrt(lx*lx+ly*ly+lz*lz);
+        long my = Ny-y, mz = c.Nz-z;
+        long m = (c.Nx-x)*my*mz;
+
+        //Longitudinal, transverse and scalar increments of the n-th pair
+        auto increments = [&](long n, double* d) {
+            int i = n/(my*mz), j = (n/mz)%my, k = n%mz;
+            double u1[3], u2[3];
+            velocity_at(c, i, j, k, u1);
+            velocity_at(c, i+x, j+y, k+z, u2);
+            double du[3] = {u2[0]-u1[0], u2[1]-u1[1], u2[2]-u1[2]};
+            d[0] = (du[0]*lx+du[1]*ly+du[2]*lz)/r;
+            d[1] = sqrt(pow(du[0]-d[0]*lx/r,2)+pow(du[1]-d[0]*ly/r,2)+pow(du[2]-d[0]*lz/r,2));
+            d[2] = scalar ? c.pdf_T[(long(i+x)*Ny+j+y)*c.Nz+k+z]-c.pdf_T[(long(i)*Ny+j)*c.Nz+k] : 0;
+        };
+
+        double lo[3] = {HUGE_VAL, HUGE_VAL, HUGE_VAL}, hi[3] = {-HUGE_VAL, -HUGE_VAL, -HUGE_VAL};
+        #pragma omp parallel for schedule(static) reduction(min:lo[:3]) reduction(max:hi[:3]) num_threads(c.team_size)
+        for (long n=0; n<m; n++) {
+            double d[3];
+            increments(n, d);
+            for (int a=0; a<3; a++) {
+                lo[a] = min(lo[a], d[a]);
+                hi[a] = max(hi[a], d[a]);
+            }
+        }
+        int nbins[3] = {n1, n2, n2};
+        double width[3];
+        for (int a=0; a<3; a++) {
+            if (hi[a] <= lo[a]) {
+                hi[a] = lo[a]+1;
+            }
+            width[a] = (hi[a]-lo[a])/nbins[a];
+        }
 
+        #pragma omp parallel num_threads(c.team_size)
+        {
+            vector<double> H_perp(perp ? n1*n2 : 0), H_scalar(scalar ? n1*n2 : 0);
+            #pragma omp for schedule(static)
+            for (long n=0; n<m; n++) {
+                double d[3];
+                increments(n, d);
+                int b[3];
+                for (int a=0; a<3; a++) {
+                    b[a] = min(nbins[a]-1, int((d[a]-lo[a])/width[a]));
+                }
+                if (perp) {
+                    H_perp[b[0]*n2+b[1]] += 1;
+                }
+                if (scalar) {
+                    H_scalar[b[0]*n2+b[2]] += 1;
+                }
+            }
+            #pragma omp critical
+            {
+                for (int i=0; i<n1; i++) {
+                    for (int k=0; k<n2; k++) {
+                        if (perp) {
+                            J.pll_perp(s, i, k) += H_perp[i*n2+k]/(m*width[0]*width[1]);
+                        }
+                        if (scalar) {
+                            J.pll_scalar(s, i, k) += H_scalar[i*n2+k]/(m*width[0]*width[2]);
+                        }
+                    }
+                }
+            }
+        }
 
-void help_command(){
-	if(rank_mpi==0){
-		cout<<"### iii) Running Instructions and Command-Line Arguments \n \
-		To run `fastSF`, change to `fastSF` directory. Ensure that the input\n\
-		hdf5 files follow the schema described in the previous subsection. \n\
-		If you want all the relevant parameters to be read from 'in/para.yaml', \n\
-		you can simply type the following: `mpirun -np [number of MPI processors] src/fastSF.out`\n\
-		`fastSF` allows the user to pass the input parameters using command line arguments as well.\n \
-		If inputs are provided via the command-line, the corresponding inputs read from the 'in/para.yaml'\n\
-		file get overriden. The user can also specify the input and output hdf5 file names via the \n\
-		command-line. The command line arguments are given as follows:\n\n\n\
-		`mpirun -np [number of MPI processors] src/fastSF.out -s [scalar_switch]` \n\
-		`-d [2D_switch] -l [Only_longitudinal] -p [Processors_X] -X [Nx] -Y [Ny]`\n\
-		`-Z [Nz] -x [Lx] -y [Ly] -z [Lz] -1 [q1] -2 [q2] -t [test_switch]`\n\
-		`-U [Name of the hdf5 file storing Ux]`\n\
-		`-V [Name of the hdf5 file storing Uy]`\n\
-		`-W [Name of the hdf5 file storing Uz]`\n\
-		`-Q [Name of the hdf5 file storing T]`\n\
-		`-u [Name of the dataset storing Ux]`\n\
-		`-v [Name of the dataset storing Uy]`\n\
-		`-w [Name of the dataset storing Uz]`\n\
-		`-q [Name of the dataset storing T]`\n\
-		`-P [Name of the hdf5 file storing the transverse structure functions]`\n\
-		`-L [Name of the hdf5 file storing the longitudinal structure functions]\
-        `-h [Help]`\n\n\n\
-		The user need not give all the command line arguments; the arguments that \n\
-		are not provided will be read by the `in/para.yaml` file. For, if the user wants \n\
-		to run `fastSF` with 16 processors with 4 processors in x direction, and wants to compute\n\
-		only the longitudinal structure functions, the following command should be entered:\n\
-		`mpirun -np 16 ./src/fastSF.out -p 4 -l true`\n\
-		In this case, the number of processors in the x-direction and the longitudinal\n\
-		structure function switch will be taken via the command line. The rest of the parameters \n\
-		will be taken from the `in/para.yaml` file.";
-	}
+        J.separations(s, 0) = x;
+        J.separations(s, 1) = y;
+        J.separations(s, 2) = z;
+        J.count(s) = m;
+        for (int i=0; i<=n1; i++) {
+            J.edges_pll(s, i) = lo[0]+i*width[0];
+        }
+        for (int k=0; k<=n2; k++) {
+            if (perp) {
+                J.edges_perp(s, k) = lo[1]+k*width[1];
+            }
+            if (scalar) {
+                J.edges_scalar(s, k) = lo[2]+k*width[2];
+            }
+        }
+    }
+
+    double* data[] = {J.separations.data(), J.count.data(), J.edges_pll.data(), J.edges_perp.data(), J.edges_scalar.data(),
+                      J.pll_perp.data(), J.pll_scalar.data()};
+    long size[] = {J.separations.size(), J.count.size(), J.edges_pll.size(), J.edges_perp.size(), J.edges_scalar.size(),
+                   J.pll_perp.size(), J.pll_scalar.size()};
+    for (int i=0; i<7; i++) {
+        if (c.rank_mpi==0) {
+            MPI_Reduce(MPI_IN_PLACE, data[i], size[i], MPI_DOUBLE, MPI_SUM, 0, c.comm);
+        }
+        else {
+            MPI_Reduce(data[i], NULL, size[i], MPI_DOUBLE, MPI_SUM, 0, c.comm);
+        }
+    }
+    c.pdf_T.clear();
+    c.pdf_T.shrink_to_fit();
+    if (c.rank_mpi!=0) {
+        J.separations.free();
+        J.count.free();
+        J.edges_pll.free();
+        J.edges_perp.free();
+        J.edges_scalar.free();
+        J.pll_perp.free();
+        J.pll_scalar.free();
+    }
 }
 
+
 /**
  ********************************************************************************************************************************************
- * \brief   Function to parse the parameters from the yaml file and from the command-line arguments.
+ * \brief   Function to return the two transverse directions of a displacement relative to transverse_axis.
  *
- * \param   argc is the number of command-line arguments passed by the user including the name of the program.
- * \param   argv is the array of character pointers listing all the arguments.
+ *          The first direction is that of the part of the axis normal to the displacement, and the second one is the cross product of the
+ *          direction of the displacement with the first. If the displacement is parallel to the axis, the part of the grid axis least
+ *          aligned with the displacement normal to it is used instead.
  *
+ * \param lx, ly, lz are the components of the displacement
+ * \param e1, e2 store the unit vectors of the two transverse directions
  ********************************************************************************************************************************************
  */
-void get_Inputs(int argc, char* argv[]) {
-    YAML::Node para;
-    ifstream para_yaml,input_field;
-    string para_path="in/para.yaml";
-    para_yaml.open(para_path.c_str());
-  
-    if (para_yaml.is_open())
-    {
-      try
-      {
-        YAML::Parser parser(para_yaml);
-        parser.GetNextDocument(para);
-      }
-      catch(YAML::ParserException& e)
-      {
-        cerr << "Global::Parse: Error reading parameter file: \n" << e.what() << endl;
-      }
-  
-    }
-    else
-    {
-      cerr << "Global::Parse: Unable to open '" + para_path + "'." << endl;
-      h5::finalize();
-      MPI_Finalize();
-      exit(1);
-    }
-    para["program"]["scalar_switch"]>>scalar_switch;
-    para["program"]["Only_longitudinal"]>>longitudinal;
-    para["program"]["2D_switch"]>>two_dimension_switch;
-    para["program"]["Processors_X"]>>px;
-
-    para["test"]["test_switch"]>>test_switch;
-    
-    if (test_switch){
-    	para["grid"]["Nx"]>>Nx;
-    	para["grid"]["Ny"]>>Ny;
-    	para["grid"]["Nz"]>>Nz;
-	}
-    para["domain_dimension"]["Lx"]>>Lx;
-    para["domain_dimension"]["Ly"]>>Ly;
-    para["domain_dimension"]["Lz"]>>Lz;
-  
-    para["structure_function"]["q1"]>>q1;
-    para["structure_function"]["q2"]>>q2;
-    
-  
-    int option;
-    while ((option=getopt(argc, argv, "X:Y:Z:1:2:x:y:z:l:d:p:t:s:U:V:W:Q:P:L:M:h:u:v:w:q:"))!=-1){
-    	switch(option){
-    		case 'h':
-    			help_command();
-    			exit(1);
-    			break;
-    		case 'X':
-    			Nx=std::stoi(optarg);
-    			break;
-    		case 'Y':
-    			Ny=std::stoi(optarg);
-    			break;
-    		case 'Z':
-    			Nz=std::stoi(optarg);
-    			break;
-    		case 'x':
-    			Lx=std::stod(optarg);
-    			break;
-    		case 'y':
-    			Ly=std::stod(optarg);
-    			break;
-    		case 'z':
-    			Lz=std::stod(optarg);
-    			break;
-    		case 'p':
-    			px=std::stod(optarg);
-    			break;
-    		case '1':
-    			q1=std::stod(optarg);
-    			break;
-    		case '2':
-    			q2=std::stod(optarg);
-    			break;
-    		case 't':
-    			test_switch=str_to_bool(optarg);
-    			break;
-    		case 's':
-    			scalar_switch=str_to_bool(optarg);
-    			break;
-    		case 'd':
-    			two_dimension_switch=str_to_bool(optarg);
-    			break;
-    		case 'l':
-    			longitudinal=str_to_bool(optarg);
-    			break;
-            case 'U':
-                UName = optarg;
-                break;
-            case 'V':
-                VName = optarg;
-                break;
-            case 'W':
-                WName = optarg;
-                break;
-            case 'Q':
-                TName = optarg;
-                break;
-            case 'u':
-                UdName = optarg;
-                break;
-            case 'v':
-                VdName = optarg;
-                break;
-            case 'w':
-                WdName = optarg;
-                break;
-            case 'q':
-                TdName = optarg;
-                break;
-            case 'P':
-                SF_Grid_perp_name = optarg;
-                break;
-            case 'L':
-                SF_Grid_pll_name = optarg;
-                break;
-            case 'M':
-                SF_Grid_scalar_name = optarg;
-                break;
-            default:
-                if (rank_mpi==0){
-                    cout<<"\nNo command line options given; reading all the inputs from para.yaml.\n";
-                }
-    	}
-    }
-
-  
+void transverse_basis(SF_context& c, double lx, double ly, double lz, double* e1, double* e2)
+{
+    double r = sqrt(lx*lx+ly*ly+lz*lz);
+    double el[3] = {lx/r, ly/r, lz/r};
+    double a[3] = {c.transverse_axis[0], c.transverse_axis[1], c.transverse_axis[2]};
+    double norm_a = sqrt(a[0]*a[0]+a[1]*a[1]+a[2]*a[2]);
+    for (int pass=0; pass<2; pass++) {
+        double al = a[0]*el[0]+a[1]*el[1]+a[2]*el[2];
+        for (int d=0; d<3; d++) {
+            e1[d] = a[d]-al*el[d];
+        }
+        double norm = sqrt(e1[0]*e1[0]+e1[1]*e1[1]+e1[2]*e1[2]);
+        if (norm > 1e-12*norm_a) {
+            for (int d=0; d<3; d++) {
+                e1[d] /= norm;
+            }
+            break;
+        }
+        int least = 0;
+        for (int d=1; d<3; d++) {
+            if (fabs(el[d]) < fabs(el[least])) {
+                least = d;
+            }
+        }
+        a[0] = a[1] = a[2] = 0;
+        a[least] = norm_a = 1;
+    }
+    e2[0] = el[1]*e1[2]-el[2]*e1[1];
+    e2[1] = el[2]*e1[0]-el[0]*e1[2];
+    e2[2] = el[0]*e1[1]-el[1]*e1[0];
 }
 
 
 /**
  ********************************************************************************************************************************************
- * \brief   Function to generate an idealized 3D velocity field.
+ * \brief   Function to loop over the displacements assigned to this processor for a 3D field.
  *
- *          This function generates the following 3D velocity field.
- *          \f$u_x = x, \quad u_y = y, \quad u_z = z\f$.
+ *          For every displacement, the sums of the powers of the increments are obtained from the given function, normalized by the number
+ *          of pairs and gathered on rank 0.
  *
- * \param Ux is a 3D array representing the x-component of 3D velocity field.
- * \param Uy is a 3D array representing the y-component of 3D velocity field.
- * \param Uz is a 3D array representing the z-component of 3D velocity field.
+ * \param SF_Grid1 is the 4D array storing the (longitudinal or scalar) structure functions
+ * \param SF_Grid2 is the 4D array storing the transverse structure functions
+ * \param Err1, Err2 are the 4D arrays storing the standard errors of SF_Grid1 and SF_Grid2 (filled if error_blocks is larger than 1)
+ * \param Cond1, Cond2 are the 5D arrays storing the conditional structure functions of SF_Grid1 and SF_Grid2 (filled if conditioned)
+ * \param two_grids decides whether SF_Grid2 is to be filled
+ * \param moments computes the sums for a displacement (x, y, z) per group of base points into its fourth and fifth arguments, and the sums
+ *          of the component structure functions (see SF_Grid_comp) into its last argument
  ********************************************************************************************************************************************
  */
-void Read_Init(Array<double,3>& Ux, Array<double,3>& Uy, Array<double,3>& Uz){
-  if (rank_mpi==0)
-  {cout<<"\nGenerating the 3D velocity field: U = [x, y, z] \n";
-  }
-  for (int i=0; i<Nx; i++){
-      for (int j=0; j<Ny; j++){
-        for (int k=0; k<Nz; k++){
-            Ux(i, j, k) = i*dx;
-            Uy(i, j, k) = j*dy;
-            Uz(i, j, k) = k*dz;
-          }
+void displacement_loop_3D(
+        SF_context& c,
+        Array<double,4> SF_Grid1,
+        Array<double,4> SF_Grid2,
+        Array<double,4> Err1,
+        Array<double,4> Err2,
+        Array<double,5> Cond1,
+        Array<double,5> Cond2,
+        bool two_grids,
+        const function<void(int, int, int, Array<double,1>, Array<double,1>, Array<double,1>)>& moments)
+{
+    int nq = num_orders(c);
+
+    Array<int, 3> schedule;
+    compute_schedule(c, schedule);
+    Array<double,1> S1(sum_size(c)), S2(sum_size(c)), S3(5*nq);
+    Array<double,1> E1(nq), E2(nq);
+    bool components = not c.transverse_axis.empty() and not c.scalar_switch;
+    Array<double,2> C1(max(1,c.conditional_bins), nq), C2(max(1,c.conditional_bins), nq);
+    vector<double> count;
+
+    for (int st=c.first_step; st<schedule.extent(0); st++){
+        if (out_of_time(c, st)) {
+            break;
+        }
+        int x=schedule(st, 0, c.rank_mpi);
+        int y=schedule(st, 1, c.rank_mpi);
+        int z=schedule(st, 2, c.rank_mpi);
+        S1 = 0;
+        S2 = 0;
+        S3 = 0;
+        perf_start(c);
+        if (displacement_selected(c, x)) {
+            moments(x, y, z, S1, S2, S3);
+        }
+        perf_stop(c);
+        if (c.conditional_bins > 0) {
+            vector<double> groups(S1.data()+num_groups(c)*nq, S1.data()+S1.size());
+            conditional_statistics(c, S1, groups, C1, count);
+            conditional_statistics(c, S2, groups, C2, count);
+        }
+        else {
+            block_counts(c, x, y, z, pyramid_stride(c, x, y, z), count);
+            if (not displacement_selected(c, x)) {
+                count.assign(count.size(), 0);
+            }
         }
+        block_statistics(c, S1, count, E1);
+        block_statistics(c, S2, count, E2);
+        double total = accumulate(count.begin(), count.end(), 0.0);
+        c.perf_pairs += total;
+        accumulate_angular(c, x, y, z, total, S1, S2, two_grids);
+
+        gather_SF_3D(c, SF_Grid1, x, y, z, S1(Range(0,nq-1)));
+        if (two_grids) {
+            gather_SF_3D(c, SF_Grid2, x, y, z, S2(Range(0,nq-1)));
+        }
+        if (c.write_sums) {
+            Array<double,1> N(1);
+            N(0) = total;
+            gather_SF_3D(c, c.SF_count, x, y, z, N);
+        }
+        if (c.error_blocks > 1) {
+            gather_SF_3D(c, Err1, x, y, z, E1);
+            if (two_grids) {
+                gather_SF_3D(c, Err2, x, y, z, E2);
+            }
+        }
+        for (int n=0; n<5 and components; n++) {
+            Array<double,4> none;
+            S3(Range(n*nq,n*nq+nq-1)) /= max(total, 1.0);
+            gather_SF_3D(c, c.rank_mpi==0 ? c.SF_Grid_comp(n,Range::all(),Range::all(),Range::all(),Range::all()) : none, x, y, z, S3(Range(n*nq,n*nq+nq-1)));
+        }
+        for (int b=0; b<c.conditional_bins; b++) {
+            Array<double,4> none;
+            gather_SF_3D(c, c.rank_mpi==0 ? Cond1(b,Range::all(),Range::all(),Range::all(),Range::all()) : none, x, y, z, C1(b,Range::all()));
+            if (two_grids) {
+                gather_SF_3D(c, c.rank_mpi==0 ? Cond2(b,Range::all(),Range::all(),Range::all(),Range::all()) : none, x, y, z, C2(b,Range::all()));
+            }
+        }
+        trace_step(c, st, false);
+        flush_progress(c, st);
     }
-    if (rank_mpi==0)
-    {cout<<"\nField has been generated.\n";
+    if (c.rank_mpi==0) {
+        SF_Grid1(0,0,0,Range::all())=0;
+        if (two_grids) {
+            SF_Grid2(0,0,0,Range::all())=0;
+        }
     }
 }
 
+
 /**
  ********************************************************************************************************************************************
- * \brief   Function to generate an idealized 2D velocity field.
- *
- *          This function generates the following 2D velocity field.
- *          \f$u_x = x, \quad u_z = z\f$.
+ * \brief   Function to compute the sums of the powers of the velocity increments for one displacement using the planar layout.
  *
- * \param Ux is a 2D array representing the x-component of 2D velocity field.
- * \param Uz is a 2D array representing the z-component of 2D velocity field.
+ * \param Ux is a 3D array representing the x-component of velocity field
+ * \param Uy is a 3D array representing the y-component of velocity field
+ * \param Uz is a 3D array representing the z-component of velocity field
+ * \param x, y, z are the indices of the displacement
+ * \param Spll stores the sums for the longitudinal increments
+ * \param Sperp stores the sums for the transverse increments
+ * \param Scomp stores the sums for the component increments (see SF_Grid_comp), computed if transverse_axis is given
+ * \param transverse decides whether the transverse increments are computed
  ********************************************************************************************************************************************
  */
-void Read_Init(Array<double,2>& Ux, Array<double,2>& Uz){
-	if (rank_mpi==0){
-		cout<<"\nGenerating the 2D velocity field: U = [x, z] \n";
-	}
-    for (int i=0;i<Nx;i++){
-      for (int k=0;k<Nz;k++){
-          Ux(i, k) = i*dx;
-          Uz(i, k) = k*dz;
-       }
-  }
-  if (rank_mpi==0)
-    {cout<<"\nField has been generated.\n";
+void moments_3D_planar(
+        SF_context& c,
+        Array<double,3> Ux,
+        Array<double,3> Uy,
+        Array<double,3> Uz,
+        int x, int y, int z,
+        Array<double,1> Spll,
+        Array<double,1> Sperp,
+        Array<double,1> Scomp,
+        bool transverse)
+{
+    int nx=Ux.extent(0), ny=Ux.extent(1), nz=Ux.extent(2);
+    double lx=x*c.dx;
+    double ly=y*c.dy;
+    double lz=z*c.dz;
+    double r=sqrt(lx*lx+ly*ly+lz*lz);
+    if (r == 0) {
+        return;
+    }
+
+    int f=pyramid_stride(c, x, y, z);
+    int mx=(nx-x-1)/f+1, my=(ny-y-1)/f+1, mz=(nz-z-1)/f+1;
+    Array<double,3> dUx(mx,my,mz);
+    Array<double,3> dUy(mx,my,mz);
+    Array<double,3> dUz(mx,my,mz);
+    Array<double,3> dUpll(mx,my,mz);
+
+    dUx(Range::all(),Range::all(),Range::all())=Ux(Range(x,nx-1,f),Range(y,ny-1,f),Range(z,nz-1,f))-Ux(Range(0,nx-x-1,f),Range(0,ny-y-1,f),Range(0,nz-z-1,f));
+    dUy(Range::all(),Range::all(),Range::all())=Uy(Range(x,nx-1,f),Range(y,ny-1,f),Range(z,nz-1,f))-Uy(Range(0,nx-x-1,f),Range(0,ny-y-1,f),Range(0,nz-z-1,f));
+    dUz(Range::all(),Range::all(),Range::all())=Uz(Range(x,nx-1,f),Range(y,ny-1,f),Range(z,nz-1,f))-Uz(Range(0,nx-x-1,f),Range(0,ny-y-1,f),Range(0,nz-z-1,f));
+
+    dUpll=(lx*dUx+ly*dUy+lz*dUz)/r;
+    block_sums_3D(c, dUpll, nx, ny, nz, f, Spll);
+
+    if (not c.transverse_axis.empty()) {
+        double e1[3], e2[3];
+        transverse_basis(c, lx, ly, lz, e1, e2);
+        int nq = num_orders(c);
+        Array<double,3> dU1(mx,my,mz), dU2(mx,my,mz);
+        dU1 = e1[0]*dUx+e1[1]*dUy+e1[2]*dUz;
+        dU2 = e2[0]*dUx+e2[1]*dUy+e2[2]*dUz;
+        add_power_sums(c, dUx, Scomp.data());
+        add_power_sums(c, dUy, Scomp.data()+nq);
+        add_power_sums(c, dUz, Scomp.data()+2*nq);
+        add_power_sums(c, dU1, Scomp.data()+3*nq);
+        add_power_sums(c, dU2, Scomp.data()+4*nq);
+    }
+
+    if (transverse) {
+        dUx=dUx-dUpll*lx/r;
+        dUy=dUy-dUpll*ly/r;
+        dUz=dUz-dUpll*lz/r;
+
+        dUx=pow(dUx*dUx+dUy*dUy+dUz*dUz,0.5);
+        block_sums_3D(c, dUx, nx, ny, nz, f, Sperp);
     }
 }
 
+
 /**
  ********************************************************************************************************************************************
- * \brief   Function to generate an idealized 2D scalar field.
+ * \brief   Function to compute the sums of the powers of the velocity increments for one displacement using the packed layout.
  *
- *          This function generates the following 2D scalar field.
- *          \f$\theta = x + z \f$
+ *          The field is stored in the interleaved layout, row-major or in bricks (see pack_fields()). The increments are computed point
+ *          by point from the two shifted copies of the packed field, so that only two memory streams are read. The base points are visited
+ *          tile by tile (the tiles being the bricks if the bricked storage is used), and the tiles are shared among the OpenMP threads.
  *
- * \param T is a 2D array representing the x-component of 2D velocity field.
+ * \param U is a 1D array storing the three components of velocity field per grid point
+ * \param x, y, z are the indices of the displacement
+ * \param Spll stores the sums for the longitudinal increments
+ * \param Sperp stores the sums for the transverse increments
+ * \param Scomp stores the sums for the component increments (see SF_Grid_comp), computed if transverse_axis is given
+ * \param transverse decides whether the transverse increments are computed
  ********************************************************************************************************************************************
  */
-void Read_Init(Array<double,2>& T) {
-	if (rank_mpi==0){
-		cout<<"\nGenerating the scalar field: T = x + z \n";
-	}
-    for (int i=0;i<Nx;i++){
-      for (int k=0;k<Nz;k++){
-          T(i, k) = i*dx + k*dz;
-       }
-  }
-  if (rank_mpi==0)
-    {cout<<"\nField has been generated.\n";
+void moments_3D_packed(
+        SF_context& c,
+        Array<double,1> U,
+        int x, int y, int z,
+        Array<double,1> Spll,
+        Array<double,1> Sperp,
+        Array<double,1> Scomp,
+        bool transverse)
+{
+    double lx=x*c.dx;
+    double ly=y*c.dy;
+    double lz=z*c.dz;
+    double r=sqrt(lx*lx+ly*ly+lz*lz);
+    if (r == 0) {
+        return;
+    }
+
+    int nq = num_orders(c);
+    int tile = c.brick_size>0 ? c.brick_size : c.tile_size;
+    int tile_z = c.brick_size>0 ? c.brick_size : c.Nz;
+    int f = pyramid_stride(c, x, y, z);
+    const double* u = U.data();
+    const long* ox = c.point_offset_x.data();
+    const long* oy = c.point_offset_y.data();
+    const long* oz = c.point_offset_z.data();
+    double* Sp = Spll.data();
+    double* Sq = Sperp.data();
+    double* Sc = Scomp.data();
+    int ns = Spll.size(), nc = Scomp.size();
+    bool components = not c.transverse_axis.empty();
+    double e1[3], e2[3];
+    if (components) {
+        transverse_basis(c, lx, ly, lz, e1, e2);
+    }
+    int nt = num_groups(c)*nq;
+    const int* cg = c.conditional_group.empty() ? NULL : c.conditional_group.data();
+    vector<int> bx, by, bz;
+    block_offsets(c, bx, by, bz);
+
+    #pragma omp parallel for collapse(2) schedule(dynamic) reduction(+:Sp[:ns], Sq[:ns], Sc[:nc]) num_threads(c.team_size)
+    for (int ti=0; ti<c.Nx-x; ti+=tile) {
+        for (int tj=0; tj<c.Ny-y; tj+=tile) {
+            for (int tk=0; tk<c.Nz-z; tk+=tile_z) {
+                for (int i=ti+(f-ti%f)%f; i<min(ti+tile, c.Nx-x); i+=f) {
+                    for (int j=tj+(f-tj%f)%f; j<min(tj+tile, c.Ny-y); j+=f) {
+                        long a_ij = ox[i] + oy[j];
+                        long b_ij = ox[i+x] + oy[j+y];
+                        long r_ij = (long(i)*c.Ny+j)*c.Nz;
+                        for (int k=tk+(f-tk%f)%f; k<min(tk+tile_z, c.Nz-z); k+=f) {
+                            const double* a = u + 4*(a_ij + oz[k]);
+                            const double* b = u + 4*(b_ij + oz[k+z]);
+                            int g = bx[i] + by[j] + bz[k];
+                            if (cg) {
+                                g += cg[r_ij+k];
+                                Sp[nt+g] += 1;
+                            }
+                            double dUx = b[0] - a[0];
+                            double dUy = b[1] - a[1];
+                            double dUz = b[2] - a[2];
+                            double dUpll = (lx*dUx+ly*dUy+lz*dUz)/r;
+                            add_powers(c, dUpll, Sp + g*nq);
+                            if (components) {
+                                add_powers(c, dUx, Sc);
+                                add_powers(c, dUy, Sc + nq);
+                                add_powers(c, dUz, Sc + 2*nq);
+                                add_powers(c, e1[0]*dUx+e1[1]*dUy+e1[2]*dUz, Sc + 3*nq);
+                                add_powers(c, e2[0]*dUx+e2[1]*dUy+e2[2]*dUz, Sc + 4*nq);
+                            }
+                            if (transverse) {
+                                dUx -= dUpll*lx/r;
+                                dUy -= dUpll*ly/r;
+                                dUz -= dUpll*lz/r;
+                                add_powers(c, sqrt(dUx*dUx+dUy*dUy+dUz*dUz), Sq + g*nq);
+                            }
+                        }
+                    }
+                }
+            }
+        }
     }
 }
 
+
 /**
  ********************************************************************************************************************************************
- * \brief   Function to generate an idealized 3D scalar field.
+ * \brief   Function to compute the sums of the powers of the scalar increments for one displacement.
  *
- *          This function generates the following 2D scalar field.
- *          \f$\theta = x + y + z \f$
+ * \param T is a 3D array representing the scalar field
+ * \param x, y, z are the indices of the displacement
+ * \param St stores the sums
+ ********************************************************************************************************************************************
+ */
+void moments_scalar_3D_planar(SF_context& c, Array<double,3> T, int x, int y, int z, Array<double,1> St)
+{
+    int nx=T.extent(0), ny=T.extent(1), nz=T.extent(2);
+    int f=pyramid_stride(c, x, y, z);
+    Array<double,3> dT((nx-x-1)/f+1,(ny-y-1)/f+1,(nz-z-1)/f+1);
+
+    dT(Range::all(),Range::all(),Range::all())=T(Range(x,nx-1,f),Range(y,ny-1,f),Range(z,nz-1,f))-T(Range(0,nx-x-1,f),Range(0,ny-y-1,f),Range(0,nz-z-1,f));
+    block_sums_3D(c, dT, nx, ny, nz, f, St);
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to compute the sums of the powers of the scalar increments for one displacement using the bricked layout.
  *
- * \param T is a 3D array representing the x-component of 2D velocity field.
+ * \param T is a 1D array storing the scalar field in the bricked layout
+ * \param x, y, z are the indices of the displacement
+ * \param St stores the sums
  ********************************************************************************************************************************************
  */
-void Read_Init(Array<double,3>& T) {
-	if (rank_mpi==0){
-		cout<<"\nGenerating the scalar field: T = x + y + z \n";
-	}
-    for (int i=0;i<Nx;i++){
-      for (int j=0;j<Ny;j++){
-          for (int k=0;k<Nz;k++){
-              T(i, j, k) = i*dx + j*dy + k*dz;
-          }
-      }
-  }
-  if (rank_mpi==0)
-    {cout<<"\nField has been generated.\n";
+void moments_scalar_3D_packed(SF_context& c, Array<double,1> T, int x, int y, int z, Array<double,1> St)
+{
+    int nq = num_orders(c);
+    int tile = c.brick_size>0 ? c.brick_size : c.tile_size;
+    int tile_z = c.brick_size>0 ? c.brick_size : c.Nz;
+    int f = pyramid_stride(c, x, y, z);
+    const double* t = T.data();
+    const long* ox = c.point_offset_x.data();
+    const long* oy = c.point_offset_y.data();
+    const long* oz = c.point_offset_z.data();
+    double* S = St.data();
+    int ns = St.size();
+    int nt = num_groups(c)*nq;
+    const int* cg = c.conditional_group.empty() ? NULL : c.conditional_group.data();
+    vector<int> bx, by, bz;
+    block_offsets(c, bx, by, bz);
+
+    #pragma omp parallel for collapse(2) schedule(dynamic) reduction(+:S[:ns]) num_threads(c.team_size)
+    for (int ti=0; ti<c.Nx-x; ti+=tile) {
+        for (int tj=0; tj<c.Ny-y; tj+=tile) {
+            for (int tk=0; tk<c.Nz-z; tk+=tile_z) {
+                for (int i=ti+(f-ti%f)%f; i<min(ti+tile, c.Nx-x); i+=f) {
+                    for (int j=tj+(f-tj%f)%f; j<min(tj+tile, c.Ny-y); j+=f) {
+                        long a_ij = ox[i] + oy[j];
+                        long b_ij = ox[i+x] + oy[j+y];
+                        long r_ij = (long(i)*c.Ny+j)*c.Nz;
+                        for (int k=tk+(f-tk%f)%f; k<min(tk+tile_z, c.Nz-z); k+=f) {
+                            int g = bx[i] + by[j] + bz[k];
+                            if (cg) {
+                                g += cg[r_ij+k];
+                                S[nt+g] += 1;
+                            }
+                            add_powers(c, t[b_ij + oz[k+z]] - t[a_ij + oz[k]], S + g*nq);
+                        }
+                    }
+                }
+            }
+        }
     }
 }
 
 
-
 /**
  ********************************************************************************************************************************************
  * \brief   Function to calculate the longitudinal and transverse structure functions for a 3D velocity field.
@@ -1867,88 +8332,18 @@ void Read_Init(Array<double,3>& T) {
  ********************************************************************************************************************************************
  */
 void SFunc3D(
+        SF_context& c,
         Array<double,3> Ux,
         Array<double,3> Uy,
         Array<double,3> Uz)
 {
-	if (rank_mpi==0) {
+    if (c.rank_mpi==0) {
         cout<<"\nComputing longitudinal and transverse S(lx, ly, lz) using 3D velocity field data..\n";
     }
-    int c_per_proc = Nx*Ny/(4*P);
-
-    Array<int, 3> index_list;
-    compute_index_list(index_list, Nx, Ny);
-    Array<double,3> dUx;
-    Array<double,3> dUy;
-    Array<double,3> dUz;
-    Array<double,3> dUpll;
-    
-    for (int ix=0; ix<c_per_proc; ix++){
-        int x=index_list(ix, 0, rank_mpi);
-        int y=index_list(ix, 1, rank_mpi);
-  		for(int z=0; z<Nz/2; z++){
-            
-  			dUx.resize(Nx-x,Ny-y,Nz-z);
-  			dUy.resize(Nx-x,Ny-y,Nz-z);
-  			dUz.resize(Nx-x,Ny-y,Nz-z);
-            dUpll.resize(Nx-x,Ny-y,Nz-z);
-        		
-        	int count=(Nx-x)*(Ny-y)*(Nz-z);
-        	double lx=x*dx;
-        	double ly=y*dy;
-        	double lz=z*dz;
-
-        	double r=sqrt(lx*lx+ly*ly+lz*lz);
-        	dUx(Range::all(),Range::all(),Range::all())=Ux(Range(x,Nx-1),Range(y,Ny-1),Range(z,Nz-1))-Ux(Range(0,Nx-x-1),Range(0,Ny-y-1),Range(0,Nz-z-1));
-        	dUy(Range::all(),Range::all(),Range::all())=Uy(Range(x,Nx-1),Range(y,Ny-1),Range(z,Nz-1))-Uy(Range(0,Nx-x-1),Range(0,Ny-y-1),Range(0,Nz-z-1));
-        	dUz(Range::all(),Range::all(),Range::all())=Uz(Range(x,Nx-1),Range(y,Ny-1),Range(z,Nz-1))-Uz(Range(0,Nx-x-1),Range(0,Ny-y-1),Range(0,Nz-z-1));
-        		
-        	
-            dUpll=(lx*dUx+ly*dUy+lz*dUz)/r;
-        
-        	dUx=dUx-dUpll*lx/r;
-        	dUy=dUy-dUpll*ly/r;
-        	dUz=dUz-dUpll*lz/r;
-
-            
-        	dUx=pow(dUx*dUx+dUy*dUy+dUz*dUz,0.5);
-            
-        	for (int p=0; p<=q2-q1; p++){
-        		double Spll = sum(pow(dUpll(Range::all(),Range::all(),Range::all()),q1+p))/(count);
-        		double Sperp =sum(pow(dUx(Range::all(),Range::all(),Range::all()),q1+p))/(count);
-                Array<int, 1> X, Y, Z, p_arr;
-                Array<double, 1> Spll_arr, Sperp_arr;
-                
-                if (rank_mpi==0) {
-                    X.resize(P);
-                    Y.resize(P);
-                    Z.resize(P);
-                    p_arr.resize(P);
-                    Spll_arr.resize(P);
-                    Sperp_arr.resize(P);
-                }
-        
-                MPI_Gather(&x, 1, MPI_INT, X.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&y, 1, MPI_INT, Y.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&z, 1, MPI_INT, Z.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&Spll, 1, MPI_DOUBLE, Spll_arr.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-                MPI_Gather(&p, 1, MPI_INT, p_arr.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&Sperp, 1, MPI_DOUBLE, Sperp_arr.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-
-                if (rank_mpi==0) {
-                    for (int i=0; i<P; i++) {
-                        SF_Grid_pll(X(i), Y(i), Z(i), p_arr(i)) = Spll_arr(i);
-                        SF_Grid_perp(X(i), Y(i), Z(i), p_arr(i)) = Sperp_arr(i);
-                    } 
-                }
-
-        	}
-  		}
-  	}
-    if (rank_mpi==0) {
-        SF_Grid_pll(0,0,0,Range::all())=0;
-        SF_Grid_perp(0,0,0,Range::all())=0;
-    }
+    displacement_loop_3D(c, c.SF_Grid_pll, c.SF_Grid_perp, c.SF_Grid_pll_err, c.SF_Grid_perp_err, c.SF_Grid_pll_cond, c.SF_Grid_perp_cond, true,
+        [&](int x, int y, int z, Array<double,1> Spll, Array<double,1> Sperp, Array<double,1> Scomp) {
+            moments_3D_planar(c, Ux, Uy, Uz, x, y, z, Spll, Sperp, Scomp, true);
+        });
 }
 
 
@@ -1962,76 +8357,94 @@ void SFunc3D(
  ********************************************************************************************************************************************
  */
 void SFunc_long_3D(
+        SF_context& c,
         Array<double,3> Ux,
         Array<double,3> Uy,
         Array<double,3> Uz)
 {
-if (rank_mpi==0) {
+    if (c.rank_mpi==0) {
         cout<<"\nComputing longitudinal S(lx, ly, lz) using 3D velocity field data..\n";
     }
-    
-    int c_per_proc = Nx*Ny/(4*P);
-
-    Array<int, 3> index_list;
-    compute_index_list(index_list, Nx, Ny);
-    Array<double,3> dUx;
-    Array<double,3> dUy;
-    Array<double,3> dUz;
-    Array<double,3> dUpll;
-    
-    for (int ix=0; ix<c_per_proc; ix++){
-        int x=index_list(ix, 0, rank_mpi);
-        int y=index_list(ix, 1, rank_mpi);
-  		for(int z=0; z<Nz/2; z++){
-  			dUx.resize(Nx-x,Ny-y,Nz-z);
-			dUy.resize(Nx-x,Ny-y,Nz-z);
-  			dUz.resize(Nx-x,Ny-y,Nz-z);
-            dUpll.resize(Nx-x,Ny-y,Nz-z);
-        		
-    		int count=(Nx-x)*(Ny-y)*(Nz-z);
-    		double lx=x*dx;
-    		double ly=y*dy;
-    		double lz=z*dz;
-
-    		double r=sqrt(lx*lx+ly*ly+lz*lz);
-    		dUx(Range::all(),Range::all(),Range::all())=Ux(Range(x,Nx-1),Range(y,Ny-1),Range(z,Nz-1))-Ux(Range(0,Nx-x-1),Range(0,Ny-y-1),Range(0,Nz-z-1));
-    		dUy(Range::all(),Range::all(),Range::all())=Uy(Range(x,Nx-1),Range(y,Ny-1),Range(z,Nz-1))-Uy(Range(0,Nx-x-1),Range(0,Ny-y-1),Range(0,Nz-z-1));
-    		dUz(Range::all(),Range::all(),Range::all())=Uz(Range(x,Nx-1),Range(y,Ny-1),Range(z,Nz-1))-Uz(Range(0,Nx-x-1),Range(0,Ny-y-1),Range(0,Nz-z-1));
-
-            dUpll=(lx*dUx+ly*dUy+lz*dUz)/r;
-        		
-
-    		for (int p=0; p<=q2-q1; p++){
-    			double Spll = sum(pow(dUpll(Range::all(),Range::all(),Range::all()),q1+p))/(count);
-                Array<int, 1> X, Y, Z, p_arr;
-                Array<double, 1> Spll_arr;
-                
-                if (rank_mpi==0) {
-                    X.resize(P);
-                    Y.resize(P);
-                    Z.resize(P);
-                    p_arr.resize(P);
-                    Spll_arr.resize(P);
-                }
-        
-                MPI_Gather(&x, 1, MPI_INT, X.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&y, 1, MPI_INT, Y.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&z, 1, MPI_INT, Z.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&Spll, 1, MPI_DOUBLE, Spll_arr.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-                MPI_Gather(&p, 1, MPI_INT, p_arr.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    displacement_loop_3D(c, c.SF_Grid_pll, c.SF_Grid_perp, c.SF_Grid_pll_err, c.SF_Grid_perp_err, c.SF_Grid_pll_cond, c.SF_Grid_perp_cond, false,
+        [&](int x, int y, int z, Array<double,1> Spll, Array<double,1> Sperp, Array<double,1> Scomp) {
+            moments_3D_planar(c, Ux, Uy, Uz, x, y, z, Spll, Sperp, Scomp, false);
+        });
+}
 
-                if (rank_mpi==0) {
-                    for (int i=0; i<P; i++) {
-                        SF_Grid_pll(X(i), Y(i), Z(i), p_arr(i)) = Spll_arr(i);
-                    }
-                }
 
-    		}
-  		}
-  	}
-    if (rank_mpi==0) {
-  	    SF_Grid_pll(0,0,0,Range::all())=0;
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to calculate the longitudinal and transverse structure functions for a packed 3D velocity field.
+ *
+ * \param U is a 1D array storing the three components of velocity field per grid point
+ ********************************************************************************************************************************************
+ */
+void SFunc3D_packed(SF_context& c, Array<double,1> U)
+{
+    if (c.rank_mpi==0) {
+        cout<<"\nComputing longitudinal and transverse S(lx, ly, lz) using packed 3D velocity field data..\n";
+    }
+    displacement_loop_3D(c, c.SF_Grid_pll, c.SF_Grid_perp, c.SF_Grid_pll_err, c.SF_Grid_perp_err, c.SF_Grid_pll_cond, c.SF_Grid_perp_cond, true,
+        [&](int x, int y, int z, Array<double,1> Spll, Array<double,1> Sperp, Array<double,1> Scomp) {
+            moments_3D_packed(c, U, x, y, z, Spll, Sperp, Scomp, true);
+        });
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to calculate only the longitudinal structure functions for a packed 3D velocity field.
+ *
+ * \param U is a 1D array storing the three components of velocity field per grid point
+ ********************************************************************************************************************************************
+ */
+void SFunc_long_3D_packed(SF_context& c, Array<double,1> U)
+{
+    if (c.rank_mpi==0) {
+        cout<<"\nComputing longitudinal S(lx, ly, lz) using packed 3D velocity field data..\n";
+    }
+    displacement_loop_3D(c, c.SF_Grid_pll, c.SF_Grid_perp, c.SF_Grid_pll_err, c.SF_Grid_perp_err, c.SF_Grid_pll_cond, c.SF_Grid_perp_cond, false,
+        [&](int x, int y, int z, Array<double,1> Spll, Array<double,1> Sperp, Array<double,1> Scomp) {
+            moments_3D_packed(c, U, x, y, z, Spll, Sperp, Scomp, false);
+        });
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to calculate structure functions for a 3D scalar field.
+ *
+ * \param T is a 3D array representing the scalar field
+ ********************************************************************************************************************************************
+ */
+void SF_scalar_3D(SF_context& c, Array<double,3> T)
+{
+    if (c.rank_mpi==0) {
+        cout<<"\nComputing S(lx, ly, lz) using 3D scalar field data..\n";
+    }
+    displacement_loop_3D(c, c.SF_Grid_scalar, c.SF_Grid_scalar, c.SF_Grid_scalar_err, c.SF_Grid_scalar_err, c.SF_Grid_scalar_cond, c.SF_Grid_scalar_cond, false,
+        [&](int x, int y, int z, Array<double,1> St, Array<double,1>, Array<double,1>) {
+            moments_scalar_3D_planar(c, T, x, y, z, St);
+        });
+}
+
+
+/**
+ ********************************************************************************************************************************************
+ * \brief   Function to calculate structure functions for a 3D scalar field stored in bricks.
+ *
+ * \param T is a 1D array storing the scalar field in the bricked layout
+ ********************************************************************************************************************************************
+ */
+void SF_scalar_3D_packed(SF_context& c, Array<double,1> T)
+{
+    if (c.rank_mpi==0) {
+        cout<<"\nComputing S(lx, ly, lz) using bricked 3D scalar field data..\n";
     }
+    displacement_loop_3D(c, c.SF_Grid_scalar, c.SF_Grid_scalar, c.SF_Grid_scalar_err, c.SF_Grid_scalar_err, c.SF_Grid_scalar_cond, c.SF_Grid_scalar_cond, false,
+        [&](int x, int y, int z, Array<double,1> St, Array<double,1>, Array<double,1>) {
+            moments_scalar_3D_packed(c, T, x, y, z, St);
+        });
 }
 
 
@@ -2047,71 +8460,99 @@ if (rank_mpi==0) {
  ********************************************************************************************************************************************
  */
  void SFunc2D(
+         SF_context& c,
          Array<double,2> Ux,
          Array<double,2> Uz)
  {
-     if (rank_mpi==0) {
+     if (c.rank_mpi==0) {
          cout<<"\nComputing longitudinal and transverse S(lx, lz) using 2D velocity field data..\n";
      }
 
-    int p_per_proc = Nx*Nz/(4*P);
 
-    Array<int, 3> index_list;
-    compute_index_list(index_list, Nx, Nz);
+    Array<int, 3> schedule;
+    compute_schedule(c, schedule);
     Array<double,2> dUz;
     Array<double,2> dUx;
     Array<double,2> dUpll;
+    int nq = num_orders(c);
+    Array<double,1> Spll_b(sum_size(c)), Sperp_b(sum_size(c));
+    Array<double,2> Cpll(max(1,c.conditional_bins), nq), Cperp(max(1,c.conditional_bins), nq);
+    Array<double,1> Epll(nq), Eperp(nq);
+    vector<double> count;
     
-    for (int ix=0; ix<p_per_proc; ix++){
-        int x=index_list(ix, 0, rank_mpi);
-        int z=index_list(ix, 1, rank_mpi);
-        dUx.resize(Nx-x,Nz-z);
-        dUz.resize(Nx-x,Nz-z);
-        dUpll.resize(Nx-x,Nz-z);
-        int count=(Nx-x)*(Nz-z);
-        double lx=x*dx;
-        double lz=z*dz;
+    for (int st=c.first_step; st<schedule.extent(0); st++){
+        if (out_of_time(c, st)) {
+            break;
+        }
+        int x=schedule(st, 0, c.rank_mpi);
+        int z=schedule(st, 2, c.rank_mpi);
+        int f=pyramid_stride(c, x, 0, z);
+        int mx=(c.Nx-x-1)/f+1, mz=(c.Nz-z-1)/f+1;
+        dUx.resize(mx,mz);
+        dUz.resize(mx,mz);
+        dUpll.resize(mx,mz);
+        block_counts(c, x, 0, z, f, count);
+        double lx=x*c.dx;
+        double lz=z*c.dz;
         double r=sqrt(lx*lx+lz*lz);
 
-        dUx(Range::all(),Range::all())=Ux(Range(x,Nx-1),Range(z,Nz-1))-Ux(Range(0,Nx-x-1),Range(0,Nz-z-1));
-        dUz(Range::all(),Range::all())=Uz(Range(x,Nx-1),Range(z,Nz-1))-Uz(Range(0,Nx-x-1),Range(0,Nz-z-1));
-        	
-        dUpll=(lx*dUx+lz*dUz)/r;
-        dUx=dUx-dUpll*lx/r;
-        dUz=dUz-dUpll*lz/r;
-        dUx=pow(dUx*dUx+dUz*dUz,0.5);
+        Spll_b = 0;
+        Sperp_b = 0;
+        perf_start(c);
+        if (displacement_selected(c, x)) {
+            dUx(Range::all(),Range::all())=Ux(Range(x,c.Nx-1,f),Range(z,c.Nz-1,f))-Ux(Range(0,c.Nx-x-1,f),Range(0,c.Nz-z-1,f));
+            dUz(Range::all(),Range::all())=Uz(Range(x,c.Nx-1,f),Range(z,c.Nz-1,f))-Uz(Range(0,c.Nx-x-1,f),Range(0,c.Nz-z-1,f));
 
-    	for (int p=0; p<=q2-q1; p++){
-            double Spll = sum(pow(dUpll(Range::all(),Range::all()),q1+p))/(count);
-            double Sperp =sum(pow(dUx(Range::all(),Range::all()),q1+p))/(count);
-            Array<int, 1> X, Z, p_arr;
-            Array<double, 1> Spll_arr, Sperp_arr;
-            
-            if (rank_mpi==0) {
-                X.resize(P);
-                Z.resize(P);
-                p_arr.resize(P);
-                Spll_arr.resize(P);
-                Sperp_arr.resize(P);
-            }
-        
-            MPI_Gather(&x, 1, MPI_INT, X.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-            MPI_Gather(&z, 1, MPI_INT, Z.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-            MPI_Gather(&Spll, 1, MPI_DOUBLE, Spll_arr.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-            MPI_Gather(&p, 1, MPI_INT, p_arr.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-            MPI_Gather(&Sperp, 1, MPI_DOUBLE, Sperp_arr.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+            dUpll=(lx*dUx+lz*dUz)/r;
+            dUx=dUx-dUpll*lx/r;
+            dUz=dUz-dUpll*lz/r;
+            dUx=pow(dUx*dUx+dUz*dUz,0.5);
 
-            if (rank_mpi==0) {
-                for (int i=0; i<P; i++) {
-                    SF_Grid2D_pll(X(i), Z(i), p_arr(i)) = Spll_arr(i);
-                    SF_Grid2D_perp(X(i), Z(i), p_arr(i)) = Sperp_arr(i);
-                } 
-            } 
-        } 
+            block_sums_2D(c, dUpll, c.Nx, c.Nz, f, Spll_b);
+            block_sums_2D(c, dUx, c.Nx, c.Nz, f, Sperp_b);
+        }
+        else {
+            count.assign(count.size(), 0);
+        }
+        perf_stop(c);
+        if (c.conditional_bins > 0) {
+            vector<double> groups(Spll_b.data()+num_groups(c)*nq, Spll_b.data()+Spll_b.size());
+            conditional_statistics(c, Spll_b, groups, Cpll, count);
+            conditional_statistics(c, Sperp_b, groups, Cperp, count);
+        }
+        for (int b=0; b<c.conditional_bins; b++) {
+            Array<double,3> none;
+            gather_SF_2D(c, c.rank_mpi==0 ? c.SF_Grid2D_pll_cond(b,Range::all(),Range::all(),Range::all()) : none, x, z, Cpll(b,Range::all()));
+            gather_SF_2D(c, c.rank_mpi==0 ? c.SF_Grid2D_perp_cond(b,Range::all(),Range::all(),Range::all()) : none, x, z, Cperp(b,Range::all()));
+        }
+        block_statistics(c, Spll_b, count, Epll);
+        block_statistics(c, Sperp_b, count, Eperp);
+        c.perf_pairs += accumulate(count.begin(), count.end(), 0.0);
+        accumulate_angular(c, x, 0, z, accumulate(count.begin(), count.end(), 0.0), Spll_b, Sperp_b, true);
+        if (c.write_sums) {
+            Array<double,1> N(1);
+            N(0) = accumulate(count.begin(), count.end(), 0.0);
+            gather_SF_2D(c, c.SF_count_2D, x, z, N);
+        }
+
+        gather_SF_2D(c, c.SF_Grid2D_pll, x, z, Spll_b(Range(0,nq-1)));
+        gather_SF_2D(c, c.SF_Grid2D_perp, x, z, Sperp_b(Range(0,nq-1)));
+        if (c.error_blocks > 1) {
+            gather_SF_2D(c, c.SF_Grid2D_pll_err, x, z, Epll);
+            gather_SF_2D(c, c.SF_Grid2D_perp_err, x, z, Eperp);
+        }
+        trace_step(c, st, false);
+        flush_progress(c, st);
     }
-    if (rank_mpi==0) {
-        SF_Grid2D_pll(0,0,Range::all())=0;
-        SF_Grid2D_perp(0,0,Range::all())=0;
+    if (c.rank_mpi==0) {
+        c.SF_Grid2D_pll(0,0,Range::all())=0;
+        if (c.error_blocks > 1) {
+            c.SF_Grid2D_pll_err(0,0,Range::all())=0;
+        }
+        c.SF_Grid2D_perp(0,0,Range::all())=0;
+        if (c.error_blocks > 1) {
+            c.SF_Grid2D_perp_err(0,0,Range::all())=0;
+        }
     }
     
 }
@@ -2126,138 +8567,90 @@ if (rank_mpi==0) {
  ********************************************************************************************************************************************
  */
 void SFunc_long_2D(
+         SF_context& c,
          Array<double,2> Ux,
          Array<double,2> Uz)
  {
-     if (rank_mpi==0) {
+     if (c.rank_mpi==0) {
          cout<<"\nComputing longitudinal S(lx, lz) using 2D velocity field data..\n";
      }
 
-    int p_per_proc = Nx*Nz/(4*P);
 
-    Array<int, 3> index_list;
-    compute_index_list(index_list, Nx, Nz);
+    Array<int, 3> schedule;
+    compute_schedule(c, schedule);
     Array<double,2> dUz;
     Array<double,2> dUx;
     Array<double,2> dUpll;
+    int nq = num_orders(c);
+    Array<double,1> Spll_b(sum_size(c)), Sperp_b(sum_size(c));
+    Array<double,2> Cpll(max(1,c.conditional_bins), nq);
+    Array<double,1> Epll(nq), Eperp(nq);
+    vector<double> count;
     
-    for (int ix=0; ix<p_per_proc; ix++){
-        int x=index_list(ix, 0, rank_mpi);
-        int z=index_list(ix, 1, rank_mpi);
-        dUx.resize(Nx-x,Nz-z);
-        dUz.resize(Nx-x,Nz-z);
-        dUpll.resize(Nx-x,Nz-z);
-        int count=(Nx-x)*(Nz-z);
-        double lx=x*dx;
-        double lz=z*dz;
+    for (int st=c.first_step; st<schedule.extent(0); st++){
+        if (out_of_time(c, st)) {
+            break;
+        }
+        int x=schedule(st, 0, c.rank_mpi);
+        int z=schedule(st, 2, c.rank_mpi);
+        int f=pyramid_stride(c, x, 0, z);
+        int mx=(c.Nx-x-1)/f+1, mz=(c.Nz-z-1)/f+1;
+        dUx.resize(mx,mz);
+        dUz.resize(mx,mz);
+        dUpll.resize(mx,mz);
+        block_counts(c, x, 0, z, f, count);
+        double lx=x*c.dx;
+        double lz=z*c.dz;
         double r=sqrt(lx*lx+lz*lz);
 
-        dUx(Range::all(),Range::all())=Ux(Range(x,Nx-1),Range(z,Nz-1))-Ux(Range(0,Nx-x-1),Range(0,Nz-z-1));
-        dUz(Range::all(),Range::all())=Uz(Range(x,Nx-1),Range(z,Nz-1))-Uz(Range(0,Nx-x-1),Range(0,Nz-z-1));
-            
-        dUpll=(lx*dUx+lz*dUz)/r;
+        Spll_b = 0;
+        perf_start(c);
+        if (displacement_selected(c, x)) {
+            dUx(Range::all(),Range::all())=Ux(Range(x,c.Nx-1,f),Range(z,c.Nz-1,f))-Ux(Range(0,c.Nx-x-1,f),Range(0,c.Nz-z-1,f));
+            dUz(Range::all(),Range::all())=Uz(Range(x,c.Nx-1,f),Range(z,c.Nz-1,f))-Uz(Range(0,c.Nx-x-1,f),Range(0,c.Nz-z-1,f));
 
-        for (int p=0; p<=q2-q1; p++){
-            double Spll = sum(pow(dUpll(Range::all(),Range::all()),q1+p))/(count);
-            Array<int, 1> X, Z, p_arr;
-            Array<double, 1> Spll_arr;
-            
-            if (rank_mpi==0) {
-                X.resize(P);
-                Z.resize(P);
-                p_arr.resize(P);
-                Spll_arr.resize(P);
-            }
-        
-            MPI_Gather(&x, 1, MPI_INT, X.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-            MPI_Gather(&z, 1, MPI_INT, Z.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-            MPI_Gather(&Spll, 1, MPI_DOUBLE, Spll_arr.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-            MPI_Gather(&p, 1, MPI_INT, p_arr.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+            dUpll=(lx*dUx+lz*dUz)/r;
 
-            if (rank_mpi==0) {
-                for (int i=0; i<P; i++) {
-                    SF_Grid2D_pll(X(i), Z(i), p_arr(i)) = Spll_arr(i);
-                } 
-            }
+            block_sums_2D(c, dUpll, c.Nx, c.Nz, f, Spll_b);
+        }
+        else {
+            count.assign(count.size(), 0);
+        }
+        perf_stop(c);
+        if (c.conditional_bins > 0) {
+            vector<double> groups(Spll_b.data()+num_groups(c)*nq, Spll_b.data()+Spll_b.size());
+            conditional_statistics(c, Spll_b, groups, Cpll, count);
+        }
+        for (int b=0; b<c.conditional_bins; b++) {
+            Array<double,3> none;
+            gather_SF_2D(c, c.rank_mpi==0 ? c.SF_Grid2D_pll_cond(b,Range::all(),Range::all(),Range::all()) : none, x, z, Cpll(b,Range::all()));
+        }
+        block_statistics(c, Spll_b, count, Epll);
+        c.perf_pairs += accumulate(count.begin(), count.end(), 0.0);
+        accumulate_angular(c, x, 0, z, accumulate(count.begin(), count.end(), 0.0), Spll_b, Spll_b, false);
+        if (c.write_sums) {
+            Array<double,1> N(1);
+            N(0) = accumulate(count.begin(), count.end(), 0.0);
+            gather_SF_2D(c, c.SF_count_2D, x, z, N);
         }
-    }
-    if (rank_mpi==0) {
-        SF_Grid2D_pll(0,0,Range::all())=0;
-    }
-    
-}
-
-
-
-/**
- ********************************************************************************************************************************************
- * \brief   Function to calculate structure functions for a 3D scalar field.
- *
- * \param T is a 3D array representing the scalar field
- ********************************************************************************************************************************************
- */
-
-
-void SF_scalar_3D(
-         Array<double,3> T)
- {
-     if (rank_mpi==0) {
-         cout<<"\nComputing S(lx, ly, lz) using 3D scalar field data..\n";
-     }
-    
-    int c_per_proc = Nx*Ny/(4*P);
-
-    Array<int, 3> index_list;
-    compute_index_list(index_list, Nx, Ny);
-    Array<double,3> dT;
-    
-    for (int ix=0; ix<c_per_proc; ix++){
-        int x=index_list(ix, 0, rank_mpi);
-        int y=index_list(ix, 1, rank_mpi);
-        for(int z=0; z<Nz/2; z++){
-            dT.resize(Nx-x,Ny-y,Nz-z);
-                
-            int count=(Nx-x)*(Ny-y)*(Nz-z);
-            double r=sqrt(x*x*dx*dx+y*y*dy*dy+z*z*dz*dz);
-
-            dT(Range::all(),Range::all(),Range::all())=T(Range(x,Nx-1),Range(y,Ny-1),Range(z,Nz-1))-T(Range(0,Nx-x-1),Range(0,Ny-y-1),Range(0,Nz-z-1));
-                
-
-            for (int p=0; p<=q2-q1; p++){
-                double St = sum(pow(dT(Range::all(),Range::all(),Range::all()),q1+p))/(count);
-                Array<int, 1> X, Y, Z, p_arr;
-                Array<double, 1> St_arr;
-                
-                if (rank_mpi==0) {
-                    X.resize(P);
-                    Y.resize(P);
-                    Z.resize(P);
-                    p_arr.resize(P);
-                    St_arr.resize(P);
-                }
-        
-                MPI_Gather(&x, 1, MPI_INT, X.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&y, 1, MPI_INT, Y.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&z, 1, MPI_INT, Z.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Gather(&St, 1, MPI_DOUBLE, St_arr.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-                MPI_Gather(&p, 1, MPI_INT, p_arr.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-                if (rank_mpi==0) {
-                    for (int i=0; i<P; i++) {
-                        SF_Grid_scalar(X(i), Y(i), Z(i), p_arr(i)) = St_arr(i);
-                    }
-                }
 
-            }
-                
+        gather_SF_2D(c, c.SF_Grid2D_pll, x, z, Spll_b(Range(0,nq-1)));
+        if (c.error_blocks > 1) {
+            gather_SF_2D(c, c.SF_Grid2D_pll_err, x, z, Epll);
         }
+        trace_step(c, st, false);
+        flush_progress(c, st);
     }
-    if (rank_mpi==0) {
-        SF_Grid_scalar(0,0,0,Range::all())=0;
+    if (c.rank_mpi==0) {
+        c.SF_Grid2D_pll(0,0,Range::all())=0;
+        if (c.error_blocks > 1) {
+            c.SF_Grid2D_pll_err(0,0,Range::all())=0;
+        }
     }
+    
+}
 
 
- }
 
 /**
  ********************************************************************************************************************************************
@@ -2267,53 +8660,73 @@ void SF_scalar_3D(
  * \param T is a 2D array representing the scalar field
  ********************************************************************************************************************************************
  */
-void SF_scalar_2D(Array<double,2> T)
+void SF_scalar_2D(SF_context& c, Array<double,2> T)
  {
-     if (rank_mpi==0) {
+     if (c.rank_mpi==0) {
          cout<<"\nComputing S(lx, lz) using 2D scalar field data..\n";
      }
 
-    int p_per_proc = Nx*Nz/(4*P);
 
-    Array<int, 3> index_list;
-    compute_index_list(index_list, Nx, Nz);
+    Array<int, 3> schedule;
+    compute_schedule(c, schedule);
     Array<double,2> dT;
+    int nq = num_orders(c);
+    Array<double,1> St_b(sum_size(c));
+    Array<double,2> Ct(max(1,c.conditional_bins), nq);
+    Array<double,1> Et(nq);
+    vector<double> count;
     
-    for (int ix=0; ix<p_per_proc; ix++){
-        int x=index_list(ix, 0, rank_mpi);
-        int z=index_list(ix, 1, rank_mpi);
+    for (int st=c.first_step; st<schedule.extent(0); st++){
+        if (out_of_time(c, st)) {
+            break;
+        }
+        int x=schedule(st, 0, c.rank_mpi);
+        int z=schedule(st, 2, c.rank_mpi);
        			
-        dT.resize(Nx-x,Nz-z);
-        int count=(Nx-x)*(Nz-z);
-
-        dT(Range::all(),Range::all())=T(Range(x,Nx-1),Range(z,Nz-1))-T(Range(0,Nx-x-1),Range(0,Nz-z-1));
-        		
-        for (int p=0; p<=q2-q1; p++){
-            double St = sum(pow(dT(Range::all(),Range::all()),q1+p))/(count);
-            Array<int, 1> X, Z, p_arr;
-            Array<double, 1> St_arr;
-            
-            if (rank_mpi==0) {
-                X.resize(P);
-                Z.resize(P);
-                p_arr.resize(P);
-                St_arr.resize(P);
-            }
-        
-            MPI_Gather(&x, 1, MPI_INT, X.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-            MPI_Gather(&z, 1, MPI_INT, Z.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
-            MPI_Gather(&St, 1, MPI_DOUBLE, St_arr.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-            MPI_Gather(&p, 1, MPI_INT, p_arr.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+        int f=pyramid_stride(c, x, 0, z);
+        int mx=(c.Nx-x-1)/f+1, mz=(c.Nz-z-1)/f+1;
+        dT.resize(mx,mz);
+        block_counts(c, x, 0, z, f, count);
+
+        St_b = 0;
+        perf_start(c);
+        if (displacement_selected(c, x)) {
+            dT(Range::all(),Range::all())=T(Range(x,c.Nx-1,f),Range(z,c.Nz-1,f))-T(Range(0,c.Nx-x-1,f),Range(0,c.Nz-z-1,f));
+            block_sums_2D(c, dT, c.Nx, c.Nz, f, St_b);
+        }
+        else {
+            count.assign(count.size(), 0);
+        }
+        perf_stop(c);
+        if (c.conditional_bins > 0) {
+            vector<double> groups(St_b.data()+num_groups(c)*nq, St_b.data()+St_b.size());
+            conditional_statistics(c, St_b, groups, Ct, count);
+        }
+        for (int b=0; b<c.conditional_bins; b++) {
+            Array<double,3> none;
+            gather_SF_2D(c, c.rank_mpi==0 ? c.SF_Grid2D_scalar_cond(b,Range::all(),Range::all(),Range::all()) : none, x, z, Ct(b,Range::all()));
+        }
+        block_statistics(c, St_b, count, Et);
+        c.perf_pairs += accumulate(count.begin(), count.end(), 0.0);
+        accumulate_angular(c, x, 0, z, accumulate(count.begin(), count.end(), 0.0), St_b, St_b, false);
+        if (c.write_sums) {
+            Array<double,1> N(1);
+            N(0) = accumulate(count.begin(), count.end(), 0.0);
+            gather_SF_2D(c, c.SF_count_2D, x, z, N);
+        }
 
-            if (rank_mpi==0) {
-                for (int i=0; i<P; i++) {
-                    SF_Grid2D_scalar(X(i), Z(i), p_arr(i)) = St_arr(i);
-                } 
-            }
+        gather_SF_2D(c, c.SF_Grid2D_scalar, x, z, St_b(Range(0,nq-1)));
+        if (c.error_blocks > 1) {
+            gather_SF_2D(c, c.SF_Grid2D_scalar_err, x, z, Et);
         }
+        trace_step(c, st, false);
+        flush_progress(c, st);
     }
-    if (rank_mpi==0) {
-        SF_Grid2D_scalar(0,0,Range::all())=0;
+    if (c.rank_mpi==0) {
+        c.SF_Grid2D_scalar(0,0,Range::all())=0;
+        if (c.error_blocks > 1) {
+            c.SF_Grid2D_scalar_err(0,0,Range::all())=0;
+        }
     }
  }
 
@@ -0,0 +1,70 @@
+#############################################################################################################################################
+ # fastSF
+ # 
+ # Copyright (C) 2020, Mahendra K. Verma
+ #
+ # All rights reserved.
+ # 
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions are met:
+ #     1. Redistributions of source code must retain the above copyright
+ #        notice, this list of conditions and the following disclaimer.
+ #     2. Redistributions in binary form must reproduce the above copyright
+ #        notice, this list of conditions and the following disclaimer in the
+ #        documentation and/or other materials provided with the distribution.
+ #     3. Neither the name of the copyright holder nor the
+ #        names of its contributors may be used to endorse or promote products
+ #        derived from this software without specific prior written permission.
+ # 
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ # ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ # WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ # DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ # ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ # (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ # LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ # ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ # SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ #
+ ############################################################################################################################################
+ ##
+ ##! \file compare.py
+ #
+ #   \brief Script to compare the structure functions of an output file with those of a reference run
+ #
+ #   \date Oct 2026
+ #   \copyright New BSD License
+ #
+ ############################################################################################################################################
+##
+
+
+# Usage: python compare.py [name of the test] [file] [reference file]
+# Every dataset of the reference file must be found in the file with the same values,
+# up to the round-off.
+
+import sys
+import h5py
+import numpy as np
+
+name, file_name, reference_name = sys.argv[1:4]
+tested = h5py.File(file_name, 'r')
+reference = h5py.File(reference_name, 'r')
+
+error = 0.0
+for dataset in reference:
+	if dataset not in tested:
+		error = np.inf
+		break
+	S = tested[dataset][()]
+	S_ref = reference[dataset][()]
+	if S.shape != S_ref.shape:
+		error = np.inf
+		break
+	error = max(error, np.max(np.abs(S-S_ref))/max(np.max(np.abs(S_ref)), 1e-300))
+
+if error < 1e-10:
+	print(name + ": TEST_PASSED. The structure functions match those of the reference run.  MAXIMUM RELATIVE ERROR: " + str(error))
+else:
+	print(name + ": TEST_FAILED. The structure functions differ from those of the reference run.  MAXIMUM RELATIVE ERROR: " + str(error))